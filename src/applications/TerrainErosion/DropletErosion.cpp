@@ -0,0 +1,249 @@
+
+#include "DropletErosion.h"
+#include "base/logbook.h"
+#include <algorithm>
+#include <cmath>
+#include <random>
+#include <stdexcept>
+#include <string>
+
+using namespace orf_n;
+
+DropletErosion::DropletErosion( const settings_t &settings ) :
+		m_settings{ settings } {
+	if( m_settings.width < 2 || m_settings.height < 2 || 0 == m_settings.tileSize ) {
+		const std::string s{ "Droplet erosion needs a grid of at least 2x2 cells and tiles" };
+		logbook::log_msg( logbook::TERRAIN, logbook::ERROR, s );
+		throw std::runtime_error( s );
+	}
+	m_pool = std::make_unique<thread_pool>( m_settings.numberOfThreads );
+	m_terrain.resize( m_settings.width, m_settings.height );
+	m_terrainNext.resize( m_settings.width, m_settings.height );
+	const uint32_t size{ m_settings.tileSize };
+	const int32_t margin{ static_cast<int32_t>( getMargin() ) };
+	const int32_t width{ static_cast<int32_t>( m_settings.width ) };
+	const int32_t height{ static_cast<int32_t>( m_settings.height ) };
+	m_tilesX = ( m_settings.width + size - 1 ) / size;
+	m_tilesY = ( m_settings.height + size - 1 ) / size;
+	m_tiles.resize( m_tilesX * m_tilesY );
+	for( uint32_t ty{0}; ty < m_tilesY; ++ty )
+		for( uint32_t tx{0}; tx < m_tilesX; ++tx ) {
+			tile_t &tile{ m_tiles[ty * m_tilesX + tx] };
+			tile.coreX = tx * size;
+			tile.coreY = ty * size;
+			tile.coreWidth = std::min( size, m_settings.width - tile.coreX );
+			tile.coreHeight = std::min( size, m_settings.height - tile.coreY );
+			// Buffer with the margin, clipped to the grid
+			tile.x = std::max( 0, static_cast<int32_t>( tile.coreX ) - margin );
+			tile.y = std::max( 0, static_cast<int32_t>( tile.coreY ) - margin );
+			tile.width = std::min( width, static_cast<int32_t>( tile.coreX + tile.coreWidth ) + margin ) - tile.x;
+			tile.height = std::min( height, static_cast<int32_t>( tile.coreY + tile.coreHeight ) + margin ) - tile.y;
+			tile.heights.resize( static_cast<size_t>( tile.width ) * tile.height );
+		}
+	createBrush();
+	logbook::log_msg( logbook::TERRAIN, logbook::INFO, "Droplet erosion " + std::to_string( width ) + 'x' +
+			std::to_string( height ) + " in " + std::to_string( m_tiles.size() ) + " tiles, " +
+			std::to_string( getSizeInMemory() >> 20 ) + "MB, " + std::to_string( m_pool->get_number_of_threads() ) +
+			" threads" );
+}
+
+DropletErosion::~DropletErosion() {}
+
+uint32_t DropletErosion::getMargin() const {
+	// A droplet moves a cell per step, the brush and interpolation reach further
+	return m_settings.maxLifetime + m_settings.erosionRadius + 2;
+}
+
+void DropletErosion::createBrush() {
+	m_brush.clear();
+	const int32_t radius{ static_cast<int32_t>( m_settings.erosionRadius ) };
+	float total{ 0.0f };
+	for( int32_t y{ -radius }; y <= radius; ++y )
+		for( int32_t x{ -radius }; x <= radius; ++x ) {
+			const float distance{ std::sqrt( static_cast<float>( x * x + y * y ) ) };
+			// Linear falloff, at least the droplet's cell
+			const float weight{ radius > 0 ? 1.0f - distance / radius : 1.0f };
+			if( weight > 0.0f ) {
+				m_brush.push_back( { x, y, weight } );
+				total += weight;
+			}
+		}
+	for( brushCell_t &cell : m_brush )
+		cell.weight /= total;
+}
+
+void DropletErosion::setTerrain( const float *heights ) {
+	for( uint32_t y{0}; y < m_settings.height; ++y )
+		std::copy_n( heights + static_cast<size_t>( y ) * m_settings.width, m_settings.width, m_terrain.row( y ) );
+	m_terrain.clampGhosts();
+}
+
+void DropletErosion::erode( const uint64_t numberOfDroplets ) {
+	const uint64_t cells{ static_cast<uint64_t>( m_settings.width ) * m_settings.height };
+	const uint64_t perPass{ std::max<uint64_t>( 1, static_cast<uint64_t>( m_settings.dropletsPerTile ) * m_tiles.size() ) };
+	std::vector<uint32_t> droplets( m_tiles.size() );
+	for( uint64_t done{0}; done < numberOfDroplets; ) {
+		const uint64_t pass{ std::min( perPass, numberOfDroplets - done ) };
+		// Droplets of the pass by the area of the tiles, adding up to the total
+		uint64_t cellsBefore{0};
+		for( size_t i{0}; i < m_tiles.size(); ++i ) {
+			const uint64_t cellsAfter{ cellsBefore + static_cast<uint64_t>( m_tiles[i].coreWidth ) * m_tiles[i].coreHeight };
+			droplets[i] = static_cast<uint32_t>( pass * cellsAfter / cells - pass * cellsBefore / cells );
+			cellsBefore = cellsAfter;
+		}
+		m_pool->parallel_for( 0, static_cast<uint32_t>( m_tiles.size() ), [&]( const uint32_t first, const uint32_t last ) {
+			for( uint32_t i{ first }; i < last; ++i )
+				erodeTile( m_tiles[i], i, droplets[i] );
+		}, 1 );
+		mergeTiles();
+		done += pass;
+		m_droplets += pass;
+		++m_pass;
+	}
+}
+
+void DropletErosion::erodeTile( tile_t &tile, const uint32_t tileIndex, const uint32_t droplets ) {
+	const int32_t width{ tile.width };
+	const int32_t height{ tile.height };
+	float *const h{ tile.heights.data() };
+	for( int32_t y{0}; y < height; ++y )
+		std::copy_n( m_terrain.row( tile.y + y ) + tile.x, width, h + static_cast<size_t>( y ) * width );
+	// Same droplets for a seed, tile and pass on any number of threads
+	std::seed_seq seeds{ static_cast<uint32_t>( m_settings.seed ), static_cast<uint32_t>( m_settings.seed >> 32 ),
+			static_cast<uint32_t>( m_pass ), static_cast<uint32_t>( m_pass >> 32 ), tileIndex };
+	std::mt19937 random{ seeds };
+	const auto uniform{ [&random]() { return static_cast<float>( random() >> 8 ) * ( 1.0f / 16777216.0f ); } };
+	// Start in the core, where the bilinear interpolation has a cell to the right and below
+	const float startX{ static_cast<float>( tile.coreX - tile.x ) };
+	const float startY{ static_cast<float>( tile.coreY - tile.y ) };
+	const float rangeX{ std::min( startX + tile.coreWidth, static_cast<float>( width - 1 ) ) - startX };
+	const float rangeY{ std::min( startY + tile.coreHeight, static_cast<float>( height - 1 ) ) - startY };
+	const settings_t &s{ m_settings };
+	for( uint32_t d{0}; d < droplets; ++d ) {
+		float posX{ startX + uniform() * rangeX };
+		float posY{ startY + uniform() * rangeY };
+		float dirX{ 0.0f };
+		float dirY{ 0.0f };
+		float speed{ s.initialSpeed };
+		float water{ s.initialWater };
+		float sediment{ 0.0f };
+		for( uint32_t lifetime{0}; lifetime < s.maxLifetime; ++lifetime ) {
+			const int32_t nodeX{ static_cast<int32_t>( posX ) };
+			const int32_t nodeY{ static_cast<int32_t>( posY ) };
+			const float u{ posX - nodeX };
+			const float v{ posY - nodeY };
+			const size_t node{ static_cast<size_t>( nodeY ) * width + nodeX };
+			const float nw{ h[node] };
+			const float ne{ h[node + 1] };
+			const float sw{ h[node + width] };
+			const float se{ h[node + width + 1] };
+			const float gradientX{ ( ne - nw ) * ( 1.0f - v ) + ( se - sw ) * v };
+			const float gradientY{ ( sw - nw ) * ( 1.0f - u ) + ( se - ne ) * u };
+			const float oldHeight{ ( nw * ( 1.0f - u ) + ne * u ) * ( 1.0f - v ) + ( sw * ( 1.0f - u ) + se * u ) * v };
+			// Downhill with inertia, a cell per step
+			dirX = dirX * s.inertia - gradientX * ( 1.0f - s.inertia );
+			dirY = dirY * s.inertia - gradientY * ( 1.0f - s.inertia );
+			const float length{ std::sqrt( dirX * dirX + dirY * dirY ) };
+			if( length <= 0.0f )
+				break;
+			dirX /= length;
+			dirY /= length;
+			posX += dirX;
+			posY += dirY;
+			// Off the grid, the margin keeps it from leaving the buffer anywhere else
+			if( posX < 0.0f || posY < 0.0f || posX >= width - 1 || posY >= height - 1 )
+				break;
+			const int32_t newX{ static_cast<int32_t>( posX ) };
+			const int32_t newY{ static_cast<int32_t>( posY ) };
+			const float nu{ posX - newX };
+			const float nv{ posY - newY };
+			const float *const n{ h + static_cast<size_t>( newY ) * width + newX };
+			const float newHeight{ ( n[0] * ( 1.0f - nu ) + n[1] * nu ) * ( 1.0f - nv ) +
+					( n[width] * ( 1.0f - nu ) + n[width + 1] * nu ) * nv };
+			const float deltaHeight{ newHeight - oldHeight };
+			const float capacity{ std::max( -deltaHeight * speed * water * s.capacityFactor, s.minCapacity ) };
+			if( sediment > capacity || deltaHeight > 0.0f ) {
+				// Fill the pit uphill, or drop the excess, at the old position
+				const float amount{ deltaHeight > 0.0f ? std::min( deltaHeight, sediment ) :
+						( sediment - capacity ) * s.depositSpeed };
+				sediment -= amount;
+				h[node] += amount * ( 1.0f - u ) * ( 1.0f - v );
+				h[node + 1] += amount * u * ( 1.0f - v );
+				h[node + width] += amount * ( 1.0f - u ) * v;
+				h[node + width + 1] += amount * u * v;
+			} else {
+				// No deeper than the height difference, so no pits
+				const float amount{ std::min( ( capacity - sediment ) * s.erodeSpeed, -deltaHeight ) };
+				for( const brushCell_t &cell : m_brush ) {
+					const int32_t x{ nodeX + cell.x };
+					const int32_t y{ nodeY + cell.y };
+					if( x < 0 || y < 0 || x >= width || y >= height )
+						continue;
+					const float eroded{ amount * cell.weight };
+					h[static_cast<size_t>( y ) * width + x] -= eroded;
+					sediment += eroded;
+				}
+			}
+			speed = std::sqrt( std::max( 0.0f, speed * speed - deltaHeight * s.gravity ) );
+			water *= 1.0f - s.evaporateSpeed;
+		}
+		// What is left settles where the droplet ends, unless it ran off the grid
+		if( posX >= 0.0f && posY >= 0.0f && posX < width - 1 && posY < height - 1 ) {
+			const int32_t nodeX{ static_cast<int32_t>( posX ) };
+			const int32_t nodeY{ static_cast<int32_t>( posY ) };
+			const float u{ posX - nodeX };
+			const float v{ posY - nodeY };
+			float *const n{ h + static_cast<size_t>( nodeY ) * width + nodeX };
+			n[0] += sediment * ( 1.0f - u ) * ( 1.0f - v );
+			n[1] += sediment * u * ( 1.0f - v );
+			n[width] += sediment * ( 1.0f - u ) * v;
+			n[width + 1] += sediment * u * v;
+		}
+	}
+}
+
+void DropletErosion::mergeTiles() {
+	const uint32_t size{ m_settings.tileSize };
+	const int32_t margin{ static_cast<int32_t>( getMargin() ) };
+	m_pool->parallel_for( 0, m_settings.height, [&]( const uint32_t first, const uint32_t last ) {
+		for( uint32_t y{ first }; y < last; ++y ) {
+			const float *const terrain{ m_terrain.row( y ) };
+			float *const next{ m_terrainNext.row( y ) };
+			std::copy_n( terrain, m_settings.width, next );
+			// Tiles whose buffer covers the row, always in the same order
+			const uint32_t firstTileY{ static_cast<uint32_t>( std::max( 0, static_cast<int32_t>( y ) - margin ) ) / size };
+			const uint32_t lastTileY{ std::min( m_tilesY - 1, ( y + margin ) / size ) };
+			for( uint32_t ty{ firstTileY }; ty <= lastTileY; ++ty )
+				for( uint32_t tx{0}; tx < m_tilesX; ++tx ) {
+					const tile_t &tile{ m_tiles[ty * m_tilesX + tx] };
+					const int32_t row{ static_cast<int32_t>( y ) - tile.y };
+					if( row < 0 || row >= tile.height )
+						continue;
+					const float *const h{ &tile.heights[static_cast<size_t>( row ) * tile.width] };
+					for( int32_t x{0}; x < tile.width; ++x )
+						next[tile.x + x] += h[x] - terrain[tile.x + x];
+				}
+		}
+	}, 16 );
+	m_terrain.swap( m_terrainNext );
+	m_terrain.clampGhosts();
+}
+
+const ErosionField &DropletErosion::getTerrain() const {
+	return m_terrain;
+}
+
+uint64_t DropletErosion::getNumberOfDroplets() const {
+	return m_droplets;
+}
+
+DropletErosion::settings_t &DropletErosion::getSettings() {
+	return m_settings;
+}
+
+size_t DropletErosion::getSizeInMemory() const {
+	size_t size{ m_terrain.getSizeInMemory() + m_terrainNext.getSizeInMemory() };
+	for( const tile_t &tile : m_tiles )
+		size += tile.heights.size() * sizeof( float );
+	return size;
+}
@@ -0,0 +1,133 @@
+#pragma once
+
+#include "ErosionField.h"
+#include "base/thread_pool.h"
+#include <memory>
+#include <vector>
+
+/**
+ * Hydraulic erosion by droplets, an alternative to the grid based HydroErosionMDH07 for fine gully detail.
+ * Each droplet starts at a random cell, runs downhill with some inertia, picks up sediment up to its capacity
+ * within an erosion radius and deposits the excess where it slows down or runs uphill, while its water
+ * evaporates.
+ *
+ * The grid is split into tiles, the droplets starting on a tile are simulated one after the other by one
+ * thread. A tile has a deposit buffer: a copy of the terrain around it, wide enough that its droplets can't
+ * leave it. Droplets read and change only the buffer of their tile, so no two threads write the same cell.
+ * After a pass the changes of all buffers are added to the terrain in tile order. Droplet positions come from
+ * a random generator per tile and pass, seeded from the seed, so the result only depends on the seed and not
+ * on the number of threads.
+ */
+class DropletErosion {
+public:
+
+	struct settings_t {
+		// Size of the grid in cells
+		uint32_t width{2048};
+		uint32_t height{2048};
+		// Edge length of the tiles in cells, a task for a thread each
+		uint32_t tileSize{256};
+		// Droplets per tile and pass, the changes of a pass are seen by the droplets of other tiles in the next one
+		uint32_t dropletsPerTile{4096};
+		// Share of the old direction in the new one, 0 runs straight down the slope
+		float inertia{0.05f};
+		// Sediment capacity per height difference, speed and water
+		float capacityFactor{4.0f};
+		// Capacity on flat ground
+		float minCapacity{0.01f};
+		// Part of the free capacity that is picked up and of the excess that is deposited per step
+		float erodeSpeed{0.3f};
+		float depositSpeed{0.3f};
+		// Part of the water that evaporates per step
+		float evaporateSpeed{0.01f};
+		float gravity{4.0f};
+		// Steps of a droplet, about a cell each
+		uint32_t maxLifetime{30};
+		// Sediment is picked up from the cells within this radius, weighted by distance
+		uint32_t erosionRadius{3};
+		float initialWater{1.0f};
+		float initialSpeed{1.0f};
+		uint64_t seed{1};
+		// 0 for one per hardware thread
+		unsigned int numberOfThreads{0};
+	};
+
+	DropletErosion( const settings_t &settings );
+
+	virtual ~DropletErosion();
+
+	DropletErosion( const DropletErosion & ) = delete;
+
+	DropletErosion &operator=( const DropletErosion & ) = delete;
+
+	// Replace the terrain, heights row major with the size of the grid
+	void setTerrain( const float *heights );
+
+	// Simulate this many droplets in passes over all tiles, spread evenly over the grid
+	void erode( const uint64_t numberOfDroplets );
+
+	const ErosionField &getTerrain() const;
+
+	uint64_t getNumberOfDroplets() const;
+
+	// Parameters of the droplets can be changed between calls to erode(), except sizes, lifetime and radius
+	settings_t &getSettings();
+
+	size_t getSizeInMemory() const;
+
+private:
+	// A cell of the erosion brush, relative to the droplet's cell
+	struct brushCell_t {
+		int32_t x;
+		int32_t y;
+		float weight;
+	};
+
+	// Deposit buffer of a tile
+	struct tile_t {
+		// Origin and size of the buffer in the grid
+		int32_t x;
+		int32_t y;
+		int32_t width;
+		int32_t height;
+		// Core of the tile in the grid, where its droplets start
+		uint32_t coreX;
+		uint32_t coreY;
+		uint32_t coreWidth;
+		uint32_t coreHeight;
+		std::vector<float> heights;
+	};
+
+	settings_t m_settings;
+
+	std::unique_ptr<orf_n::thread_pool> m_pool;
+
+	ErosionField m_terrain;
+
+	ErosionField m_terrainNext;
+
+	std::vector<tile_t> m_tiles;
+
+	std::vector<brushCell_t> m_brush;
+
+	uint32_t m_tilesX{0};
+
+	uint32_t m_tilesY{0};
+
+	// Passes so far, part of the seed of the next one
+	uint64_t m_pass{0};
+
+	uint64_t m_droplets{0};
+
+	// Cells around a tile a droplet can reach
+	uint32_t getMargin() const;
+
+	void createBrush();
+
+	// Simulate droplets starting in the tile on its buffer
+	void erodeTile( tile_t &tile, const uint32_t tileIndex, const uint32_t droplets );
+
+	// Terrain plus the changes of all tiles in m_terrainNext, then swapped
+	void mergeTiles();
+
+};
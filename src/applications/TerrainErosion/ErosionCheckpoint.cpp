@@ -0,0 +1,213 @@
+
+#include "ErosionCheckpoint.h"
+#include "base/logbook.h"
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+
+using namespace orf_n;
+
+ErosionSnapshotWriter::ErosionSnapshotWriter() {
+	m_thread = std::thread{ &ErosionSnapshotWriter::work, this };
+}
+
+ErosionSnapshotWriter::~ErosionSnapshotWriter() {
+	flush();
+	{
+		std::lock_guard<std::mutex> lock{ m_mutex };
+		m_stop = true;
+	}
+	m_pending.notify_one();
+	m_thread.join();
+}
+
+bool ErosionSnapshotWriter::write( const HydroErosionMDH07 &erosion, const std::string &filename ) {
+	buffer_t *buffer{ nullptr };
+	{
+		std::lock_guard<std::mutex> lock{ m_mutex };
+		for( buffer_t &b : m_buffers )
+			if( !b.busy ) {
+				buffer = &b;
+				break;
+			}
+		// Rather lose a snapshot than stall the simulation
+		if( nullptr == buffer ) {
+			++m_dropped;
+			return false;
+		}
+	}
+	// Not busy, so the writer doesn't touch it
+	const uint32_t width{ erosion.getTerrain().getWidth() };
+	const uint32_t height{ erosion.getTerrain().getHeight() };
+	const uint32_t numberOfStateFields{ erosion.getNumberOfStateFields() };
+	erosionCheckpointHeader_t &header{ buffer->header };
+	header = erosionCheckpointHeader_t{};
+	std::memcpy( header.magic, EROSION_CHECKPOINT_MAGIC, sizeof( header.magic ) );
+	header.version = EROSION_CHECKPOINT_VERSION;
+	header.width = width;
+	header.height = height;
+	header.numberOfStateFields = numberOfStateFields;
+	header.numberOfFields = numberOfStateFields + 2;
+	header.lastTimeStep = erosion.getLastTimeStep();
+	header.iteration = erosion.getIteration();
+	header.simulatedTime = erosion.getSimulatedTime();
+	header.maxSpeed = erosion.getMaxSpeed();
+	const size_t planeSize{ erosionCheckpointPlaneSize( width, height ) };
+	buffer->planes.resize( planeSize * header.numberOfFields );
+	for( uint32_t field{0}; field < header.numberOfFields; ++field ) {
+		const ErosionField &f{ field < numberOfStateFields ?
+				erosion.getStateField( static_cast<HydroErosionMDH07::stateField_t>( field ) ) :
+				field == numberOfStateFields ? erosion.getVelocityX() : erosion.getVelocityY() };
+		float *const plane{ &buffer->planes[field * planeSize] };
+		for( uint32_t y{0}; y < height; ++y )
+			std::copy_n( f.row( y ), width, plane + static_cast<size_t>( y ) * width );
+	}
+	buffer->filename = filename;
+	{
+		std::lock_guard<std::mutex> lock{ m_mutex };
+		buffer->busy = true;
+		m_queue.push_back( buffer );
+	}
+	m_pending.notify_one();
+	return true;
+}
+
+void ErosionSnapshotWriter::flush() {
+	std::unique_lock<std::mutex> lock{ m_mutex };
+	m_done.wait( lock, [this]() { return !m_buffers[0].busy && !m_buffers[1].busy; } );
+}
+
+void ErosionSnapshotWriter::work() {
+	std::unique_lock<std::mutex> lock{ m_mutex };
+	while( true ) {
+		m_pending.wait( lock, [this]() { return m_stop || !m_queue.empty(); } );
+		if( m_queue.empty() )
+			return;
+		buffer_t *const buffer{ m_queue.front() };
+		m_queue.erase( m_queue.begin() );
+		lock.unlock();
+		const bool written{ writeFile( *buffer ) };
+		if( !written )
+			logbook::log_msg( logbook::TERRAIN, logbook::ERROR, "Error writing erosion snapshot '" +
+					buffer->filename + "': " + std::strerror( errno ) );
+		lock.lock();
+		if( written )
+			++m_written;
+		else
+			++m_failed;
+		buffer->busy = false;
+		m_done.notify_all();
+	}
+}
+
+bool ErosionSnapshotWriter::writeFile( const buffer_t &buffer ) {
+	// Complete or not at all for a restart
+	const std::string temporary{ buffer.filename + ".tmp" };
+	std::ofstream file{ temporary, std::ios::binary | std::ios::trunc };
+	file.write( reinterpret_cast<const char *>( &buffer.header ), sizeof( buffer.header ) );
+	file.write( reinterpret_cast<const char *>( buffer.planes.data() ),
+			static_cast<std::streamsize>( buffer.planes.size() * sizeof( float ) ) );
+	file.close();
+	if( !file ) {
+		std::remove( temporary.c_str() );
+		return false;
+	}
+	return 0 == std::rename( temporary.c_str(), buffer.filename.c_str() );
+}
+
+uint64_t ErosionSnapshotWriter::getNumberOfWritten() const {
+	std::lock_guard<std::mutex> lock{ m_mutex };
+	return m_written;
+}
+
+uint64_t ErosionSnapshotWriter::getNumberOfDropped() const {
+	std::lock_guard<std::mutex> lock{ m_mutex };
+	return m_dropped;
+}
+
+uint64_t ErosionSnapshotWriter::getNumberOfFailed() const {
+	std::lock_guard<std::mutex> lock{ m_mutex };
+	return m_failed;
+}
+
+ErosionCheckpoint::ErosionCheckpoint( const std::string &filename ) :
+		m_filename{ filename } {
+	std::string error;
+	struct stat status;
+	m_file = open( filename.c_str(), O_RDONLY );
+	if( m_file < 0 || 0 != fstat( m_file, &status ) )
+		error = std::strerror( errno );
+	else if( static_cast<size_t>( status.st_size ) < sizeof( erosionCheckpointHeader_t ) )
+		error = "too short";
+	else {
+		m_size = static_cast<size_t>( status.st_size );
+		void *const p{ mmap( nullptr, m_size, PROT_READ, MAP_SHARED, m_file, 0 ) };
+		if( MAP_FAILED == p )
+			error = std::strerror( errno );
+		else
+			m_data = static_cast<const char *>( p );
+	}
+	if( error.empty() ) {
+		const erosionCheckpointHeader_t &header{ getHeader() };
+		if( 0 != std::memcmp( header.magic, EROSION_CHECKPOINT_MAGIC, sizeof( header.magic ) ) ||
+				EROSION_CHECKPOINT_VERSION != header.version )
+			error = "not an erosion snapshot of version " + std::to_string( EROSION_CHECKPOINT_VERSION );
+		else if( m_size < sizeof( header ) + header.numberOfFields *
+				erosionCheckpointPlaneSize( header.width, header.height ) * sizeof( float ) ||
+				header.numberOfStateFields > header.numberOfFields )
+			error = "truncated";
+	}
+	if( !error.empty() ) {
+		const std::string s{ "Error reading erosion snapshot '" + filename + "': " + error };
+		logbook::log_msg( logbook::TERRAIN, logbook::ERROR, s );
+		if( nullptr != m_data )
+			munmap( const_cast<char *>( m_data ), m_size );
+		if( m_file >= 0 )
+			close( m_file );
+		throw std::runtime_error( s );
+	}
+}
+
+ErosionCheckpoint::~ErosionCheckpoint() {
+	munmap( const_cast<char *>( m_data ), m_size );
+	close( m_file );
+}
+
+const erosionCheckpointHeader_t &ErosionCheckpoint::getHeader() const {
+	return *reinterpret_cast<const erosionCheckpointHeader_t *>( m_data );
+}
+
+const float *ErosionCheckpoint::getField( const uint32_t field ) const {
+	const erosionCheckpointHeader_t &header{ getHeader() };
+	return reinterpret_cast<const float *>( m_data + sizeof( header ) ) +
+			field * erosionCheckpointPlaneSize( header.width, header.height );
+}
+
+void ErosionCheckpoint::restore( HydroErosionMDH07 &erosion ) const {
+	const erosionCheckpointHeader_t &header{ getHeader() };
+	if( header.numberOfStateFields != erosion.getNumberOfStateFields() ) {
+		const std::string s{ "Erosion snapshot '" + m_filename + "' has " + std::to_string( header.numberOfStateFields ) +
+				" state fields, the solver " + std::to_string( erosion.getNumberOfStateFields() ) };
+		logbook::log_msg( logbook::TERRAIN, logbook::ERROR, s );
+		throw std::runtime_error( s );
+	}
+	if( header.width != erosion.getTerrain().getWidth() || header.height != erosion.getTerrain().getHeight() )
+		erosion.resize( header.width, header.height );
+	for( uint32_t field{0}; field < header.numberOfStateFields; ++field ) {
+		ErosionField &f{ erosion.getStateField( static_cast<HydroErosionMDH07::stateField_t>( field ) ) };
+		const float *const plane{ getField( field ) };
+		for( uint32_t y{0}; y < header.height; ++y )
+			std::copy_n( plane + static_cast<size_t>( y ) * header.width, header.width, f.row( y ) );
+	}
+	erosion.stateChanged();
+	erosion.setProgress( header.iteration, header.simulatedTime, header.lastTimeStep, header.maxSpeed );
+	logbook::log_msg( logbook::TERRAIN, logbook::INFO, "Erosion restarted from '" + m_filename + "' at iteration " +
+			std::to_string( header.iteration ) );
+}
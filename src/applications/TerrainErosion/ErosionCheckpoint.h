@@ -0,0 +1,148 @@
+
+/**
+ * Binary snapshots of the erosion solver, which are also checkpoints to restart from.
+ * A fixed header is followed by the fields as planes of width * height floats, row major, without ghost
+ * cells: first the solver's state fields, then the velocity in x and y for inspection. Planes are padded to
+ * a multiple of 64 bytes, so every plane of a mapped file is aligned and can be used in place.
+ *
+ * ErosionSnapshotWriter copies the fields into one of two buffers and a background thread writes it,
+ * while the solver continues. ErosionCheckpoint maps a file read only, to inspect it or to load the state
+ * back into a solver.
+ */
+
+#pragma once
+
+#include "HydroErosionMDH07.h"
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+struct erosionCheckpointHeader_t {
+	char magic[8];
+	uint32_t version;
+	uint32_t width;
+	uint32_t height;
+	// State fields, the rest of the planes are derived fields
+	uint32_t numberOfStateFields;
+	uint32_t numberOfFields;
+	// For the time step after a restart
+	float lastTimeStep;
+	uint64_t iteration;
+	double simulatedTime;
+	float maxSpeed;
+	uint32_t reserved[3];
+};
+
+static_assert( sizeof( erosionCheckpointHeader_t ) == 64, "Erosion checkpoint header must not be padded" );
+
+constexpr char EROSION_CHECKPOINT_MAGIC[8]{ 'O', 'R', 'F', 'N', 'E', 'R', 'O', 'S' };
+
+constexpr uint32_t EROSION_CHECKPOINT_VERSION{ 1 };
+
+// Floats from the start of a plane to the next
+inline size_t erosionCheckpointPlaneSize( const uint32_t width, const uint32_t height ) {
+	return ( static_cast<size_t>( width ) * height + 15 ) / 16 * 16;
+}
+
+class ErosionSnapshotWriter {
+public:
+
+	ErosionSnapshotWriter();
+
+	// Waits for snapshots in flight
+	virtual ~ErosionSnapshotWriter();
+
+	ErosionSnapshotWriter( const ErosionSnapshotWriter & ) = delete;
+
+	ErosionSnapshotWriter &operator=( const ErosionSnapshotWriter & ) = delete;
+
+	/**
+	 * Copy the solver's fields and have them written to filename in the background. The file appears
+	 * complete or not at all. Returns false, and drops the snapshot, if both buffers are still busy.
+	 */
+	bool write( const HydroErosionMDH07 &erosion, const std::string &filename );
+
+	// Block until all snapshots are written
+	void flush();
+
+	uint64_t getNumberOfWritten() const;
+
+	uint64_t getNumberOfDropped() const;
+
+	uint64_t getNumberOfFailed() const;
+
+private:
+	struct buffer_t {
+		erosionCheckpointHeader_t header;
+		std::vector<float> planes;
+		std::string filename;
+		// Filled and waiting for the writer or being written
+		bool busy{ false };
+	};
+
+	buffer_t m_buffers[2];
+
+	std::thread m_thread;
+
+	mutable std::mutex m_mutex;
+
+	std::condition_variable m_pending;
+
+	std::condition_variable m_done;
+
+	// Buffers in the order they were filled
+	std::vector<buffer_t *> m_queue;
+
+	uint64_t m_written{0};
+
+	uint64_t m_dropped{0};
+
+	uint64_t m_failed{0};
+
+	bool m_stop{ false };
+
+	void work();
+
+	static bool writeFile( const buffer_t &buffer );
+
+};
+
+class ErosionCheckpoint {
+public:
+
+	/**
+	 * Map a snapshot file read only.
+	 * Throws std::runtime_error if it can't be opened or is not a valid snapshot.
+	 */
+	ErosionCheckpoint( const std::string &filename );
+
+	virtual ~ErosionCheckpoint();
+
+	ErosionCheckpoint( const ErosionCheckpoint & ) = delete;
+
+	ErosionCheckpoint &operator=( const ErosionCheckpoint & ) = delete;
+
+	const erosionCheckpointHeader_t &getHeader() const;
+
+	// Plane of a field, width * height floats row major
+	const float *getField( const uint32_t field ) const;
+
+	/**
+	 * Resize the solver if needed, copy the state fields and continue at the iteration of the snapshot.
+	 * Throws std::runtime_error if the solver has a different number of state fields.
+	 */
+	void restore( HydroErosionMDH07 &erosion ) const;
+
+private:
+	std::string m_filename;
+
+	int m_file{-1};
+
+	size_t m_size{0};
+
+	const char *m_data{ nullptr };
+
+};
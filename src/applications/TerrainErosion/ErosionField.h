@@ -0,0 +1,118 @@
+
+/**
+ * One scalar field of the erosion solver: a flat, 64 byte aligned array of floats with a ring of
+ * ghost cells around the grid. Rows are padded so that every row's first cell is aligned and a row
+ * can be processed in whole simd vectors. Stencils can read one cell beyond the grid without checks.
+ */
+
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+
+class ErosionField {
+public:
+	// Floats in front of the first cell of a row; the left ghost cell is the last of them
+	static constexpr uint32_t PADDING{ 16 };
+
+	// Alignment of rows in floats, 64 bytes
+	static constexpr uint32_t ALIGNMENT{ 16 };
+
+	ErosionField() = default;
+
+	ErosionField( const uint32_t width, const uint32_t height ) {
+		resize( width, height );
+	}
+
+	~ErosionField() {
+		std::free( m_memory );
+	}
+
+	ErosionField( const ErosionField & ) = delete;
+
+	ErosionField &operator=( const ErosionField & ) = delete;
+
+	// Allocate and zero, ghost cells included
+	void resize( const uint32_t width, const uint32_t height ) {
+		std::free( m_memory );
+		m_width = width;
+		m_height = height;
+		// Room for the right ghost cell and a whole vector beyond the last cell
+		m_stride = ( PADDING + width + 1 + ALIGNMENT - 1 ) / ALIGNMENT * ALIGNMENT;
+		const size_t size{ static_cast<size_t>( m_stride ) * ( height + 2 ) * sizeof( float ) };
+		m_memory = static_cast<float *>( std::aligned_alloc( ALIGNMENT * sizeof( float ), size ) );
+		if( nullptr == m_memory )
+			throw std::bad_alloc{};
+		std::memset( m_memory, 0, size );
+	}
+
+	uint32_t getWidth() const {
+		return m_width;
+	}
+
+	uint32_t getHeight() const {
+		return m_height;
+	}
+
+	// Distance between rows in floats
+	uint32_t getStride() const {
+		return m_stride;
+	}
+
+	// First cell of row y, -1 <= y <= height. row( y )[-1] and row( y )[width] are ghost cells.
+	float *row( const int32_t y ) {
+		return m_memory + static_cast<size_t>( y + 1 ) * m_stride + PADDING;
+	}
+
+	const float *row( const int32_t y ) const {
+		return m_memory + static_cast<size_t>( y + 1 ) * m_stride + PADDING;
+	}
+
+	float &at( const int32_t x, const int32_t y ) {
+		return row( y )[x];
+	}
+
+	float at( const int32_t x, const int32_t y ) const {
+		return row( y )[x];
+	}
+
+	void fill( const float value ) {
+		for( int32_t y{-1}; y <= static_cast<int32_t>( m_height ); ++y )
+			std::fill( row( y ) - 1, row( y ) + m_width + 1, value );
+	}
+
+	// Ghost cells repeat the nearest grid cell, so differences across the edge are 0
+	void clampGhosts() {
+		for( uint32_t y{0}; y < m_height; ++y ) {
+			row( y )[-1] = row( y )[0];
+			row( y )[m_width] = row( y )[m_width - 1];
+		}
+		std::memcpy( row( -1 ) - 1, row( 0 ) - 1, ( m_width + 2 ) * sizeof( float ) );
+		std::memcpy( row( m_height ) - 1, row( m_height - 1 ) - 1, ( m_width + 2 ) * sizeof( float ) );
+	}
+
+	// Cheap exchange of the contents of double buffered fields of the same size
+	void swap( ErosionField &other ) {
+		std::swap( m_memory, other.m_memory );
+		std::swap( m_width, other.m_width );
+		std::swap( m_height, other.m_height );
+		std::swap( m_stride, other.m_stride );
+	}
+
+	size_t getSizeInMemory() const {
+		return static_cast<size_t>( m_stride ) * ( m_height + 2 ) * sizeof( float );
+	}
+
+private:
+	float *m_memory{ nullptr };
+
+	uint32_t m_width{ 0 };
+
+	uint32_t m_height{ 0 };
+
+	uint32_t m_stride{ 0 };
+
+};
@@ -0,0 +1,96 @@
+
+#include "ErosionKernels.h"
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+
+namespace erosion_kernels {
+
+void fluxRowScalar( const fluxRow_t &row, const int32_t first, const int32_t last ) {
+	const float *const b{ row.terrain };
+	const float *const d{ row.water };
+	for( int32_t x{ first }; x < last; ++x ) {
+		const float h{ b[x] + d[x] };
+		// No flow through a boundary
+		const float fl{ row.flowLeft > 0.0f ?
+				std::max( 0.0f, row.fluxLeft[x] + row.flowLeft * ( h - ( b[x - 1] + d[x - 1] ) ) ) : 0.0f };
+		const float fr{ row.flowRight > 0.0f ?
+				std::max( 0.0f, row.fluxRight[x] + row.flowRight * ( h - ( b[x + 1] + d[x + 1] ) ) ) : 0.0f };
+		const float ft{ row.flowTop > 0.0f ?
+				std::max( 0.0f, row.fluxTop[x] + row.flowTop * ( h - ( row.terrainTop[x] + row.waterTop[x] ) ) ) : 0.0f };
+		const float fb{ row.flowBottom > 0.0f ?
+				std::max( 0.0f, row.fluxBottom[x] + row.flowBottom * ( h - ( row.terrainBottom[x] + row.waterBottom[x] ) ) ) : 0.0f };
+		// Limit outflow to the water in the cell via scaling factor K
+		const float outflow{ fl + fr + ft + fb };
+		const float scalingFactor_K{ outflow > 0.0f ? std::min( 1.0f, d[x] * row.volumePerHeight / outflow ) : 1.0f };
+		row.fluxLeft[x] = fl * scalingFactor_K;
+		row.fluxRight[x] = fr * scalingFactor_K;
+		row.fluxTop[x] = ft * scalingFactor_K;
+		row.fluxBottom[x] = fb * scalingFactor_K;
+	}
+}
+
+float velocityRowScalar( const velocityRow_t &row, const int32_t width ) {
+	float maxSpeed{ 0.0f };
+	for( int32_t x{0}; x < width; ++x ) {
+		// Water passing through the cell in x and y direction
+		const float averagePassingWater_WX{
+			( ( row.fluxRight[x - 1] - row.fluxLeft[x] ) + ( row.fluxRight[x] - row.fluxLeft[x + 1] ) ) * 0.5f
+		};
+		const float averagePassingWater_WY{
+			( ( row.fluxBottomAbove[x] - row.fluxTop[x] ) + ( row.fluxBottom[x] - row.fluxTopBelow[x] ) ) * 0.5f
+		};
+		const float meanWaterHeight{ ( row.waterBefore[x] + row.waterAfter[x] ) * 0.5f };
+		float vx{ 0.0f };
+		float vy{ 0.0f };
+		if( meanWaterHeight > row.minWaterHeight ) {
+			const float crossSection{ row.cellsize * meanWaterHeight };
+			vx = averagePassingWater_WX / crossSection;
+			vy = averagePassingWater_WY / crossSection;
+		}
+		row.velocityX[x] = vx;
+		row.velocityY[x] = vy;
+		const float outflow{ ( row.fluxLeft[x] + row.fluxRight[x] ) + ( row.fluxTop[x] + row.fluxBottom[x] ) };
+		if( meanWaterHeight > row.wetWaterHeight && outflow < LIMITED_OUTFLOW * row.waterBefore[x] * row.volumePerHeight ) {
+			const float waveSpeed{ std::sqrt( row.gravity * meanWaterHeight ) };
+			maxSpeed = std::max( maxSpeed, std::max( std::abs( vx ), std::abs( vy ) ) + waveSpeed );
+		}
+	}
+	return maxSpeed;
+}
+
+void advectRowScalar( const advectRow_t &row, const int32_t first, const int32_t last ) {
+	const float maxX{ static_cast<float>( row.maxX ) };
+	const float maxY{ static_cast<float>( row.maxY ) };
+	for( int32_t x{ first }; x < last; ++x ) {
+		// Backtrace, clamped to the grid
+		const float px{ std::min( std::max( x - row.velocityX[x] * row.toCells, 0.0f ), maxX ) };
+		const float py{ std::min( std::max( row.y - row.velocityY[x] * row.toCells, 0.0f ), maxY ) };
+		const float floorX{ std::floor( px ) };
+		const float floorY{ std::floor( py ) };
+		const float fx{ px - floorX };
+		const float fy{ py - floorY };
+		// The next cell is the same one on the last row or column
+		const int32_t x0{ static_cast<int32_t>( floorX ) };
+		const int32_t y0{ static_cast<int32_t>( floorY ) };
+		const size_t index{ static_cast<size_t>( y0 ) * row.stride + x0 };
+		const size_t right{ x0 < row.maxX ? 1u : 0u };
+		const size_t below{ y0 < row.maxY ? static_cast<size_t>( row.stride ) : 0u };
+		const float s00{ row.source[index] };
+		const float s10{ row.source[index + right] };
+		const float s01{ row.source[index + below] };
+		const float s11{ row.source[index + below + right] };
+		const float top{ s00 + ( s10 - s00 ) * fx };
+		const float bottom{ s01 + ( s11 - s01 ) * fx };
+		row.result[x] = top + ( bottom - top ) * fy;
+	}
+}
+
+const kernels_t &selectKernels( const bool allowSimd ) {
+	static const kernels_t scalar{ fluxRowScalar, velocityRowScalar, advectRowScalar, "scalar" };
+	static const kernels_t avx2{ fluxRowAVX2, velocityRowAVX2, advectRowAVX2, "avx2" };
+	static const bool hasAVX2{ 0 != __builtin_cpu_supports( "avx2" ) };
+	return allowSimd && hasAVX2 ? avx2 : scalar;
+}
+
+}
@@ -0,0 +1,118 @@
+
+/**
+ * Row kernels of the erosion solver's stencil passes, in a scalar and an AVX2 version.
+ * The AVX2 versions are compiled with a target attribute, so no special compiler flags are
+ * needed, and are selected at runtime if the cpu supports them. They don't use fma, so both
+ * versions give bitwise identical results.
+ */
+
+#pragma once
+
+#include <cstdint>
+
+namespace erosion_kernels {
+
+/**
+ * Outflow flux of the cells [first, last) of a row. Rows above and below are the neighbour rows.
+ * The flow factors are dt * A * g / l per direction, 0 on a grid boundary.
+ */
+typedef struct {
+	const float *terrain;
+	const float *water;
+	const float *terrainTop;
+	const float *waterTop;
+	const float *terrainBottom;
+	const float *waterBottom;
+	float *fluxLeft;
+	float *fluxRight;
+	float *fluxTop;
+	float *fluxBottom;
+	float flowLeft;
+	float flowRight;
+	float flowTop;
+	float flowBottom;
+	// Water volume per cell height, l * l / dt
+	float volumePerHeight;
+} fluxRow_t;
+
+/**
+ * Velocity of the cells [0, width) of a row from the flux and the water height before and after the flow.
+ * Flux of the rows above and below must be given, ghost cells in x are read.
+ */
+typedef struct {
+	const float *waterBefore;
+	const float *waterAfter;
+	const float *fluxLeft;
+	const float *fluxRight;
+	const float *fluxTop;
+	const float *fluxBottom;
+	const float *fluxBottomAbove;
+	const float *fluxTopBelow;
+	float *velocityX;
+	float *velocityY;
+	float cellsize;
+	float gravity;
+	// Below this mean water height a cell is dry and has no velocity
+	float minWaterHeight;
+	// Water volume per cell height, l * l / dt
+	float volumePerHeight;
+	// Shallower cells don't count for the signal speed
+	float wetWaterHeight;
+} velocityRow_t;
+
+/**
+ * Semi-Lagrangian advection of the cells [first, last) of row y: the value at the point the cell's content
+ * came from during the time step, interpolated bilinearly from the source field. Points outside the grid are
+ * clamped to its edge. The AVX2 version addresses the source with 32 bit offsets from its first cell.
+ */
+typedef struct {
+	// First cell of the source field and distance between its rows
+	const float *source;
+	int32_t stride;
+	// Last cell in x and y
+	int32_t maxX;
+	int32_t maxY;
+	const float *velocityX;
+	const float *velocityY;
+	float *result;
+	int32_t y;
+	// Velocity to distance in cells, dt / l
+	float toCells;
+} advectRow_t;
+
+// Outflow of a cell above this part of its water has been limited by the scaling factor K
+constexpr float LIMITED_OUTFLOW{ 0.99f };
+
+typedef void ( *fluxRowFunction )( const fluxRow_t &row, const int32_t first, const int32_t last );
+
+// Returns the fastest signal speed of the row for the time step limit, the largest velocity
+// component plus the speed of gravity waves sqrt( g * d ). Only wet cells count whose outflow has
+// not been limited to their water; the limit keeps the others stable, and their velocity, flux over
+// a tiny water height, is meaningless.
+typedef float ( *velocityRowFunction )( const velocityRow_t &row, const int32_t width );
+
+typedef void ( *advectRowFunction )( const advectRow_t &row, const int32_t first, const int32_t last );
+
+typedef struct {
+	fluxRowFunction flux;
+	velocityRowFunction velocity;
+	advectRowFunction advect;
+	const char *name;
+} kernels_t;
+
+void fluxRowScalar( const fluxRow_t &row, const int32_t first, const int32_t last );
+
+float velocityRowScalar( const velocityRow_t &row, const int32_t width );
+
+void advectRowScalar( const advectRow_t &row, const int32_t first, const int32_t last );
+
+void fluxRowAVX2( const fluxRow_t &row, const int32_t first, const int32_t last );
+
+float velocityRowAVX2( const velocityRow_t &row, const int32_t width );
+
+void advectRowAVX2( const advectRow_t &row, const int32_t first, const int32_t last );
+
+// AVX2 if the cpu has it and it is not disabled, scalar otherwise
+const kernels_t &selectKernels( const bool allowSimd = true );
+
+}
@@ -0,0 +1,172 @@
+
+/**
+ * AVX2 versions of the erosion row kernels, 8 cells per instruction. Same operations in the
+ * same order as the scalar versions, remaining cells of a row go to the scalar kernels.
+ */
+
+#include "ErosionKernels.h"
+#include <immintrin.h>
+#include <algorithm>
+
+namespace erosion_kernels {
+
+namespace {
+
+__attribute__(( target( "avx2" ) ))
+inline __m256 totalHeight( const float *terrain, const float *water ) {
+	return _mm256_add_ps( _mm256_loadu_ps( terrain ), _mm256_loadu_ps( water ) );
+}
+
+// max( 0, flux + flow * ( h - neighbourHeight ) ), 0 if there's no flow in this direction
+__attribute__(( target( "avx2" ) ))
+inline __m256 outflow( const float *flux, const __m256 flow, const __m256 open, const __m256 h, const __m256 neighbour ) {
+	const __m256 f{ _mm256_add_ps( _mm256_loadu_ps( flux ), _mm256_mul_ps( flow, _mm256_sub_ps( h, neighbour ) ) ) };
+	return _mm256_and_ps( _mm256_max_ps( f, _mm256_setzero_ps() ), open );
+}
+
+__attribute__(( target( "avx2" ) ))
+inline __m256 openMask( const float flow ) {
+	return _mm256_castsi256_ps( _mm256_set1_epi32( flow > 0.0f ? -1 : 0 ) );
+}
+
+}
+
+__attribute__(( target( "avx2" ) ))
+void fluxRowAVX2( const fluxRow_t &row, const int32_t first, const int32_t last ) {
+	const float *const b{ row.terrain };
+	const float *const d{ row.water };
+	const __m256 zero{ _mm256_setzero_ps() };
+	const __m256 one{ _mm256_set1_ps( 1.0f ) };
+	const __m256 flowLeft{ _mm256_set1_ps( row.flowLeft ) };
+	const __m256 flowRight{ _mm256_set1_ps( row.flowRight ) };
+	const __m256 flowTop{ _mm256_set1_ps( row.flowTop ) };
+	const __m256 flowBottom{ _mm256_set1_ps( row.flowBottom ) };
+	const __m256 openLeft{ openMask( row.flowLeft ) };
+	const __m256 openRight{ openMask( row.flowRight ) };
+	const __m256 openTop{ openMask( row.flowTop ) };
+	const __m256 openBottom{ openMask( row.flowBottom ) };
+	const __m256 volumePerHeight{ _mm256_set1_ps( row.volumePerHeight ) };
+	int32_t x{ first };
+	for( ; x + 8 <= last; x += 8 ) {
+		const __m256 h{ totalHeight( b + x, d + x ) };
+		const __m256 fl{ outflow( row.fluxLeft + x, flowLeft, openLeft, h, totalHeight( b + x - 1, d + x - 1 ) ) };
+		const __m256 fr{ outflow( row.fluxRight + x, flowRight, openRight, h, totalHeight( b + x + 1, d + x + 1 ) ) };
+		const __m256 ft{ outflow( row.fluxTop + x, flowTop, openTop, h, totalHeight( row.terrainTop + x, row.waterTop + x ) ) };
+		const __m256 fb{ outflow( row.fluxBottom + x, flowBottom, openBottom, h,
+				totalHeight( row.terrainBottom + x, row.waterBottom + x ) ) };
+		// Limit outflow to the water in the cell via scaling factor K
+		const __m256 total{ _mm256_add_ps( _mm256_add_ps( _mm256_add_ps( fl, fr ), ft ), fb ) };
+		const __m256 available{ _mm256_mul_ps( _mm256_loadu_ps( d + x ), volumePerHeight ) };
+		const __m256 scalingFactor_K{ _mm256_blendv_ps( one,
+				_mm256_min_ps( one, _mm256_div_ps( available, total ) ), _mm256_cmp_ps( total, zero, _CMP_GT_OQ ) ) };
+		_mm256_storeu_ps( row.fluxLeft + x, _mm256_mul_ps( fl, scalingFactor_K ) );
+		_mm256_storeu_ps( row.fluxRight + x, _mm256_mul_ps( fr, scalingFactor_K ) );
+		_mm256_storeu_ps( row.fluxTop + x, _mm256_mul_ps( ft, scalingFactor_K ) );
+		_mm256_storeu_ps( row.fluxBottom + x, _mm256_mul_ps( fb, scalingFactor_K ) );
+	}
+	fluxRowScalar( row, x, last );
+}
+
+__attribute__(( target( "avx2" ) ))
+float velocityRowAVX2( const velocityRow_t &row, const int32_t width ) {
+	const __m256 half{ _mm256_set1_ps( 0.5f ) };
+	const __m256 cellsize{ _mm256_set1_ps( row.cellsize ) };
+	const __m256 gravity{ _mm256_set1_ps( row.gravity ) };
+	const __m256 minWaterHeight{ _mm256_set1_ps( row.minWaterHeight ) };
+	const __m256 limitedOutflow{ _mm256_set1_ps( LIMITED_OUTFLOW ) };
+	const __m256 volumePerHeight{ _mm256_set1_ps( row.volumePerHeight ) };
+	const __m256 wetWaterHeight{ _mm256_set1_ps( row.wetWaterHeight ) };
+	const __m256 absMask{ _mm256_castsi256_ps( _mm256_set1_epi32( 0x7fffffff ) ) };
+	__m256 maxSpeed{ _mm256_setzero_ps() };
+	int32_t x{0};
+	for( ; x + 8 <= width; x += 8 ) {
+		// Water passing through the cell in x and y direction
+		const __m256 averagePassingWater_WX{ _mm256_mul_ps( _mm256_add_ps(
+				_mm256_sub_ps( _mm256_loadu_ps( row.fluxRight + x - 1 ), _mm256_loadu_ps( row.fluxLeft + x ) ),
+				_mm256_sub_ps( _mm256_loadu_ps( row.fluxRight + x ), _mm256_loadu_ps( row.fluxLeft + x + 1 ) ) ), half ) };
+		const __m256 averagePassingWater_WY{ _mm256_mul_ps( _mm256_add_ps(
+				_mm256_sub_ps( _mm256_loadu_ps( row.fluxBottomAbove + x ), _mm256_loadu_ps( row.fluxTop + x ) ),
+				_mm256_sub_ps( _mm256_loadu_ps( row.fluxBottom + x ), _mm256_loadu_ps( row.fluxTopBelow + x ) ) ), half ) };
+		const __m256 meanWaterHeight{ _mm256_mul_ps(
+				_mm256_add_ps( _mm256_loadu_ps( row.waterBefore + x ), _mm256_loadu_ps( row.waterAfter + x ) ), half ) };
+		// Dry cells have no velocity
+		const __m256 wet{ _mm256_cmp_ps( meanWaterHeight, minWaterHeight, _CMP_GT_OQ ) };
+		const __m256 crossSection{ _mm256_mul_ps( cellsize, meanWaterHeight ) };
+		const __m256 vx{ _mm256_and_ps( _mm256_div_ps( averagePassingWater_WX, crossSection ), wet ) };
+		const __m256 vy{ _mm256_and_ps( _mm256_div_ps( averagePassingWater_WY, crossSection ), wet ) };
+		_mm256_storeu_ps( row.velocityX + x, vx );
+		_mm256_storeu_ps( row.velocityY + x, vy );
+		// Only wet cells whose outflow has not been limited
+		const __m256 outflow{ _mm256_add_ps(
+				_mm256_add_ps( _mm256_loadu_ps( row.fluxLeft + x ), _mm256_loadu_ps( row.fluxRight + x ) ),
+				_mm256_add_ps( _mm256_loadu_ps( row.fluxTop + x ), _mm256_loadu_ps( row.fluxBottom + x ) ) ) };
+		const __m256 unlimited{ _mm256_cmp_ps( outflow, _mm256_mul_ps( _mm256_mul_ps( limitedOutflow,
+				_mm256_loadu_ps( row.waterBefore + x ) ), volumePerHeight ), _CMP_LT_OQ ) };
+		const __m256 counts{ _mm256_and_ps( unlimited, _mm256_cmp_ps( meanWaterHeight, wetWaterHeight, _CMP_GT_OQ ) ) };
+		const __m256 waveSpeed{ _mm256_sqrt_ps( _mm256_mul_ps( gravity, meanWaterHeight ) ) };
+		maxSpeed = _mm256_max_ps( maxSpeed, _mm256_and_ps( _mm256_add_ps(
+				_mm256_max_ps( _mm256_and_ps( vx, absMask ), _mm256_and_ps( vy, absMask ) ), waveSpeed ), counts ) );
+	}
+	alignas( 32 ) float lanes[8];
+	_mm256_store_ps( lanes, maxSpeed );
+	float result{ *std::max_element( lanes, lanes + 8 ) };
+	if( x < width ) {
+		// Remaining cells with the scalar kernel on a shifted row
+		velocityRow_t tail{ row };
+		tail.waterBefore += x;
+		tail.waterAfter += x;
+		tail.fluxLeft += x;
+		tail.fluxRight += x;
+		tail.fluxTop += x;
+		tail.fluxBottom += x;
+		tail.fluxBottomAbove += x;
+		tail.fluxTopBelow += x;
+		tail.velocityX += x;
+		tail.velocityY += x;
+		result = std::max( result, velocityRowScalar( tail, width - x ) );
+	}
+	return result;
+}
+
+__attribute__(( target( "avx2" ) ))
+void advectRowAVX2( const advectRow_t &row, const int32_t first, const int32_t last ) {
+	const __m256 zero{ _mm256_setzero_ps() };
+	const __m256 maxX{ _mm256_set1_ps( static_cast<float>( row.maxX ) ) };
+	const __m256 maxY{ _mm256_set1_ps( static_cast<float>( row.maxY ) ) };
+	const __m256 toCells{ _mm256_set1_ps( row.toCells ) };
+	const __m256 y{ _mm256_set1_ps( static_cast<float>( row.y ) ) };
+	const __m256i lastX{ _mm256_set1_epi32( row.maxX ) };
+	const __m256i lastY{ _mm256_set1_epi32( row.maxY ) };
+	const __m256i stride{ _mm256_set1_epi32( row.stride ) };
+	const __m256i one{ _mm256_set1_epi32( 1 ) };
+	const __m256 lanes{ _mm256_setr_ps( 0.0f, 1.0f, 2.0f, 3.0f, 4.0f, 5.0f, 6.0f, 7.0f ) };
+	int32_t x{ first };
+	for( ; x + 8 <= last; x += 8 ) {
+		// Backtrace, clamped to the grid
+		const __m256 cellX{ _mm256_add_ps( _mm256_set1_ps( static_cast<float>( x ) ), lanes ) };
+		const __m256 px{ _mm256_min_ps( _mm256_max_ps( _mm256_sub_ps( cellX,
+				_mm256_mul_ps( _mm256_loadu_ps( row.velocityX + x ), toCells ) ), zero ), maxX ) };
+		const __m256 py{ _mm256_min_ps( _mm256_max_ps( _mm256_sub_ps( y,
+				_mm256_mul_ps( _mm256_loadu_ps( row.velocityY + x ), toCells ) ), zero ), maxY ) };
+		const __m256 floorX{ _mm256_floor_ps( px ) };
+		const __m256 floorY{ _mm256_floor_ps( py ) };
+		const __m256 fx{ _mm256_sub_ps( px, floorX ) };
+		const __m256 fy{ _mm256_sub_ps( py, floorY ) };
+		// The next cell is the same one on the last row or column
+		const __m256i x0{ _mm256_cvttps_epi32( floorX ) };
+		const __m256i y0{ _mm256_cvttps_epi32( floorY ) };
+		const __m256i index{ _mm256_add_epi32( _mm256_mullo_epi32( y0, stride ), x0 ) };
+		const __m256i right{ _mm256_and_si256( _mm256_cmpgt_epi32( lastX, x0 ), one ) };
+		const __m256i below{ _mm256_and_si256( _mm256_cmpgt_epi32( lastY, y0 ), stride ) };
+		const __m256 s00{ _mm256_i32gather_ps( row.source, index, 4 ) };
+		const __m256 s10{ _mm256_i32gather_ps( row.source, _mm256_add_epi32( index, right ), 4 ) };
+		const __m256 s01{ _mm256_i32gather_ps( row.source, _mm256_add_epi32( index, below ), 4 ) };
+		const __m256 s11{ _mm256_i32gather_ps( row.source, _mm256_add_epi32( _mm256_add_epi32( index, below ), right ), 4 ) };
+		const __m256 top{ _mm256_add_ps( s00, _mm256_mul_ps( _mm256_sub_ps( s10, s00 ), fx ) ) };
+		const __m256 bottom{ _mm256_add_ps( s01, _mm256_mul_ps( _mm256_sub_ps( s11, s01 ), fx ) ) };
+		_mm256_storeu_ps( row.result + x, _mm256_add_ps( top, _mm256_mul_ps( _mm256_sub_ps( bottom, top ), fy ) ) );
+	}
+	advectRowScalar( row, x, last );
+}
+
+}
@@ -1,243 +1,772 @@
 
 #include "HydroErosionMDH07.h"
-#include <iomanip>
+#include "base/logbook.h"
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+#include <string>
 
-HydroErosionMDH07::HydroErosionMDH07() : orf_n::renderable( "HydroErosionMDH07" ) {}
+using namespace orf_n;
+
+static_assert( HydroErosionMDH07::NUMBER_OF_STATE_FIELDS - HydroErosionMDH07::LAYER_0 == HydroErosionMDH07::MAX_LAYERS,
+		"A state field per stratum" );
+
+HydroErosionMDH07::HydroErosionMDH07() :
+		orf_n::renderable( "HydroErosionMDH07" ) {}
+
+HydroErosionMDH07::HydroErosionMDH07( const settings_t &settings ) :
+		orf_n::renderable( "HydroErosionMDH07" ), m_settings{ settings } {}
 
 HydroErosionMDH07::~HydroErosionMDH07() {}
 
+template<typename K>
+void HydroErosionMDH07::forEachBand( const K &kernel ) {
+	m_pool->parallel_for( 0, m_settings.height, [&kernel]( const uint32_t first, const uint32_t last ) {
+		kernel( static_cast<int32_t>( first ), static_cast<int32_t>( last ) );
+	}, BLOCK_SIZE );
+}
+
+template<typename K>
+void HydroErosionMDH07::activeSpansOfBlockRow( const uint32_t by, const K &kernel ) {
+	const int32_t width{ static_cast<int32_t>( m_settings.width ) };
+	const int32_t height{ static_cast<int32_t>( m_settings.height ) };
+	const uint8_t *const active{ &m_activeBlocks[by * m_blocksX] };
+	const int32_t first{ static_cast<int32_t>( by * BLOCK_SIZE ) };
+	const int32_t last{ std::min( height, first + static_cast<int32_t>( BLOCK_SIZE ) ) };
+	// Consecutive active blocks are one span
+	for( uint32_t bx{0}; bx < m_blocksX; ) {
+		if( !active[bx] ) {
+			++bx;
+			continue;
+		}
+		uint32_t end{ bx + 1 };
+		while( end < m_blocksX && active[end] )
+			++end;
+		kernel( by, first, last, static_cast<int32_t>( bx * BLOCK_SIZE ),
+				std::min( width, static_cast<int32_t>( end * BLOCK_SIZE ) ) );
+		bx = end;
+	}
+}
+
+template<typename K>
+void HydroErosionMDH07::forEachActiveSpan( const K &kernel ) {
+	m_pool->parallel_for( 0, m_blocksY, [&]( const uint32_t firstBlockRow, const uint32_t lastBlockRow ) {
+		for( uint32_t by{ firstBlockRow }; by < lastBlockRow; ++by )
+			activeSpansOfBlockRow( by, kernel );
+	}, 1 );
+}
+
+template<typename K>
+void HydroErosionMDH07::forEachActiveSpanAlternating( const K &kernel ) {
+	// Even block rows, then odd ones, same colour rows are a block row apart
+	for( uint32_t colour{0}; colour < 2; ++colour )
+		m_pool->parallel_for( 0, ( m_blocksY + 1 - colour ) / 2, [&]( const uint32_t first, const uint32_t last ) {
+			for( uint32_t i{ first }; i < last; ++i )
+				activeSpansOfBlockRow( 2 * i + colour, kernel );
+		}, 1 );
+}
+
 void HydroErosionMDH07::render() {
-	// @todo time step determines stability !
-	const float deltatime{ 1.0f / 60.0f };
-	const float globalLevel{ 0.1f };
-	resetWaterTable( globalLevel );
-	outputHeight();
+	if( m_settings.adaptiveTimeStep )
+		simulate( m_settings.timeStep );
+	else
+		step( m_settings.timeStep );
+}
+
+uint32_t HydroErosionMDH07::simulate( const float duration ) {
+	uint32_t steps{0};
+	float remaining{ duration };
+	while( remaining > 0.0f ) {
+		// Equal sub-steps for the rest of the duration, no short step at the end
+		const float substeps{ std::ceil( remaining / getStableTimeStep() ) };
+		const float deltatime{ substeps > 1.0f ? remaining / substeps : remaining };
+		step( deltatime );
+		remaining -= deltatime;
+		++steps;
+	}
+	return steps;
+}
+
+float HydroErosionMDH07::getStableTimeStep() const {
+	// Nothing known before the first step
+	if( 0 == m_iteration )
+		return std::clamp( m_settings.timeStep, m_settings.minTimeStep, m_settings.maxTimeStep );
+	float deltatime{ m_settings.maxTimeStep };
+	if( m_maxSpeed > 0.0f )
+		deltatime = m_settings.courantNumber * m_settings.cellsize / m_maxSpeed;
+	// Flow speeds up during a step, grow slowly after calm phases
+	deltatime = std::min( deltatime, 2.0f * m_lastTimeStep );
+	return std::clamp( deltatime, m_settings.minTimeStep, m_settings.maxTimeStep );
+}
+
+void HydroErosionMDH07::step( const float deltatime ) {
+	if( m_settings.boundaryWaterLevel >= 0.0f )
+		resetWaterTable( m_settings.boundaryWaterLevel );
 	// d1 from dt
 	incrementWater( deltatime );
-	outputTempWater();
-	// d2, f, v from d1, bt, ft
+	// f from d1, b
 	calculateFlux( deltatime );
-	outputFlux();
-	calculateVelocityField( deltatime );
-	outputVelocity();
+	wakeBlocks();
+	// d2 from d1, f
 	updateWaterheight( deltatime );
-	// bt, s1 from v, bt, st
-	calculateErosionDeposition();
+	// v from f, d1, d2
+	calculateVelocityField( deltatime );
+	// bt, s1 from v, b, s
+	calculateErosionDeposition( deltatime );
 	// st from s1, v
 	transportSediment( deltatime );
 	// dt from d2
 	evaporateWater( deltatime );
+	// b from b, on all blocks
+	if( m_settings.thermalErosionConstant_KT > 0.0f )
+		weatherTerrain( deltatime );
+	// Rain would wake all blocks again
+	if( m_settings.aDropOfRain * m_settings.rainMultiplier <= 0.0f )
+		deactivateDryBlocks();
+	++m_iteration;
+	m_simulatedTime += deltatime;
+	m_lastTimeStep = deltatime;
+	// Stability condition: nothing must travel more than a cell per time step
+	if( m_maxSpeed * deltatime > m_settings.cellsize && !m_reportedUnstable ) {
+		logbook::log_msg( logbook::TERRAIN, logbook::WARNING, "Erosion: time step " + std::to_string( deltatime ) +
+				"s too long, simulation unstable" );
+		m_reportedUnstable = true;
+	}
 }
 
 // Reset watertable on boundaries to "global level"
 void HydroErosionMDH07::resetWaterTable( const float globalLevel ) {
-	for( uint16_t i{0}; i < SETTINGS.dimension; ++i )
-		for( uint16_t j{0}; j < SETTINGS.dimension; ++j )
-			if( i == 0 || j == 0 )
-				grid[i][j].waterHeight_d2 = globalLevel;
+	std::fill( m_water.row( 0 ), m_water.row( 0 ) + m_settings.width, globalLevel );
+	for( uint32_t y{1}; y < m_settings.height; ++y )
+		m_water.at( 0, y ) = globalLevel;
+	if( globalLevel > 0.0f ) {
+		std::fill_n( m_activeBlocks.begin(), m_blocksX, 1 );
+		for( uint32_t by{1}; by < m_blocksY; ++by )
+			m_activeBlocks[by * m_blocksX] = 1;
+	}
 }
 
 // Increase due to rain or river flow
 void HydroErosionMDH07::incrementWater( const float deltatime ) {
 	// @todo: this can be result of some more complex process
-	float waterThisTurn_r{ SETTINGS.aDropOfRain * SETTINGS.rainMultiplier };
-	for( uint16_t i{0}; i < SETTINGS.dimension; ++i )
-		for( uint16_t j{0}; j < SETTINGS.dimension; ++j ) {
-			float inc{ grid[i][j].waterHeight_d2 + deltatime * waterThisTurn_r };
-			grid[i][j].tempWaterHeight_d1 = inc;
+	const float waterThisTurn_r{ deltatime * m_settings.aDropOfRain * m_settings.rainMultiplier };
+	const int32_t width{ static_cast<int32_t>( m_settings.width ) };
+	if( waterThisTurn_r <= 0.0f )
+		return;
+	// Rain falls everywhere
+	std::fill( m_activeBlocks.begin(), m_activeBlocks.end(), 1 );
+	forEachBand( [&]( const int32_t first, const int32_t last ) {
+		for( int32_t y{ first }; y < last; ++y ) {
+			float *const d{ m_water.row( y ) };
+			for( int32_t x{0}; x < width; ++x )
+				d[x] += waterThisTurn_r;
 		}
+	} );
 }
 
 void HydroErosionMDH07::calculateFlux( const float deltatime ) {
-	const float g{ SETTINGS.gravity };
-	const float pl{ SETTINGS.pipeLength };
-	const float flowTime{ deltatime * SETTINGS.pipeCrossSection };
+	const int32_t width{ static_cast<int32_t>( m_settings.width ) };
+	const int32_t height{ static_cast<int32_t>( m_settings.height ) };
+	const float flowFactor{ deltatime * m_settings.pipeCrossSection * m_settings.gravity / m_settings.cellsize };
+	const float volumePerHeight{ m_settings.cellsize * m_settings.cellsize / deltatime };
 	// Calculate each cell's outflow flux to the 4 adjacent cells by total height differences,
-	// pipe length/cross section. Limit flow to water in the cell via scaling factor K
-	for( uint16_t i{0}; i < SETTINGS.dimension; ++i )
-		for( uint16_t j{0}; j < SETTINGS.dimension; ++j ) {
-			// Readability
-			cell_t *c{ &grid[i][j] };
-			// Flux at the boundaries is set to 0.0f
-			if( i == 0 )
-				c->flux_f[left] = 0.0f;
-			else {
-				const float flow{ flowTime * ( ( g * c->getTotalHeightDiff( grid[i-1][j] ) ) / pl ) };
-				c->flux_f[left] = std::max( 0.0f, c->flux_f[left] ) + flow;
-			}
-			if( i == SETTINGS.dimension - 1 )
-				c->flux_f[right] = 0.0f;
-			else {
-				const float flow{ flowTime * ( ( g * c->getTotalHeightDiff( grid[i+1][j] ) ) / pl ) };
-				c->flux_f[right] = std::max( 0.0f, c->flux_f[right] ) + flow;
+	// pipe length/cross section. Limit flow to water in the cell via scaling factor K.
+	// The first and last cell of a row are edge passes without flow to the left and right.
+	forEachActiveSpan( [&]( const uint32_t by, const int32_t first, const int32_t last, const int32_t x0, const int32_t x1 ) {
+		for( int32_t y{ first }; y < last; ++y ) {
+			erosion_kernels::fluxRow_t row{
+				m_terrain.row( y ), m_water.row( y ), m_terrain.row( y - 1 ), m_water.row( y - 1 ),
+				m_terrain.row( y + 1 ), m_water.row( y + 1 ),
+				m_fluxLeft.row( y ), m_fluxRight.row( y ), m_fluxTop.row( y ), m_fluxBottom.row( y ),
+				flowFactor, flowFactor, y == 0 ? 0.0f : flowFactor, y == height - 1 ? 0.0f : flowFactor, volumePerHeight
+			};
+			int32_t begin{ x0 };
+			int32_t end{ x1 };
+			if( 0 == begin ) {
+				row.flowLeft = 0.0f;
+				erosion_kernels::fluxRowScalar( row, 0, 1 );
+				row.flowLeft = flowFactor;
+				++begin;
 			}
-			if( j == 0 )
-				c->flux_f[top] = 0.0f;
-			else {
-				const float flow{ flowTime * ( ( g * c->getTotalHeightDiff( grid[i][j-1] ) ) / pl ) };
-				c->flux_f[top] = std::max( 0.0f, c->flux_f[top] ) + flow;
+			if( width == end ) {
+				row.flowRight = 0.0f;
+				erosion_kernels::fluxRowScalar( row, width - 1, width );
+				row.flowRight = flowFactor;
+				--end;
 			}
-			if( j == SETTINGS.dimension - 1 )
-				c->flux_f[bottom] = 0.0f;
-			else {
-				const float flow{ flowTime * ( ( g * c->getTotalHeightDiff( grid[i][j+1] ) ) / pl ) };
-				c->flux_f[bottom] = std::max( 0.0f, c->flux_f[bottom] ) + flow;
+			m_kernels->flux( row, begin, end );
+		}
+		// Wake inactive neighbours this span sends water to
+		const uint32_t bx0{ x0 / BLOCK_SIZE };
+		const uint32_t bx1{ ( x1 - 1 ) / BLOCK_SIZE };
+		for( int32_t y{ first }; y < last; ++y ) {
+			if( bx0 > 0 && m_fluxLeft.at( x0, y ) > 0.0f )
+				m_wakeBlocks[by * m_blocksX + bx0 - 1].store( 1, std::memory_order_relaxed );
+			if( bx1 + 1 < m_blocksX && m_fluxRight.at( x1 - 1, y ) > 0.0f )
+				m_wakeBlocks[by * m_blocksX + bx1 + 1].store( 1, std::memory_order_relaxed );
+		}
+		for( int32_t x{ x0 }; x < x1; ++x ) {
+			if( by > 0 && m_fluxTop.at( x, first ) > 0.0f )
+				m_wakeBlocks[( by - 1 ) * m_blocksX + x / BLOCK_SIZE].store( 1, std::memory_order_relaxed );
+			if( by + 1 < m_blocksY && m_fluxBottom.at( x, last - 1 ) > 0.0f )
+				m_wakeBlocks[( by + 1 ) * m_blocksX + x / BLOCK_SIZE].store( 1, std::memory_order_relaxed );
+		}
+	} );
+}
+
+void HydroErosionMDH07::wakeBlocks() {
+	for( size_t i{0}; i < m_activeBlocks.size(); ++i )
+		if( m_wakeBlocks[i].exchange( 0, std::memory_order_relaxed ) )
+			m_activeBlocks[i] = 1;
+}
+
+void HydroErosionMDH07::deactivateDryBlocks() {
+	const int32_t width{ static_cast<int32_t>( m_settings.width ) };
+	const int32_t height{ static_cast<int32_t>( m_settings.height ) };
+	const float threshold{ m_settings.activeThreshold };
+	m_pool->parallel_for( 0, m_blocksY, [&]( const uint32_t firstBlockRow, const uint32_t lastBlockRow ) {
+		for( uint32_t by{ firstBlockRow }; by < lastBlockRow; ++by ) {
+			const int32_t first{ static_cast<int32_t>( by * BLOCK_SIZE ) };
+			const int32_t last{ std::min( height, first + static_cast<int32_t>( BLOCK_SIZE ) ) };
+			for( uint32_t bx{0}; bx < m_blocksX; ++bx ) {
+				uint8_t &active{ m_activeBlocks[by * m_blocksX + bx] };
+				if( !active )
+					continue;
+				const int32_t x0{ static_cast<int32_t>( bx * BLOCK_SIZE ) };
+				const int32_t x1{ std::min( width, x0 + static_cast<int32_t>( BLOCK_SIZE ) ) };
+				bool dry{ true };
+				for( int32_t y{ first }; dry && y < last; ++y ) {
+					const float *const d{ m_water.row( y ) };
+					for( int32_t x{ x0 }; x < x1; ++x )
+						dry = dry && d[x] <= threshold;
+				}
+				if( !dry )
+					continue;
+				// Without water to carry it sediment settles, the rest of the water is gone.
+				// Skipped passes don't write the second buffers, so they must hold the same.
+				for( int32_t y{ first }; y < last; ++y ) {
+					float *const b{ m_terrain.row( y ) };
+					float *const s{ m_sediment.row( y ) };
+					for( int32_t x{ x0 }; x < x1; ++x )
+						b[x] += s[x];
+					if( m_settings.numberOfLayers > 0 ) {
+						float *const top{ m_layers[0].row( y ) };
+						for( int32_t x{ x0 }; x < x1; ++x )
+							top[x] += s[x];
+					}
+					std::copy( b + x0, b + x1, m_terrainNext.row( y ) + x0 );
+					for( ErosionField *field : { &m_water, &m_waterNext, &m_sediment, &m_sedimentNext, &m_fluxLeft,
+							&m_fluxRight, &m_fluxTop, &m_fluxBottom, &m_velocityX, &m_velocityY } )
+						std::fill( field->row( y ) + x0, field->row( y ) + x1, 0.0f );
+				}
+				active = 0;
 			}
-			const float scalingFactor_K{
-				std::min( 1.0f, ( c->tempWaterHeight_d1 * SETTINGS.pipeCrossSection ) /
-						( deltatime * ( c->flux_f[left] + c->flux_f[right] + c->flux_f[top] + c->flux_f[bottom] ) ) )
-			};
-			c->flux_f[left] *= scalingFactor_K;
-			c->flux_f[right] *= scalingFactor_K;
-			c->flux_f[top] *= scalingFactor_K;
-			c->flux_f[bottom] *= scalingFactor_K;
 		}
+	}, 1 );
+	m_terrain.clampGhosts();
+	m_terrainNext.clampGhosts();
 }
 
 void HydroErosionMDH07::updateWaterheight( const float deltatime ) {
-	for( uint16_t i{0}; i < SETTINGS.dimension; ++i )
-		for( uint16_t j{0}; j < SETTINGS.dimension; ++j ) {
-			cell_t c{ grid[i][j] };
-			const float volumeChange{ deltatime *
-				( grid[i-1][j].flux_f[right] + grid[i+1][j].flux_f[left] +
-				grid[i][j-1].flux_f[bottom] + grid[i][j+1].flux_f[top ] ) -
-				( c.flux_f[left] + c.flux_f[right] + c.flux_f[top] + c.flux_f[bottom] ) };
-			c.waterHeight_d2 = c.tempWaterHeight_d1 + ( volumeChange / SETTINGS.pipeCrossSection );
-		};
+	const float toHeight{ deltatime / ( m_settings.cellsize * m_settings.cellsize ) };
+	// Ghost cells of the flux fields are 0
+	forEachActiveSpan( [&]( uint32_t, const int32_t first, const int32_t last, const int32_t x0, const int32_t x1 ) {
+		for( int32_t y{ first }; y < last; ++y ) {
+			const float *const d{ m_water.row( y ) };
+			const float *const fL{ m_fluxLeft.row( y ) };
+			const float *const fR{ m_fluxRight.row( y ) };
+			const float *const fT{ m_fluxTop.row( y ) };
+			const float *const fB{ m_fluxBottom.row( y ) };
+			const float *const fBAbove{ m_fluxBottom.row( y - 1 ) };
+			const float *const fTBelow{ m_fluxTop.row( y + 1 ) };
+			float *const d2{ m_waterNext.row( y ) };
+			for( int32_t x{ x0 }; x < x1; ++x ) {
+				const float inflow{ fR[x - 1] + fL[x + 1] + fBAbove[x] + fTBelow[x] };
+				const float outflow{ fL[x] + fR[x] + fT[x] + fB[x] };
+				d2[x] = std::max( 0.0f, d[x] + toHeight * ( inflow - outflow ) );
+			}
+		}
+	} );
 }
 
 void HydroErosionMDH07::calculateVelocityField( const float deltatime ) {
-	for( uint16_t i{0}; i < SETTINGS.dimension; ++i )
-		for( uint16_t j{0}; j < SETTINGS.dimension; ++j ) {
-			cell_t *c{ &grid[i][j] };
-			// Water flowing in x direction. @todo Flow is set to 0 at boundaries. There must be a better way
-			const float averagePassingWater_WX{
-				( grid[i == 0 ? 0 : i-1][j].flux_f[right] - c->flux_f[left] +
-				  grid[i == SETTINGS.dimension ? SETTINGS.dimension : i][j].flux_f[left] - c->flux_f[right] ) / 2.0f
+	const float volumePerHeight{ m_settings.cellsize * m_settings.cellsize / deltatime };
+	// Below this water height a cell is considered dry, no velocity
+	const float minWaterHeight{ 1e-6f };
+	std::fill( m_bandMaxSpeed.begin(), m_bandMaxSpeed.end(), 0.0f );
+	forEachActiveSpan( [&]( const uint32_t by, const int32_t first, const int32_t last, const int32_t x0, const int32_t x1 ) {
+		float maxSpeed{ m_bandMaxSpeed[by] };
+		for( int32_t y{ first }; y < last; ++y ) {
+			const erosion_kernels::velocityRow_t row{
+				m_water.row( y ) + x0, m_waterNext.row( y ) + x0,
+				m_fluxLeft.row( y ) + x0, m_fluxRight.row( y ) + x0, m_fluxTop.row( y ) + x0, m_fluxBottom.row( y ) + x0,
+				m_fluxBottom.row( y - 1 ) + x0, m_fluxTop.row( y + 1 ) + x0,
+				m_velocityX.row( y ) + x0, m_velocityY.row( y ) + x0, m_settings.cellsize, m_settings.gravity,
+				minWaterHeight, volumePerHeight, m_settings.wetWaterHeight
 			};
-			const float averagePassingWater_WY{
-				( grid[i][j == 0 ? 0 : j-1].flux_f[bottom] - c->flux_f[top] +
-				  grid[i][j == SETTINGS.dimension ? SETTINGS.dimension : j+1].flux_f[top] - c->flux_f[bottom] ) / 2.0f
-			};
-			// @todo Should be waterheigt of last two turns. Eventually extra pass.
-			const float meanWaterHeight{ ( c->tempWaterHeight_d1 + c->waterHeight_d2 ) / 2.0f };
-			c->velocity_v.x = averagePassingWater_WX / ( SETTINGS.distanceX_LX * meanWaterHeight );
-			c->velocity_v.y = averagePassingWater_WY / ( SETTINGS.distanceY_LY * meanWaterHeight );
-			// @todo: Stability condition: adjust time step to smaller values for smaller distances in grid
-			if( deltatime * averagePassingWater_WX > SETTINGS.distanceX_LX ||
-				deltatime * averagePassingWater_WY > SETTINGS.distanceY_LY )
-				std::cout << "Time step too long, simulation unstable\n";
-		}
-}
-
-void HydroErosionMDH07::calculateErosionDeposition() {
-	for( uint16_t i{0}; i < SETTINGS.dimension; ++i )
-		for( uint16_t j{0}; j < SETTINGS.dimension; ++j ) {
-			cell_t c{ grid[i][j] };
-			// Calculate maximum angle
-			const float m1{ std::max( c.getTotalHeightDiff( grid[i-1][j] ), c.getTotalHeightDiff( grid[i+1][j] ) ) };
-			const float m2{ std::max( c.getTotalHeightDiff( grid[i][j-1] ), c.getTotalHeightDiff( grid[i][j+1] ) ) };
-			const float angle{ std::atan( omath::radians( std::max( m1, m2 ) / SETTINGS.distanceX_LX ) ) };
-			// Transport capacity from tilt angle and flow velocity
-			c.sedimentTransportCapacity_C = SETTINGS.sedimentCapacityConstant_KC *
-					std::max( std::sin( angle ), SETTINGS.minFlowAngle ) * omath::magnitude( c.velocity_v );
-			// Compare C with suspended sediment
-			if( c.sedimentTransportCapacity_C >= c.tempSuspendedSediment_st ) {
-				// Erosion
-				const float t{ c.sedimentTransportCapacity_C - c.tempSuspendedSediment_st };
-				c.terrainHeight_b -= SETTINGS.dissolvingConstant_KS * t;
-				c.suspendedSedimentThisTurn_s1 += SETTINGS.dissolvingConstant_KS * t;
-			} else {
-				// Deposition
-				const float t{ c.tempSuspendedSediment_st - c.sedimentTransportCapacity_C };
-				c.terrainHeight_b += SETTINGS.depositionConstant_KD * t;
-				c.suspendedSedimentThisTurn_s1 -= SETTINGS.depositionConstant_KD * t;
+			maxSpeed = std::max( maxSpeed, m_kernels->velocity( row, x1 - x0 ) );
+		}
+		m_bandMaxSpeed[by] = maxSpeed;
+	} );
+	m_maxSpeed = *std::max_element( m_bandMaxSpeed.begin(), m_bandMaxSpeed.end() );
+	// d2 is the current water height from here
+	m_water.swap( m_waterNext );
+}
+
+void HydroErosionMDH07::calculateErosionDeposition( const float deltatime ) {
+	if( m_settings.numberOfLayers > 0 ) {
+		calculateLayeredErosionDeposition( deltatime );
+		return;
+	}
+	const float inverseDistance{ 0.5f / m_settings.cellsize };
+	const float KC{ m_settings.sedimentCapacityConstant_KC };
+	const float KS{ std::min( 1.0f, m_settings.dissolvingConstant_KS * deltatime ) };
+	const float KD{ std::min( 1.0f, m_settings.depositionConstant_KD * deltatime ) };
+	const float minFlowAngle{ m_settings.minFlowAngle };
+	// Ghost cells repeat the edge, gradients there are one sided
+	forEachActiveSpan( [&]( uint32_t, const int32_t first, const int32_t last, const int32_t x0, const int32_t x1 ) {
+		for( int32_t y{ first }; y < last; ++y ) {
+			const float *const b{ m_terrain.row( y ) };
+			const float *const bTop{ m_terrain.row( y - 1 ) };
+			const float *const bBottom{ m_terrain.row( y + 1 ) };
+			const float *const s{ m_sediment.row( y ) };
+			const float *const vx{ m_velocityX.row( y ) };
+			const float *const vy{ m_velocityY.row( y ) };
+			float *const bt{ m_terrainNext.row( y ) };
+			float *const s1{ m_sedimentNext.row( y ) };
+			for( int32_t x{ x0 }; x < x1; ++x ) {
+				// Sine of the tilt angle from the terrain gradient
+				const float gx{ ( b[x + 1] - b[x - 1] ) * inverseDistance };
+				const float gy{ ( bBottom[x] - bTop[x] ) * inverseDistance };
+				const float slope2{ gx * gx + gy * gy };
+				const float sinTilt{ std::sqrt( slope2 / ( 1.0f + slope2 ) ) };
+				// Transport capacity from tilt angle and flow velocity
+				const float sedimentTransportCapacity_C{
+					KC * std::max( sinTilt, minFlowAngle ) * std::sqrt( vx[x] * vx[x] + vy[x] * vy[x] )
+				};
+				// Compare C with suspended sediment
+				if( sedimentTransportCapacity_C >= s[x] ) {
+					// Erosion
+					const float t{ KS * ( sedimentTransportCapacity_C - s[x] ) };
+					bt[x] = b[x] - t;
+					s1[x] = s[x] + t;
+				} else {
+					// Deposition
+					const float t{ KD * ( s[x] - sedimentTransportCapacity_C ) };
+					bt[x] = b[x] + t;
+					s1[x] = s[x] - t;
+				}
+			}
+		}
+	} );
+	m_terrain.swap( m_terrainNext );
+	m_terrain.clampGhosts();
+}
+
+void HydroErosionMDH07::calculateLayeredErosionDeposition( const float deltatime ) {
+	const uint32_t numberOfLayers{ m_settings.numberOfLayers };
+	const float inverseDistance{ 0.5f / m_settings.cellsize };
+	const float minFlowAngle{ m_settings.minFlowAngle };
+	// Constants of the materials, the bedrock last
+	float KC[MAX_LAYERS + 1];
+	float KS[MAX_LAYERS + 1];
+	for( uint32_t l{0}; l <= numberOfLayers; ++l ) {
+		const material_t &material{ m_settings.materials[l] };
+		KC[l] = m_settings.sedimentCapacityConstant_KC * material.sedimentCapacityConstant;
+		KS[l] = std::min( 1.0f, m_settings.dissolvingConstant_KS * deltatime / material.hardness );
+	}
+	const float KD{ std::min( 1.0f, m_settings.depositionConstant_KD * deltatime ) };
+	forEachActiveSpan( [&]( uint32_t, const int32_t first, const int32_t last, const int32_t x0, const int32_t x1 ) {
+		float *layers[MAX_LAYERS];
+		for( int32_t y{ first }; y < last; ++y ) {
+			const float *const b{ m_terrain.row( y ) };
+			const float *const bTop{ m_terrain.row( y - 1 ) };
+			const float *const bBottom{ m_terrain.row( y + 1 ) };
+			const float *const s{ m_sediment.row( y ) };
+			const float *const vx{ m_velocityX.row( y ) };
+			const float *const vy{ m_velocityY.row( y ) };
+			float *const bt{ m_terrainNext.row( y ) };
+			float *const s1{ m_sedimentNext.row( y ) };
+			for( uint32_t l{0}; l < numberOfLayers; ++l )
+				layers[l] = m_layers[l].row( y );
+			for( int32_t x{ x0 }; x < x1; ++x ) {
+				// Topmost stratum that is left
+				uint32_t l{0};
+				while( l < numberOfLayers && layers[l][x] <= 0.0f )
+					++l;
+				const float gx{ ( b[x + 1] - b[x - 1] ) * inverseDistance };
+				const float gy{ ( bBottom[x] - bTop[x] ) * inverseDistance };
+				const float slope2{ gx * gx + gy * gy };
+				const float sinTilt{ std::sqrt( slope2 / ( 1.0f + slope2 ) ) };
+				const float sedimentTransportCapacity_C{
+					KC[l] * std::max( sinTilt, minFlowAngle ) * std::sqrt( vx[x] * vx[x] + vy[x] * vy[x] )
+				};
+				if( sedimentTransportCapacity_C >= s[x] ) {
+					// Erosion, down to the next stratum at most
+					float t{ KS[l] * ( sedimentTransportCapacity_C - s[x] ) };
+					if( l < numberOfLayers ) {
+						t = std::min( t, layers[l][x] );
+						layers[l][x] -= t;
+					}
+					bt[x] = b[x] - t;
+					s1[x] = s[x] + t;
+				} else {
+					// Deposition on the top stratum
+					const float t{ KD * ( s[x] - sedimentTransportCapacity_C ) };
+					layers[0][x] += t;
+					bt[x] = b[x] + t;
+					s1[x] = s[x] - t;
+				}
 			}
 		}
+	} );
+	m_terrain.swap( m_terrainNext );
+	m_terrain.clampGhosts();
+}
+
+void HydroErosionMDH07::removeFromLayers( const int32_t x, const int32_t y, float height ) {
+	for( uint32_t l{0}; height > 0.0f && l < m_settings.numberOfLayers; ++l ) {
+		float &thickness{ m_layers[l].at( x, y ) };
+		const float removed{ std::min( thickness, height ) };
+		thickness -= removed;
+		height -= removed;
+	}
 }
 
 // Transport sediment with velocity field
 void HydroErosionMDH07::transportSediment( const float deltatime ) {
-	for( uint16_t i{0}; i < SETTINGS.dimension; ++i )
-		for( uint16_t j{0}; j < SETTINGS.dimension; ++j ) {
-			cell_t c{ grid[i][j] };
-			// @todo: check for boundaries, if not on grid interpolate the four neighbours
-			const omath::vec2 v{c.velocity_v};
-			c.sudpendedSediment_s =
-					grid[i - (uint16_t)(v.x * deltatime)][j - (uint16_t)(v.y * deltatime)].suspendedSedimentThisTurn_s1;
+	const int32_t maxX{ static_cast<int32_t>( m_settings.width ) - 1 };
+	const int32_t maxY{ static_cast<int32_t>( m_settings.height ) - 1 };
+	const float lastX{ static_cast<float>( maxX ) };
+	const float lastY{ static_cast<float>( maxY ) };
+	const float toCells{ deltatime / m_settings.cellsize };
+	// Weight w with which the backtraces sample each cell, scattered like advectRowScalar() gathers.
+	// Stable time steps move less than a cell, so a block row only adds to its own and the neighbouring rows.
+	// Cells of inactive blocks hold no sediment, their weight doesn't matter and stays 0.
+	forEachActiveSpanAlternating( [&]( uint32_t, const int32_t first, const int32_t last, const int32_t x0, const int32_t x1 ) {
+		for( int32_t y{ first }; y < last; ++y ) {
+			const float *const vx{ m_velocityX.row( y ) };
+			const float *const vy{ m_velocityY.row( y ) };
+			for( int32_t x{ x0 }; x < x1; ++x ) {
+				const float px{ std::min( std::max( static_cast<float>( x ) - vx[x] * toCells, 0.0f ), lastX ) };
+				const float py{ std::min( std::max( static_cast<float>( y ) - vy[x] * toCells, 0.0f ), lastY ) };
+				// Not negative, truncation is the floor
+				const int32_t sx{ static_cast<int32_t>( px ) };
+				const int32_t sy{ static_cast<int32_t>( py ) };
+				const float fx{ px - static_cast<float>( sx ) };
+				const float fy{ py - static_cast<float>( sy ) };
+				const int32_t right{ sx < maxX ? sx + 1 : sx };
+				const int32_t below{ sy < maxY ? sy + 1 : sy };
+				float *const top{ m_sedimentWeight.row( sy ) };
+				float *const bottom{ m_sedimentWeight.row( below ) };
+				// Samples within the span are active, only the ones beyond need a look at their block
+				if( sx >= x0 && right < x1 && sy >= first && below < last ) {
+					top[sx] += ( 1.0f - fx ) * ( 1.0f - fy );
+					top[right] += fx * ( 1.0f - fy );
+					bottom[sx] += ( 1.0f - fx ) * fy;
+					bottom[right] += fx * fy;
+					continue;
+				}
+				const uint8_t *const activeTop{ &m_activeBlocks[sy / BLOCK_SIZE * m_blocksX] };
+				const uint8_t *const activeBottom{ &m_activeBlocks[below / BLOCK_SIZE * m_blocksX] };
+				if( activeTop[sx / BLOCK_SIZE] )
+					top[sx] += ( 1.0f - fx ) * ( 1.0f - fy );
+				if( activeTop[right / BLOCK_SIZE] )
+					top[right] += fx * ( 1.0f - fy );
+				if( activeBottom[sx / BLOCK_SIZE] )
+					bottom[sx] += ( 1.0f - fx ) * fy;
+				if( activeBottom[right / BLOCK_SIZE] )
+					bottom[right] += fx * fy;
+			}
 		}
+	} );
+	// Limit each cell's outflow to its sediment: a cell sampled with w > 1 gives s1 / w per unit of weight,
+	// one sampled with w < 1 keeps s1 * ( 1 - w ). s1 becomes the part given, the weight field the part kept.
+	forEachActiveSpan( [&]( uint32_t, const int32_t first, const int32_t last, const int32_t x0, const int32_t x1 ) {
+		for( int32_t y{ first }; y < last; ++y ) {
+			float *const s1{ m_sedimentNext.row( y ) };
+			float *const w{ m_sedimentWeight.row( y ) };
+			for( int32_t x{ x0 }; x < x1; ++x ) {
+				const float kept{ s1[x] * std::max( 0.0f, 1.0f - w[x] ) };
+				s1[x] /= std::max( 1.0f, w[x] );
+				w[x] = kept;
+			}
+		}
+	} );
+	erosion_kernels::advectRow_t row{};
+	row.source = m_sedimentNext.row( 0 );
+	row.stride = static_cast<int32_t>( m_sedimentNext.getStride() );
+	row.maxX = maxX;
+	row.maxY = maxY;
+	row.toCells = toCells;
+	// The simd gather takes 32 bit offsets into the source
+	const bool fitsGather{ static_cast<uint64_t>( m_sedimentNext.getStride() ) * m_settings.height <= INT32_MAX };
+	const erosion_kernels::advectRowFunction advect{ fitsGather ? m_kernels->advect : erosion_kernels::advectRowScalar };
+	// Sediment of the point the water came from, s1 to st, plus what stayed
+	forEachActiveSpan( [&]( uint32_t, const int32_t first, const int32_t last, const int32_t x0, const int32_t x1 ) {
+		erosion_kernels::advectRow_t r{ row };
+		for( int32_t y{ first }; y < last; ++y ) {
+			r.velocityX = m_velocityX.row( y );
+			r.velocityY = m_velocityY.row( y );
+			r.result = m_sediment.row( y );
+			r.y = y;
+			advect( r, x0, x1 );
+			float *const w{ m_sedimentWeight.row( y ) };
+			for( int32_t x{ x0 }; x < x1; ++x ) {
+				r.result[x] += w[x];
+				w[x] = 0.0f;
+			}
+		}
+	} );
 }
 
 void HydroErosionMDH07::evaporateWater( const float deltatime ) {
-	for( uint16_t i{0}; i < SETTINGS.dimension; ++i )
-		for( uint16_t j{0}; j < SETTINGS.dimension; ++j ) {
-			cell_t c{ grid[i][j] };
-			c.waterHeight_d2 *= 1.0f - SETTINGS.evaporationConstant_KE * deltatime;
+	const float remaining{ std::max( 0.0f, 1.0f - m_settings.evaporationConstant_KE * deltatime ) };
+	forEachActiveSpan( [&]( uint32_t, const int32_t first, const int32_t last, const int32_t x0, const int32_t x1 ) {
+		for( int32_t y{ first }; y < last; ++y ) {
+			float *const d{ m_water.row( y ) };
+			for( int32_t x{ x0 }; x < x1; ++x )
+				d[x] *= remaining;
 		}
+	} );
+}
+
+void HydroErosionMDH07::weatherTerrain( const float deltatime ) {
+	const int32_t width{ static_cast<int32_t>( m_settings.width ) };
+	const int32_t height{ static_cast<int32_t>( m_settings.height ) };
+	// Heights the talus slope allows to the straight and diagonal neighbours
+	const float talusStraight{ m_settings.talusSlope * m_settings.cellsize };
+	const float talusDiagonal{ talusStraight * std::sqrt( 2.0f ) };
+	// At most half of the largest excess, so a cell doesn't end up below its neighbour
+	const float share{ 0.5f * std::min( 1.0f, m_settings.thermalErosionConstant_KT * deltatime ) };
+	const bool layered{ m_settings.numberOfLayers > 0 };
+	const auto weatherBand = [&]( const uint32_t band ) {
+		const int32_t first{ static_cast<int32_t>( band * BLOCK_SIZE ) };
+		const int32_t last{ std::min( height, first + static_cast<int32_t>( BLOCK_SIZE ) ) };
+		for( int32_t y{ first }; y < last; ++y ) {
+			const float *const up{ m_terrain.row( y - 1 ) };
+			const float *const down{ m_terrain.row( y + 1 ) };
+			// Neighbour rows, none beyond the grid
+			float *const rows[3]{ y > 0 ? m_terrain.row( y - 1 ) : nullptr, m_terrain.row( y ),
+					y + 1 < height ? m_terrain.row( y + 1 ) : nullptr };
+			for( int32_t x{0}; x < width; ++x ) {
+				const float h{ rows[1][x] };
+				// Most cells are stable. Ghost cells may be outdated here, but only add candidates.
+				const float lowestStraight{ std::min( std::min( rows[1][x - 1], rows[1][x + 1] ), std::min( up[x], down[x] ) ) };
+				const float lowestDiagonal{ std::min( std::min( up[x - 1], up[x + 1] ), std::min( down[x - 1], down[x + 1] ) ) };
+				if( h - lowestStraight <= talusStraight && h - lowestDiagonal <= talusDiagonal )
+					continue;
+				float excess[3][3]{};
+				float total{ 0.0f };
+				float maxExcess{ 0.0f };
+				for( int32_t dy{0}; dy < 3; ++dy ) {
+					if( nullptr == rows[dy] )
+						continue;
+					for( int32_t dx{0}; dx < 3; ++dx ) {
+						const int32_t nx{ x + dx - 1 };
+						if( nx < 0 || nx >= width || ( 1 == dx && 1 == dy ) )
+							continue;
+						const float talus{ 1 == dx || 1 == dy ? talusStraight : talusDiagonal };
+						const float e{ h - rows[dy][nx] - talus };
+						if( e > 0.0f ) {
+							excess[dy][dx] = e;
+							total += e;
+							maxExcess = std::max( maxExcess, e );
+						}
+					}
+				}
+				if( maxExcess <= 0.0f )
+					continue;
+				// Spread by the excess to each neighbour, on their top stratum
+				const float moved{ share * maxExcess };
+				rows[1][x] = h - moved;
+				const float perExcess{ moved / total };
+				for( int32_t dy{0}; dy < 3; ++dy )
+					for( int32_t dx{0}; dx < 3; ++dx )
+						if( excess[dy][dx] > 0.0f ) {
+							rows[dy][x + dx - 1] += excess[dy][dx] * perExcess;
+							if( layered )
+								m_layers[0].at( x + dx - 1, y + dy - 1 ) += excess[dy][dx] * perExcess;
+						}
+				if( layered )
+					removeFromLayers( x, y, moved );
+			}
+		}
+	};
+	// Even bands, then odd ones. A band changes its rows and the ones next to it, same colour bands are 2 apart.
+	for( uint32_t colour{0}; colour < 2; ++colour )
+		m_pool->parallel_for( 0, ( m_blocksY + 1 - colour ) / 2, [&]( const uint32_t firstBand, const uint32_t lastBand ) {
+			for( uint32_t i{ firstBand }; i < lastBand; ++i )
+				weatherBand( 2 * i + colour );
+		}, 1 );
+	// Inactive blocks keep the same terrain in both buffers
+	forEachBand( [&]( const int32_t first, const int32_t last ) {
+		const uint32_t by{ static_cast<uint32_t>( first ) / BLOCK_SIZE };
+		for( uint32_t bx{0}; bx < m_blocksX; ++bx ) {
+			if( m_activeBlocks[by * m_blocksX + bx] )
+				continue;
+			const int32_t x0{ static_cast<int32_t>( bx * BLOCK_SIZE ) };
+			const int32_t x1{ std::min( width, x0 + static_cast<int32_t>( BLOCK_SIZE ) ) };
+			for( int32_t y{ first }; y < last; ++y )
+				std::copy( m_terrain.row( y ) + x0, m_terrain.row( y ) + x1, m_terrainNext.row( y ) + x0 );
+		}
+	} );
+	m_terrain.clampGhosts();
+	m_terrainNext.clampGhosts();
 }
 
 void HydroErosionMDH07::setup() {
-	grid = new cell_t *[SETTINGS.dimension];
-	for( uint16_t i{0}; i < SETTINGS.dimension; ++i )
-		grid[i] = new cell_t[SETTINGS.dimension];
-	grid[1][1].terrainHeight_b = 0.1f; grid[1][2].terrainHeight_b = 0.1f; grid[1][3].terrainHeight_b = 0.1f; grid[1][4].terrainHeight_b = 0.1f; grid[1][5].terrainHeight_b = 0.1f; grid[1][6].terrainHeight_b = 0.1f;
-	grid[2][1].terrainHeight_b = 0.1f; grid[2][2].terrainHeight_b = 0.3f; grid[2][3].terrainHeight_b = 0.3f; grid[2][4].terrainHeight_b = 0.3f; grid[2][5].terrainHeight_b = 0.3f; grid[2][6].terrainHeight_b = 0.1f;
-	grid[3][1].terrainHeight_b = 0.1f, grid[3][2].terrainHeight_b = 0.3f; grid[3][3].terrainHeight_b = 0.5f; grid[3][4].terrainHeight_b = 0.5f; grid[3][5].terrainHeight_b = 0.2f; grid[3][6].terrainHeight_b = 0.1f;
-	grid[4][1].terrainHeight_b = 0.1f; grid[4][2].terrainHeight_b = 0.3f; grid[4][3].terrainHeight_b = 0.5f; grid[4][4].terrainHeight_b = 0.5f; grid[4][5].terrainHeight_b = 0.2f; grid[4][6].terrainHeight_b = 0.1f;
-	grid[5][1].terrainHeight_b = 0.1f; grid[5][2].terrainHeight_b = 0.3f; grid[5][3].terrainHeight_b = 0.2f; grid[5][4].terrainHeight_b = 0.2f; grid[5][5].terrainHeight_b = 0.2f; grid[5][6].terrainHeight_b = 0.1f;
-	grid[6][1].terrainHeight_b = 0.1f; grid[6][2].terrainHeight_b = 0.1f; grid[6][3].terrainHeight_b = 0.1f; grid[6][4].terrainHeight_b = 0.1f; grid[6][5].terrainHeight_b = 0.1f; grid[6][6].terrainHeight_b = 0.1f;
-}
-
-void HydroErosionMDH07::outputHeight() {
-	std::cout << "Terrain Height:\n" << std::fixed;
-	for( uint16_t i{0}; i < SETTINGS.dimension; ++i ) {
-		for( uint16_t j{0}; j < SETTINGS.dimension; ++j )
-			std::cout << grid[i][j].terrainHeight_b << ' ';
-		std::cout << std::endl;
-	}
+	m_pool = std::make_unique<thread_pool>( m_settings.numberOfThreads );
+	m_kernels = &erosion_kernels::selectKernels( m_settings.useSimd );
+	resize( m_settings.width, m_settings.height );
+	const uint32_t width{ m_settings.width };
+	const uint32_t height{ m_settings.height };
+	// Default terrain: a few hills and valleys, about a 20th of the grid size high
+	const float amplitude{ 0.05f * std::max( width, height ) * m_settings.cellsize };
+	const float pi{ 3.14159265f };
+	for( uint32_t y{0}; y < height; ++y )
+		for( uint32_t x{0}; x < width; ++x ) {
+			const float u{ static_cast<float>( x ) / width };
+			const float v{ static_cast<float>( y ) / height };
+			m_terrain.at( x, y ) = amplitude * ( 0.5f + 0.25f * std::sin( 6.0f * pi * u ) * std::cos( 4.0f * pi * v ) +
+					0.25f * std::sin( 2.0f * pi * ( u + v ) ) );
+		}
+	m_terrain.clampGhosts();
+	copyTerrain();
+	m_iteration = 0;
+	m_simulatedTime = 0.0;
+	m_lastTimeStep = 0.0f;
+	m_maxSpeed = 0.0f;
+	logbook::log_msg( logbook::TERRAIN, logbook::INFO, "Erosion grid " + std::to_string( width ) + 'x' +
+			std::to_string( height ) + ", " + std::to_string( getSizeInMemory() >> 20 ) + "MB, " +
+			std::to_string( m_pool->get_number_of_threads() ) + " threads, " + m_kernels->name + " kernels" );
 }
 
-void HydroErosionMDH07::outputTempWater() {
-	std::cout << "Temp Water:\n" << std::fixed;
-	for( uint16_t i{0}; i < SETTINGS.dimension; ++i ) {
-		for( uint16_t j{0}; j < SETTINGS.dimension; ++j )
-			std::cout << grid[i][j].tempWaterHeight_d1 << ' ';
-		std::cout << std::endl;
-	}
+void HydroErosionMDH07::resize( const uint32_t width, const uint32_t height ) {
+	if( width < 2 || height < 2 )
+		throw std::runtime_error{ "Erosion grid must be at least 2x2 cells" };
+	if( m_settings.numberOfLayers > MAX_LAYERS )
+		throw std::runtime_error{ "Erosion supports at most " + std::to_string( MAX_LAYERS ) + " strata" };
+	m_settings.width = width;
+	m_settings.height = height;
+	for( ErosionField *field : { &m_terrain, &m_terrainNext, &m_water, &m_waterNext, &m_sediment, &m_sedimentNext,
+			&m_sedimentWeight, &m_fluxLeft, &m_fluxRight, &m_fluxTop, &m_fluxBottom, &m_velocityX, &m_velocityY } )
+		field->resize( width, height );
+	for( uint32_t l{0}; l < MAX_LAYERS; ++l )
+		if( l < m_settings.numberOfLayers )
+			m_layers[l].resize( width, height );
+		else
+			m_layers[l].resize( 0, 0 );
+	// All dry until it rains
+	m_blocksX = ( width + BLOCK_SIZE - 1 ) / BLOCK_SIZE;
+	m_blocksY = ( height + BLOCK_SIZE - 1 ) / BLOCK_SIZE;
+	m_activeBlocks.assign( m_blocksX * m_blocksY, 0 );
+	m_wakeBlocks = std::make_unique<std::atomic<uint8_t>[]>( m_activeBlocks.size() );
+	m_bandMaxSpeed.assign( m_blocksY, 0.0f );
 }
 
-void HydroErosionMDH07::outputFlux() {
-	std::cout << "Flux:\n" << std::fixed;
-	for( uint16_t i{0}; i < SETTINGS.dimension; ++i ) {
-		for( uint16_t j{0}; j < SETTINGS.dimension; ++j )
-			std::cout << grid[i][j].flux_f[left] << '/' << grid[i][j].flux_f[right] << '/' <<
-			grid[i][j].flux_f[top] << '/' << grid[i][j].flux_f[bottom] << ' ';
-		std::cout << std::endl;
-	}
+ErosionField &HydroErosionMDH07::getStateField( const stateField_t field ) {
+	ErosionField *const fields[NUMBER_OF_STATE_FIELDS]{
+		&m_terrain, &m_water, &m_sediment, &m_fluxLeft, &m_fluxRight, &m_fluxTop, &m_fluxBottom,
+		&m_layers[0], &m_layers[1], &m_layers[2], &m_layers[3]
+	};
+	return *fields[field];
 }
 
-void HydroErosionMDH07::outputVelocity() {
-	std::cout << "Velocity:\n" << std::fixed;
-	for( uint16_t i{0}; i < SETTINGS.dimension; ++i ) {
-		for( uint16_t j{0}; j < SETTINGS.dimension; ++j )
-			std::cout << grid[i][j].velocity_v.x << '/' << grid[i][j].velocity_v.y << ' ';
-		std::cout << std::endl;
-	}
+const ErosionField &HydroErosionMDH07::getStateField( const stateField_t field ) const {
+	return const_cast<HydroErosionMDH07 *>( this )->getStateField( field );
+}
+
+uint32_t HydroErosionMDH07::getNumberOfStateFields() const {
+	return LAYER_0 + m_settings.numberOfLayers;
+}
+
+void HydroErosionMDH07::stateChanged() {
+	m_terrain.clampGhosts();
+	copyTerrain();
+	// Dry blocks go inactive after the next step, as they would have without the change
+	std::fill( m_activeBlocks.begin(), m_activeBlocks.end(), 1 );
+}
+
+void HydroErosionMDH07::setTerrain( const float *heights ) {
+	for( uint32_t y{0}; y < m_settings.height; ++y )
+		std::copy_n( heights + static_cast<size_t>( y ) * m_settings.width, m_settings.width, m_terrain.row( y ) );
+	m_terrain.clampGhosts();
+	copyTerrain();
+}
+
+void HydroErosionMDH07::copyTerrain() {
+	for( int32_t y{-1}; y <= static_cast<int32_t>( m_settings.height ); ++y )
+		std::copy( m_terrain.row( y ) - 1, m_terrain.row( y ) + m_settings.width + 1, m_terrainNext.row( y ) - 1 );
+}
+
+HydroErosionMDH07::settings_t &HydroErosionMDH07::getSettings() {
+	return m_settings;
+}
+
+const ErosionField &HydroErosionMDH07::getTerrain() const {
+	return m_terrain;
+}
+
+const ErosionField &HydroErosionMDH07::getWater() const {
+	return m_water;
+}
+
+const ErosionField &HydroErosionMDH07::getSediment() const {
+	return m_sediment;
+}
+
+const ErosionField &HydroErosionMDH07::getVelocityX() const {
+	return m_velocityX;
+}
+
+const ErosionField &HydroErosionMDH07::getVelocityY() const {
+	return m_velocityY;
+}
+
+uint64_t HydroErosionMDH07::getIteration() const {
+	return m_iteration;
+}
+
+double HydroErosionMDH07::getSimulatedTime() const {
+	return m_simulatedTime;
+}
+
+float HydroErosionMDH07::getLastTimeStep() const {
+	return m_lastTimeStep;
+}
+
+void HydroErosionMDH07::setProgress( const uint64_t iteration, const double simulatedTime, const float lastTimeStep,
+		const float maxSpeed ) {
+	m_iteration = iteration;
+	m_simulatedTime = simulatedTime;
+	m_lastTimeStep = lastTimeStep;
+	m_maxSpeed = maxSpeed;
+}
+
+float HydroErosionMDH07::getMaxSpeed() const {
+	return m_maxSpeed;
+}
+
+uint32_t HydroErosionMDH07::getNumberOfActiveBlocks() const {
+	return static_cast<uint32_t>( std::count( m_activeBlocks.begin(), m_activeBlocks.end(), 1 ) );
+}
+
+uint32_t HydroErosionMDH07::getNumberOfBlocks() const {
+	return static_cast<uint32_t>( m_activeBlocks.size() );
+}
+
+size_t HydroErosionMDH07::getSizeInMemory() const {
+	return ( 13 + m_settings.numberOfLayers ) * m_terrain.getSizeInMemory();
 }
 
 void HydroErosionMDH07::cleanup() {
-	for( uint16_t i{0}; i < SETTINGS.dimension; ++i )
-		delete [] grid[i];
-	delete [] grid;
-}
-
-/*
- 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f
- 0.0f, 0.1f, 0.1f, 0.1f, 0.1f, 0.1f, 0.1f, 0.0f
- 0.0f, 0.1f, 0.3f, 0.3f, 0.3f, 0.3f, 0.1f, 0.0f
- 0.0f, 0.1f, 0.3f, 0.5f, 0.5f, 0.2f, 0.1f, 0.0f
- 0.0f, 0.1f, 0.3f, 0.5f, 0.5f, 0.2f, 0.1f, 0.0f
- 0.0f, 0.1f, 0.3f, 0.2f, 0.2f, 0.2f, 0.1f, 0.0f
- 0.0f, 0.1f, 0.1f, 0.1f, 0.1f, 0.1f, 0.1f, 0.0f
- 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f
- */
+	for( ErosionField *field : { &m_terrain, &m_terrainNext, &m_water, &m_waterNext, &m_sediment, &m_sedimentNext,
+			&m_sedimentWeight, &m_fluxLeft, &m_fluxRight, &m_fluxTop, &m_fluxBottom, &m_velocityX, &m_velocityY } )
+		field->resize( 0, 0 );
+	for( ErosionField &layer : m_layers )
+		layer.resize( 0, 0 );
+	m_activeBlocks.clear();
+	m_wakeBlocks.reset();
+	m_pool.reset();
+}
@@ -1,30 +1,176 @@
-
 #pragma once
 
-#include "omath/vec2.h"
+#include "ErosionField.h"
+#include "ErosionKernels.h"
+#include "base/thread_pool.h"
 #include "scene/renderable.h"
-//#include <random>
-
-// general @todo: set boundary flows to 0 !
-// extend model to the eight neighbour cells !
+#include <array>
+#include <atomic>
+#include <memory>
+#include <vector>
 
+/**
+ * Hydraulic erosion after Mei, Decaudin, Hu 2007, "Fast Hydraulic Erosion Simulation and Visualization on GPU".
+ * Water flows through virtual pipes to the 4 neighbours of a cell. Flow dissolves terrain up to the sediment
+ * transport capacity and deposits the excess, sediment is carried along with the velocity field.
+ *
+ * Each quantity is a field of its own, see ErosionField.h. The passes are stencil kernels over bands of rows,
+ * run in parallel on a thread pool, with simd row kernels where the cpu has them, see ErosionKernels.h.
+ * A pass that reads neighbours of a field it changes writes a second buffer, the buffers are swapped afterwards.
+ * Flux through the grid boundaries is 0.
+ *
+ * The passes only run over active blocks of BLOCK_SIZE x BLOCK_SIZE cells. Rain activates all blocks, a block
+ * where the water is below a threshold becomes inactive, and a block that gets flux from an active neighbour
+ * wakes up. After rain, only the blocks where water still flows are simulated.
+ *
+ * The terrain can be made of strata of different materials. Each cell has the thickness of a few layers from
+ * the top, a field per layer, and bedrock below them. Erosion dissolves the topmost layer that is left by its
+ * hardness and capacity, deposited sediment goes to the top layer. The total terrain height is kept as without
+ * strata, so the flux, velocity and transport passes are the same.
+ *
+ * Optional thermal weathering runs after the hydraulic passes on all blocks. It changes the terrain in place,
+ * in two sweeps over every other band of rows, so bands that run at the same time never touch the same rows.
+ */
 class HydroErosionMDH07 : public orf_n::renderable {
 public:
 
-	//static std::minstd_rand randomEngine(42);
-	// [0.0, 1.0)
-	//static std::uniform_real_distribution<float> rGen( 0.0f, 1.0f );
+	// Most strata above the bedrock
+	static constexpr uint32_t MAX_LAYERS{ 4 };
+
+	// Erosion properties of the material of a stratum
+	struct material_t {
+		// Dissolving is slower by this factor
+		float hardness{1.0f};
+		// Factor to the sediment capacity constant KC
+		float sedimentCapacityConstant{1.0f};
+	};
+
+	struct settings_t {
+		// Size of the grid in cells, used by setup()
+		uint32_t width{4096};
+		uint32_t height{4096};
+		float gravity{9.81f};
+		// @todo: amount of water per cell per second. This must be variable, e.g. from a texture
+		float aDropOfRain{0.1f};
+		float rainMultiplier{1.0f};
+		// Distance between grid points, length of the pipes
+		float cellsize{1.0f};
+		float pipeCrossSection{1.0f};
+		float sedimentCapacityConstant_KC{0.1f};
+		// To avoid transport capacity going to 0 in flat terrain
+		float minFlowAngle{0.001f};
+		float dissolvingConstant_KS{0.5f};
+		float depositionConstant_KD{0.5f};
+		float evaporationConstant_KE{1.0f};
+		// Strata from the top, their thickness is in the LAYER state fields. 0 for uniform terrain.
+		uint32_t numberOfLayers{0};
+		// Materials of the strata, and at numberOfLayers of the bedrock below. Sediment is deposited on the top layer.
+		std::array<material_t, MAX_LAYERS + 1> materials;
+		// Thermal weathering: material slides off slopes steeper than the talus slope, tan of the talus angle
+		float talusSlope{1.0f};
+		// Part of the height above the talus slope that slides per second, 0 to disable
+		float thermalErosionConstant_KT{0.0f};
+		// Water height kept on the top and left boundary, like a lake. Negative to disable.
+		float boundaryWaterLevel{-1.0f};
+		// Simulated time per render()
+		float timeStep{1.0f / 60.0f};
+		// Take steps as long as stable instead of one step of timeStep per render()
+		bool adaptiveTimeStep{true};
+		// Part of a cell the fastest signal may travel per step
+		float courantNumber{0.5f};
+		// Blocks where all water heights are below this are dry and skipped, their sediment settles
+		float activeThreshold{1e-4f};
+		// Only cells with more water count for the time step
+		float wetWaterHeight{1e-2f};
+		float minTimeStep{1e-4f};
+		float maxTimeStep{0.1f};
+		// 0 for one per hardware thread
+		unsigned int numberOfThreads{0};
+		// Use simd kernels if the cpu supports them
+		bool useSimd{true};
+	};
+
+	// Fields that make up the state of the simulation, the others are derived during a step
+	typedef enum {
+		TERRAIN = 0, WATER, SEDIMENT, FLUX_LEFT, FLUX_RIGHT, FLUX_TOP, FLUX_BOTTOM,
+		// Thickness of the strata from the top, the first numberOfLayers of them are used
+		LAYER_0, LAYER_1, LAYER_2, LAYER_3,
+		NUMBER_OF_STATE_FIELDS
+	} stateField_t;
 
 	HydroErosionMDH07();
 
+	HydroErosionMDH07( const settings_t &settings );
+
 	virtual ~HydroErosionMDH07();
 
+	// Allocates the fields and creates a default terrain
 	virtual void setup() override final;
 
+	// Simulate the configured time step
 	virtual void render() override final;
 
 	virtual void cleanup() override final;
 
+	// One iteration of all passes
+	void step( const float deltatime );
+
+	// Advance by duration with the fewest stable steps, returns the number of steps
+	uint32_t simulate( const float duration );
+
+	// Longest time step for the next iteration by the CFL condition, within the configured limits
+	float getStableTimeStep() const;
+
+	// Replace the terrain, heights row major with the size of the grid
+	void setTerrain( const float *heights );
+
+	// Reallocate for a new grid size after setup(), all fields 0
+	void resize( const uint32_t width, const uint32_t height );
+
+	// For loading and saving the state from outside, call stateChanged() after changing it
+	ErosionField &getStateField( const stateField_t field );
+
+	const ErosionField &getStateField( const stateField_t field ) const;
+
+	// State fields in use, the strata are the last ones
+	uint32_t getNumberOfStateFields() const;
+
+	// Update ghost cells and second buffers and activate all blocks after the state fields have been changed
+	void stateChanged();
+
+	// Parameters can be changed between iterations, the size only by setup() or resize()
+	settings_t &getSettings();
+
+	const ErosionField &getTerrain() const;
+
+	const ErosionField &getWater() const;
+
+	const ErosionField &getSediment() const;
+
+	const ErosionField &getVelocityX() const;
+
+	const ErosionField &getVelocityY() const;
+
+	uint64_t getIteration() const;
+
+	double getSimulatedTime() const;
+
+	float getLastTimeStep() const;
+
+	// Continue a simulation, e.g. from a checkpoint, the next time step follows from the last one
+	void setProgress( const uint64_t iteration, const double simulatedTime, const float lastTimeStep,
+			const float maxSpeed );
+
+	// Fastest signal speed of the last iteration, see ErosionKernels.h
+	float getMaxSpeed() const;
+
+	uint32_t getNumberOfActiveBlocks() const;
+
+	uint32_t getNumberOfBlocks() const;
+
+	size_t getSizeInMemory() const;
+
+	// Reset watertable on boundaries to "global level"
 	void resetWaterTable( const float globalLevel );
 
 	// Increase due to rain or river flow
@@ -34,70 +180,110 @@ public:
 
 	void updateWaterheight( const float deltatime );
 
+	// Needs the water heights before and after updateWaterheight(), makes the new one current
 	void calculateVelocityField( const float deltatime );
 
-	void calculateErosionDeposition();
+	// Dissolving and deposition rates are per second, so results don't depend on the time step
+	void calculateErosionDeposition( const float deltatime );
 
-	// Transport sediment with velocity field
+	// Same with the material of the topmost stratum in each cell
+	void calculateLayeredErosionDeposition( const float deltatime );
+
+	// Transport sediment with velocity field. Plain semi-Lagrangian advection is not conservative, bilinear
+	// sampling gains or loses sediment where the flow converges or diverges. Each cell's outflow is limited
+	// to its sediment and what isn't sampled stays, so transport only moves sediment to nearby cells.
 	void transportSediment( const float deltatime );
 
 	void evaporateWater( const float deltatime );
 
+	// Move material from cells to their 8 neighbours that are lower than the talus slope allows
+	void weatherTerrain( const float deltatime );
+
+	// Edge length of the blocks for active cell tracking, also rows per band of work for the thread pool
+	static constexpr uint32_t BLOCK_SIZE{ 32 };
+
 private:
+	settings_t m_settings;
 
-	struct {
-		const uint16_t dimension{8};
-		const float gravity{9.81f};
-		// @todo: amount of water per cell per turn. This must be variable, e.g. from a texture
-		const float aDropOfRain{0.1f};
-		const float rainMultiplier{1.0f};
-		// length as well for now
-		const float cellsize{1.0f};
-		const float pipeCrossSection{1.0f};
-		const float pipeLength{cellsize};
-		// distances between grid points
-		const float distanceX_LX{cellsize};
-		const float distanceY_LY{cellsize};
-		const float sedimentCapacityConstant_KC{1.0f};
-		// To avoid transport capacity going to 0 in flat terrain
-		const float minFlowAngle{0.001f};
-		const float dissolvingConstant_KS{1.0f};
-		const float depositionConstant_KD{1.0f};
-		const float evaporationConstant_KE{1.0f};
-	} SETTINGS;
-
-	typedef enum { left=0, right, top, bottom } direction_t;
-
-	typedef struct cell_t {
-		float terrainHeight_b{0.0f};
-		float waterHeight_d2{0.0f};
-		float tempWaterHeight_d1{0.0f};
-		float tempSuspendedSediment_st{0.0f};
-		float suspendedSedimentThisTurn_s1{0.0f};
-		float sudpendedSediment_s{0.0f};
-		float sedimentTransportCapacity_C{0.0f};
-		// outflow in direction 0..3
-		float flux_f[4]{0.0f,0.0f,0.0f,0.0f};
-		omath::vec2 velocity_v{0.0f};
-		float getTerrainHeightDiff( const cell_t &other ) const {
-			return terrainHeight_b - other.terrainHeight_b;
-		}
-		float getTotalHeightDiff( const cell_t &other ) const {
-			return terrainHeight_b + tempWaterHeight_d1 -
-				   other.terrainHeight_b - other.tempWaterHeight_d1;
-		}
-	} cell_t;
-
-	cell_t **grid{nullptr};
-
-	// @todo velocity field as own grid ?
-
-	void outputHeight();
-
-	void outputTempWater();
-
-	void outputFlux();
-
-	void outputVelocity();
+	std::unique_ptr<orf_n::thread_pool> m_pool;
+
+	const erosion_kernels::kernels_t *m_kernels{ nullptr };
+
+	// Terrain height b, double buffered for erosion/deposition
+	ErosionField m_terrain;
+	ErosionField m_terrainNext;
+
+	// Water height d. Rain turns d into d1 in place, the flow gives d2 in m_waterNext.
+	ErosionField m_water;
+	ErosionField m_waterNext;
+
+	// Suspended sediment s, and s1 after erosion/deposition
+	ErosionField m_sediment;
+	ErosionField m_sedimentNext;
+
+	// Weight of each cell in the advection's samples, 0 outside of transportSediment()
+	ErosionField m_sedimentWeight;
+
+	// Outflow flux to the neighbours
+	ErosionField m_fluxLeft;
+	ErosionField m_fluxRight;
+	ErosionField m_fluxTop;
+	ErosionField m_fluxBottom;
+
+	// Velocity in x and y
+	ErosionField m_velocityX;
+	ErosionField m_velocityY;
+
+	// Thickness of the strata from the top, changed in place
+	ErosionField m_layers[MAX_LAYERS];
+
+	uint64_t m_iteration{0};
+
+	double m_simulatedTime{0.0};
+
+	float m_lastTimeStep{0.0f};
+
+	// Max-reduction of the signal speed, one slot per block row
+	std::vector<float> m_bandMaxSpeed;
+
+	uint32_t m_blocksX{0};
+	uint32_t m_blocksY{0};
+
+	// Row major, 1 for blocks the passes run over
+	std::vector<uint8_t> m_activeBlocks;
+
+	// Set during the flux pass for blocks that get flux, merged into the active blocks afterwards
+	std::unique_ptr<std::atomic<uint8_t>[]> m_wakeBlocks;
+
+	float m_maxSpeed{0.0f};
+
+	bool m_reportedUnstable{false};
+
+	// Run kernel( firstRow, lastRow ) over all rows in bands. Rows are signed for the stencils.
+	template<typename K>
+	void forEachBand( const K &kernel );
+
+	// Run kernel( blockRow, firstRow, lastRow, firstColumn, lastColumn ) over runs of active blocks
+	template<typename K>
+	void forEachActiveSpan( const K &kernel );
+
+	// Same, even block rows before odd ones, for kernels that also write the rows next to their own
+	template<typename K>
+	void forEachActiveSpanAlternating( const K &kernel );
+
+	template<typename K>
+	void activeSpansOfBlockRow( const uint32_t blockRow, const K &kernel );
+
+	// Activate the blocks woken during the flux pass
+	void wakeBlocks();
+
+	// Deposit the sediment of dry blocks and stop simulating them
+	void deactivateDryBlocks();
+
+	// Same terrain in both buffers
+	void copyTerrain();
+
+	// Take height from the strata of a cell from the top, the bedrock takes the rest
+	void removeFromLayers( const int32_t x, const int32_t y, float height );
 
 };
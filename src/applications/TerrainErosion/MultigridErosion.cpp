@@ -0,0 +1,157 @@
+
+#include "MultigridErosion.h"
+#include "base/logbook.h"
+#include <algorithm>
+#include <string>
+
+using namespace orf_n;
+
+MultigridErosion::MultigridErosion( const settings_t &settings ) :
+		m_settings{ settings } {}
+
+MultigridErosion::~MultigridErosion() {}
+
+void MultigridErosion::save( const ErosionField &field, grid_t &grid ) {
+	grid.width = field.getWidth();
+	grid.height = field.getHeight();
+	grid.cells.resize( static_cast<size_t>( grid.width ) * grid.height );
+	for( uint32_t y{0}; y < grid.height; ++y )
+		std::copy_n( field.row( y ), grid.width, &grid.cells[static_cast<size_t>( y ) * grid.width] );
+}
+
+void MultigridErosion::load( const grid_t &grid, ErosionField &field ) {
+	for( uint32_t y{0}; y < grid.height; ++y )
+		std::copy_n( &grid.cells[static_cast<size_t>( y ) * grid.width], grid.width, field.row( y ) );
+}
+
+void MultigridErosion::restrict( const grid_t &fine, grid_t &coarse ) {
+	coarse.width = ( fine.width + 1 ) / 2;
+	coarse.height = ( fine.height + 1 ) / 2;
+	coarse.cells.assign( static_cast<size_t>( coarse.width ) * coarse.height, 0.0f );
+	for( uint32_t y{0}; y < coarse.height; ++y )
+		for( uint32_t x{0}; x < coarse.width; ++x ) {
+			const uint32_t x1{ std::min( 2 * x + 1, fine.width - 1 ) };
+			const uint32_t y1{ std::min( 2 * y + 1, fine.height - 1 ) };
+			float sum{ 0.0f };
+			uint32_t n{0};
+			for( uint32_t fy{ 2 * y }; fy <= y1; ++fy )
+				for( uint32_t fx{ 2 * x }; fx <= x1; ++fx ) {
+					sum += fine.cells[static_cast<size_t>( fy ) * fine.width + fx];
+					++n;
+				}
+			coarse.cells[static_cast<size_t>( y ) * coarse.width + x] = sum / n;
+		}
+}
+
+void MultigridErosion::prolong( const grid_t &coarse, ErosionField &fine, const float scale ) {
+	const uint32_t width{ fine.getWidth() };
+	const uint32_t height{ fine.getHeight() };
+	const float scaleX{ static_cast<float>( coarse.width ) / width };
+	const float scaleY{ static_cast<float>( coarse.height ) / height };
+	const float maxX{ static_cast<float>( coarse.width - 1 ) };
+	const float maxY{ static_cast<float>( coarse.height - 1 ) };
+	for( uint32_t y{0}; y < height; ++y ) {
+		// Position of the cell centre in the coarse grid
+		const float cy{ std::clamp( ( y + 0.5f ) * scaleY - 0.5f, 0.0f, maxY ) };
+		const uint32_t y0{ static_cast<uint32_t>( cy ) };
+		const uint32_t y1{ std::min( y0 + 1, coarse.height - 1 ) };
+		const float fy{ cy - y0 };
+		const float *const row0{ &coarse.cells[static_cast<size_t>( y0 ) * coarse.width] };
+		const float *const row1{ &coarse.cells[static_cast<size_t>( y1 ) * coarse.width] };
+		float *const f{ fine.row( y ) };
+		for( uint32_t x{0}; x < width; ++x ) {
+			const float cx{ std::clamp( ( x + 0.5f ) * scaleX - 0.5f, 0.0f, maxX ) };
+			const uint32_t x0{ static_cast<uint32_t>( cx ) };
+			const uint32_t x1{ std::min( x0 + 1, coarse.width - 1 ) };
+			const float fx{ cx - x0 };
+			const float top{ row0[x0] + ( row0[x1] - row0[x0] ) * fx };
+			const float bottom{ row1[x0] + ( row1[x1] - row1[x0] ) * fx };
+			f[x] += ( top + ( bottom - top ) * fy ) * scale;
+		}
+	}
+}
+
+uint64_t MultigridErosion::run( HydroErosionMDH07 &fine ) {
+	typedef HydroErosionMDH07::stateField_t field_t;
+	const HydroErosionMDH07::settings_t fineSettings{ fine.getSettings() };
+	const uint32_t numberOfFields{ fine.getNumberOfStateFields() };
+	// A coarse pipe carries the flux of two fine ones, flux starts at 0 on the coarsest grid
+	const auto isFlux{ []( const uint32_t field ) {
+		return field >= HydroErosionMDH07::FLUX_LEFT && field <= HydroErosionMDH07::FLUX_BOTTOM;
+	} };
+	// Terrain and strata keep the detail of the finer grid, only their change is handed on
+	const auto isTerrain{ []( const uint32_t field ) {
+		return HydroErosionMDH07::TERRAIN == field || field >= HydroErosionMDH07::LAYER_0;
+	} };
+	// State fields of all grids, 0 is the fine grid
+	std::vector<std::vector<grid_t>> grids( 1, std::vector<grid_t>( numberOfFields ) );
+	for( uint32_t field{0}; field < numberOfFields; ++field )
+		if( !isFlux( field ) )
+			save( fine.getStateField( static_cast<field_t>( field ) ), grids[0][field] );
+	while( grids.size() <= m_settings.levels && ( grids.back()[0].width + 1 ) / 2 >= m_settings.minSize &&
+			( grids.back()[0].height + 1 ) / 2 >= m_settings.minSize ) {
+		grids.emplace_back( numberOfFields );
+		for( uint32_t field{0}; field < numberOfFields; ++field )
+			if( !isFlux( field ) )
+				restrict( grids[grids.size() - 2][field], grids.back()[field] );
+	}
+	m_numberOfLevels = static_cast<uint32_t>( grids.size() - 1 );
+	if( 0 == m_numberOfLevels ) {
+		logbook::log_msg( logbook::TERRAIN, logbook::WARNING, "Multigrid erosion: grid too small for coarse levels" );
+		return 0;
+	}
+
+	HydroErosionMDH07::settings_t coarseSettings{ fineSettings };
+	coarseSettings.width = grids.back()[0].width;
+	coarseSettings.height = grids.back()[0].height;
+	HydroErosionMDH07 coarse{ coarseSettings };
+	coarse.setup();
+	for( uint32_t field{0}; field < numberOfFields; ++field )
+		if( !isFlux( field ) )
+			load( grids.back()[field], coarse.getStateField( static_cast<field_t>( field ) ) );
+	coarse.stateChanged();
+	grid_t state[HydroErosionMDH07::NUMBER_OF_STATE_FIELDS];
+	for( uint32_t level{ m_numberOfLevels }; level > 0; --level ) {
+		// Cells and pipes 2^level times as wide, speeds and heights stay the same
+		const float factor{ static_cast<float>( 1u << level ) };
+		coarse.getSettings().cellsize = fineSettings.cellsize * factor;
+		coarse.getSettings().pipeCrossSection = fineSettings.pipeCrossSection * factor;
+		if( fineSettings.adaptiveTimeStep )
+			coarse.simulate( m_settings.timePerLevel );
+		else
+			for( float t{0.0f}; t < m_settings.timePerLevel; t += fineSettings.timeStep )
+				coarse.step( fineSettings.timeStep );
+		for( uint32_t field{0}; field < numberOfFields; ++field ) {
+			save( coarse.getStateField( static_cast<field_t>( field ) ), state[field] );
+			if( isTerrain( field ) )
+				for( size_t i{0}; i < state[field].cells.size(); ++i )
+					state[field].cells[i] -= grids[level][field].cells[i];
+		}
+		// Next finer grid, the fine solver at last
+		HydroErosionMDH07 &target{ level > 1 ? coarse : fine };
+		if( level > 1 )
+			coarse.resize( grids[level - 1][0].width, grids[level - 1][0].height );
+		for( uint32_t field{0}; field < numberOfFields; ++field ) {
+			ErosionField &f{ target.getStateField( static_cast<field_t>( field ) ) };
+			f.fill( 0.0f );
+			if( isTerrain( field ) )
+				load( grids[level - 1][field], f );
+			prolong( state[field], f, isFlux( field ) ? 0.5f : 1.0f );
+			// Strata can't be eroded below nothing
+			if( field >= HydroErosionMDH07::LAYER_0 )
+				for( uint32_t y{0}; y < f.getHeight(); ++y )
+					for( uint32_t x{0}; x < f.getWidth(); ++x )
+						f.at( x, y ) = std::max( 0.0f, f.at( x, y ) );
+		}
+		target.stateChanged();
+	}
+	logbook::log_msg( logbook::TERRAIN, logbook::INFO, "Multigrid erosion: " + std::to_string( m_numberOfLevels ) +
+			" coarse levels, " + std::to_string( coarse.getIteration() ) + " iterations" );
+	const uint64_t iterations{ coarse.getIteration() };
+	coarse.cleanup();
+	return iterations;
+}
+
+uint32_t MultigridErosion::getNumberOfLevels() const {
+	return m_numberOfLevels;
+}
@@ -0,0 +1,62 @@
+#pragma once
+
+#include "HydroErosionMDH07.h"
+#include <vector>
+
+/**
+ * Coarse to fine start for hydraulic erosion.
+ * Water moves about a cell per iteration, so it takes thousands of iterations to cross a large grid. Here the
+ * state of the fine grid is averaged down to grids of half the size, with twice the cell size. The coarsest
+ * grid is simulated first, its water, sediment, flux and change of terrain and strata are interpolated to the
+ * next finer grid as its initial state, and so on up to the fine grid. On a coarse grid water crosses the distance in a
+ * fraction of the iterations, so drainage patterns have formed when the fine simulation starts.
+ */
+class MultigridErosion {
+public:
+
+	struct settings_t {
+		// Coarse grids below the fine one, fewer if they would get smaller than minSize
+		uint32_t levels{3};
+		// Smallest edge length of the coarsest grid in cells
+		uint32_t minSize{ HydroErosionMDH07::BLOCK_SIZE };
+		// Simulated time in seconds on each coarse grid
+		float timePerLevel{5.0f};
+	};
+
+	MultigridErosion( const settings_t &settings );
+
+	virtual ~MultigridErosion();
+
+	/**
+	 * Simulate the coarse grids and replace the state of the fine solver with the result.
+	 * The fine solver's settings apply, scaled to the cell size of each grid.
+	 * Returns the number of iterations on the coarse grids.
+	 */
+	uint64_t run( HydroErosionMDH07 &fine );
+
+	// Coarse grids of the last run
+	uint32_t getNumberOfLevels() const;
+
+private:
+	// One grid of cells row major
+	struct grid_t {
+		uint32_t width{0};
+		uint32_t height{0};
+		std::vector<float> cells;
+	};
+
+	settings_t m_settings;
+
+	uint32_t m_numberOfLevels{0};
+
+	// Average 2x2 cells into one, odd edges average the cells there are
+	static void restrict( const grid_t &fine, grid_t &coarse );
+
+	// Bilinear interpolation of the cell centres times scale, added to fine
+	static void prolong( const grid_t &coarse, ErosionField &fine, const float scale );
+
+	static void save( const ErosionField &field, grid_t &grid );
+
+	static void load( const grid_t &grid, ErosionField &field );
+
+};
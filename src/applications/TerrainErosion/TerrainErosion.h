@@ -106,7 +106,7 @@ static float updateWaterheight( omath::uvec2 &position, const float deltatime )
 // Updates the amount of water leaving column
 static float updateOutflow( omath::uvec2 &position, const float deltatime ) {
 	float flow{0.0f};
-	for( size_t i{0}; i < 3; ++i )
+	for( size_t i{left}; i <= bottom; ++i )
 		flow += updateFlowInPipe( position, static_cast<positionDelta>(i), deltatime );
 	// Flow can't be greater than height of watercolumn * cross section (here: distance*distance)
 	if( flow > heightField[position.x][position.y].waterHeight * crossSectionOfFlow )
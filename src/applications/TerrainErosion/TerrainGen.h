@@ -2,6 +2,13 @@
 #pragma once
 
 #include "omath/vec3.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <iterator>
+#include <limits>
+#include <queue>
+#include <random>
 #include <vector>
 
 // I. river graph, flow data and node types
@@ -15,6 +22,11 @@ struct riverEdge_t {
 
 };
 
+// Index of a node in the network, stays valid while the network grows
+typedef uint32_t nodeHandle_t;
+
+constexpr nodeHandle_t NO_NODE{ UINT32_MAX };
+
 struct riverNode_t {
 	// y is elevation
 	omath::vec3 position;
@@ -22,48 +34,143 @@ struct riverNode_t {
 	riverTrajectory_t riverType;
 	float flow;
 	uint32_t hortonStrahler;
+	// Downstream node, NO_NODE for river mouths
+	nodeHandle_t parent{ NO_NODE };
 	std::vector<riverEdge_t> edges;
 };
 
 struct junction_t {
 	float connectionAngle;
-	riverNode_t inflow1;
-	riverNode_t inflow2;
-	riverNode_t outflow;
+	nodeHandle_t inflow1;
+	nodeHandle_t inflow2;
+	nodeHandle_t outflow;
 };
 
 typedef std::vector<riverNode_t> drainageNetwork_t;
 
+struct networkSettings_t {
+	// Distance from a node to the nodes it is expanded to
+	float nodeDistance{ 1.0f };
+	// Elevation gained per distance upstream, the slope magnitude
+	float slopeMagnitude{ 0.05f };
+	// Slopes of the reaches spread log-normally around the slope magnitude, with this standard deviation
+	// of their logarithm. 0 gives every reach the same slope, and the same stream type.
+	float slopeVariation{ 0.75f };
+	// Candidates up to this much above the lowest one compete by priority
+	float deltaElevation{ 0.5f };
+	// Chance that a node branches instead of continuing
+	float branchProbability{ 0.3f };
+	uint32_t seed{ 1 };
+	// Crest height gained per distance from the river nodes, l in [0..0.25]
+	float ridgeSlope{ 0.2f };
+	// Flat rivers closer to the coast than this, along their course, are braided or deltas
+	float coastDistance{ 20.0f };
+	// Mouths with more flow become deltas
+	float deltaFlow{ 200.0f };
+};
+
+/**
+ * Uniform grid over x and z of the input domain with cells of the node distance, so the nodes near a
+ * position are found in the surrounding 3x3 cells instead of searching the whole network.
+ */
+struct nodeGrid_t {
+	float minX{ 0.0f };
+	float minZ{ 0.0f };
+	float cellsize{ 1.0f };
+	uint32_t width{ 0 };
+	uint32_t height{ 0 };
+	std::vector<std::vector<nodeHandle_t>> cells;
+
+	void setup( const float x0, const float z0, const float x1, const float z1, const float size ) {
+		minX = x0;
+		minZ = z0;
+		cellsize = size;
+		width = static_cast<uint32_t>( ( x1 - x0 ) / size ) + 1;
+		height = static_cast<uint32_t>( ( z1 - z0 ) / size ) + 1;
+		cells.assign( static_cast<size_t>( width ) * height, {} );
+	}
+
+	bool contains( const omath::vec3 &p ) const {
+		return p.x >= minX && p.z >= minZ && p.x < minX + width * cellsize && p.z < minZ + height * cellsize;
+	}
+
+	void insert( const nodeHandle_t node, const omath::vec3 &p ) {
+		cells[cellIndex( p )].push_back( node );
+	}
+
+	// True if no node of the network is closer to p than radius, which must not exceed the cell size
+	bool isFree( const omath::vec3 &p, const float radius, const drainageNetwork_t &nodes ) const {
+		const int cx{ static_cast<int>( ( p.x - minX ) / cellsize ) };
+		const int cz{ static_cast<int>( ( p.z - minZ ) / cellsize ) };
+		for( int z{ std::max( cz - 1, 0 ) }; z <= std::min( cz + 1, static_cast<int>( height ) - 1 ); ++z )
+			for( int x{ std::max( cx - 1, 0 ) }; x <= std::min( cx + 1, static_cast<int>( width ) - 1 ); ++x )
+				for( const nodeHandle_t n : cells[static_cast<size_t>( z ) * width + x] ) {
+					const float dx{ nodes[n].position.x - p.x };
+					const float dz{ nodes[n].position.z - p.z };
+					if( dx * dx + dz * dz < radius * radius )
+						return false;
+				}
+		return true;
+	}
+
+	size_t cellIndex( const omath::vec3 &p ) const {
+		const uint32_t x{ std::min( static_cast<uint32_t>( ( p.x - minX ) / cellsize ), width - 1 ) };
+		const uint32_t z{ std::min( static_cast<uint32_t>( ( p.z - minZ ) / cellsize ), height - 1 ) };
+		return static_cast<size_t>( z ) * width + x;
+	}
+};
+
+// Node waiting to be expanded, with its elevation so the heaps don't look into the network
+struct candidate_t {
+	float elevation;
+	nodeHandle_t node;
+
+	// Lowest elevation on top of a std::priority_queue
+	bool operator<( const candidate_t &other ) const {
+		return elevation > other.elevation;
+	}
+};
+
 static drainageNetwork_t network;
 // initial candidate nodes are river mouths along the contour of the input domain
-static drainageNetwork_t candidates;
+// One heap per priority, ordered by elevation
+static std::priority_queue<candidate_t> candidates[high + 1];
+static nodeGrid_t nodeGrid;
+static networkSettings_t networkSettings;
+static std::mt19937 networkRandom;
 
 static std::vector<omath::vec3> slope;
 static std::vector<omath::vec3> contour;
 static std::vector<omath::vec3> inputDomain;
 
-// Returns node with highest priority (and lowest elevation if multiple nodes)
-static riverNode_t &getHighestPriority( drainageNetwork_t &nodes ) {
-	return nodes[0];
+static nodeHandle_t addNode( const riverNode_t &node ) {
+	const nodeHandle_t handle{ static_cast<nodeHandle_t>( network.size() ) };
+	network.push_back( node );
+	nodeGrid.insert( handle, node.position );
+	candidates[node.priority].push( candidate_t{ node.position.y, handle } );
+	return handle;
 }
 
-// delta controls length of network by limiting elevation differences
-static riverNode_t &selectNodes( const float lowestElevation, const float deltaElevation ) {
-	size_t size{ network.size() };
-	candidates.clear();
-	// create list of condidates within elevation range
-	float lowest{ network[0].position.y };
-	for( size_t i{1}; i < size; ++i ) {
-		if( network[i].position.y >= lowestElevation && network[i].position.y <= lowestElevation + deltaElevation ) {
-			candidates.push_back( network[i] );
-			lowest = network[i].position.y < lowest ? network[i].position.y : lowest;
+/**
+ * Take the next node to expand: of the candidates at most deltaElevation above the lowest one, the one with
+ * highest priority, and lowest elevation if multiple nodes. The lowest node of each priority is on top of
+ * its heap, so this is O(log n). Returns NO_NODE if there are no candidates left.
+ */
+static nodeHandle_t selectNodes( const float deltaElevation ) {
+	float lowest{ std::numeric_limits<float>::max() };
+	for( const std::priority_queue<candidate_t> &c : candidates )
+		if( !c.empty() )
+			lowest = std::min( lowest, c.top().elevation );
+	for( int p{ high }; p >= low; --p )
+		if( !candidates[p].empty() && candidates[p].top().elevation <= lowest + deltaElevation ) {
+			const nodeHandle_t node{ candidates[p].top().node };
+			candidates[p].pop();
+			return node;
 		}
-	}
-	// choose highest priority node
-	return getHighestPriority( candidates );
+	return NO_NODE;
 }
 
-static bool expandNode( const riverNode_t &nodeToExpand, const float slopeMagnitude ) {
+static bool expandNode( const nodeHandle_t nodeToExpand, const float slopeMagnitude ) {
 	// ensure gradual elevation, each new node must be higher than its ancestor
 	// create river slope map with the slope magnitude value (height variation), a local
 	// parameter given by user or calculated procedurally
@@ -71,19 +178,513 @@ static bool expandNode( const riverNode_t &nodeToExpand, const float slopeMagnit
 	// else s = numChildren k, ecept when >=2 children are k, the s = k + 1
 	// symmetric and asymmetric rule, probabilities for branching control length and branching of streams
 	// cliff preventing condition: slope threshold k * distance(new node-node) > height difference between two nodes
-	return true;
+	const riverNode_t node{ network[nodeToExpand] };
+	const float distance{ networkSettings.nodeDistance };
+	// Upstream direction in x and z, mouths flow in from the centre of the domain
+	float dx, dz;
+	if( NO_NODE != node.parent ) {
+		dx = node.position.x - network[node.parent].position.x;
+		dz = node.position.z - network[node.parent].position.z;
+	} else {
+		dx = nodeGrid.minX + nodeGrid.width * nodeGrid.cellsize * 0.5f - node.position.x;
+		dz = nodeGrid.minZ + nodeGrid.height * nodeGrid.cellsize * 0.5f - node.position.z;
+	}
+	const float length{ std::sqrt( dx * dx + dz * dz ) };
+	if( length <= 0.0f )
+		return false;
+	dx /= length;
+	dz /= length;
+	// Straight on first, then to the sides. Branches leave at 45 degrees to either side
+	const bool branch{ std::uniform_real_distribution<float>{}( networkRandom ) < networkSettings.branchProbability };
+	static const float straight[]{ 0.0f, 0.4f, -0.4f, 0.8f, -0.8f };
+	static const float branches[]{ 0.8f, -0.8f };
+	const float *const angles{ branch ? branches : straight };
+	const size_t numberOfAngles{ branch ? std::size( branches ) : std::size( straight ) };
+	uint32_t children{0};
+	const float sigma{ networkSettings.slopeVariation };
+	std::normal_distribution<float> variation{ 0.0f, sigma > 0.0f ? sigma : 1.0f };
+	for( size_t i{0}; i < numberOfAngles && ( branch || 0 == children ); ++i ) {
+		const float c{ std::cos( angles[i] ) };
+		const float s{ std::sin( angles[i] ) };
+		const float reachSlope{ sigma > 0.0f ? slopeMagnitude * std::exp( variation( networkRandom ) ) : slopeMagnitude };
+		riverNode_t child{ node };
+		child.position = omath::vec3{ node.position.x + ( dx * c - dz * s ) * distance,
+				node.position.y + reachSlope * distance, node.position.z + ( dx * s + dz * c ) * distance };
+		// Keep a distance to all other nodes, which also keeps streams from crossing
+		if( !nodeGrid.contains( child.position ) ||
+				!nodeGrid.isFree( child.position, 0.75f * distance, network ) )
+			continue;
+		child.parent = nodeToExpand;
+		// An asymmetric branch is a tributary of lower priority
+		if( branch && children > 0 && low != node.priority )
+			child.priority = static_cast<priorityIndex_t>( node.priority - 1 );
+		child.flow = 0.0f;
+		child.hortonStrahler = 0;
+		child.edges.clear();
+		addNode( child );
+		++children;
+	}
+	return children > 0;
 }
 
 static bool updateNode() {
 	return true;
 }
 
+/**
+ * Grow the network upstream from the river mouths until no node can be expanded. The input domain's bounding
+ * box in x and z limits the network.
+ */
+static void growNetwork( const std::vector<riverNode_t> &mouths, const networkSettings_t &settings ) {
+	networkSettings = settings;
+	networkRandom.seed( settings.seed );
+	network.clear();
+	for( std::priority_queue<candidate_t> &c : candidates )
+		c = std::priority_queue<candidate_t>{};
+	const std::vector<omath::vec3> &bounds{ inputDomain.empty() ? contour : inputDomain };
+	float x0{ std::numeric_limits<float>::max() }, z0{ x0 }, x1{ -x0 }, z1{ -x0 };
+	for( const omath::vec3 &p : bounds ) {
+		x0 = std::min( x0, p.x );
+		z0 = std::min( z0, p.z );
+		x1 = std::max( x1, p.x );
+		z1 = std::max( z1, p.z );
+	}
+	for( const riverNode_t &m : mouths ) {
+		x0 = std::min( x0, m.position.x );
+		z0 = std::min( z0, m.position.z );
+		x1 = std::max( x1, m.position.x );
+		z1 = std::max( z1, m.position.z );
+	}
+	if( x0 > x1 )
+		return;
+	nodeGrid.setup( x0, z0, x1, z1, settings.nodeDistance );
+	for( riverNode_t m : mouths ) {
+		m.parent = NO_NODE;
+		addNode( m );
+	}
+	// A node that can't be expanded drops out
+	for( nodeHandle_t n{ selectNodes( settings.deltaElevation ) }; NO_NODE != n; n = selectNodes( settings.deltaElevation ) )
+		expandNode( n, settings.slopeMagnitude );
+}
+
+constexpr uint32_t NO_EDGE{ UINT32_MAX };
+
+/**
+ * Delaunay triangulation of the river nodes in x and z and its dual, the Voronoi diagram.
+ * Half edge e of triangle e / 3 runs from triangles[e] to triangles[nextHalfedge( e )], halfedges[e] is the
+ * same edge in the neighbouring triangle, or NO_EDGE on the hull. The Voronoi vertex of a triangle is its
+ * circumcentre, the Voronoi cell of a node is made of the vertices of the triangles around it.
+ */
+struct voronoiDiagram_t {
+	std::vector<nodeHandle_t> triangles;
+	std::vector<uint32_t> halfedges;
+	// Circumcentres, clamped to the domain, y is the crest height
+	std::vector<omath::vec3> vertices;
+	// A half edge ending at each node, the one on the hull for nodes on the hull, NO_EDGE for duplicates
+	std::vector<uint32_t> nodeEdges;
+	std::vector<float> cellAreas;
+};
+
+// Voronoi edge between two cells without a river between them, as the triangles of its vertices
+struct ridge_t {
+	uint32_t vertex0;
+	uint32_t vertex1;
+};
+
+static voronoiDiagram_t voronoi;
+static std::vector<ridge_t> ridges;
+
+static uint32_t nextHalfedge( const uint32_t e ) {
+	return e % 3 == 2 ? e - 2 : e + 1;
+}
+
+/**
+ * Sweep hull Delaunay triangulation in O(n log n): points are added in order of distance from the first
+ * triangle, each one connects to the hull edges visible from it, and edges are flipped until all
+ * triangles are Delaunay. A hash of the hull by angle around the centre finds the visible edges.
+ */
+struct delaunay_t {
+	// x and z of each point
+	const std::vector<double> &input;
+	// Points in the order they are added, so points close on the hull are close in memory
+	std::vector<double> coords;
+	std::vector<uint32_t> &triangles;
+	std::vector<uint32_t> &halfedges;
+	std::vector<uint32_t> hullPrev;
+	std::vector<uint32_t> hullNext;
+	std::vector<uint32_t> hullTri;
+	std::vector<uint32_t> hullHash;
+	std::vector<uint32_t> edgeStack;
+	uint32_t hullStart{ 0 };
+	double cx{ 0.0 };
+	double cz{ 0.0 };
+
+	delaunay_t( const std::vector<double> &points, std::vector<uint32_t> &t, std::vector<uint32_t> &h ) :
+			input{ points }, triangles{ t }, halfedges{ h } {}
+
+	// True if r is right of p->q
+	static bool orient( const double px, const double py, const double qx, const double qy, const double rx,
+			const double ry ) {
+		return ( qy - py ) * ( rx - qx ) - ( qx - px ) * ( ry - qy ) < 0.0;
+	}
+
+	// True if p is inside the circumcircle of a, b, c
+	static bool inCircle( const double ax, const double ay, const double bx, const double by, const double cx,
+			const double cy, const double px, const double py ) {
+		const double dx{ ax - px }, dy{ ay - py };
+		const double ex{ bx - px }, ey{ by - py };
+		const double fx{ cx - px }, fy{ cy - py };
+		const double ap{ dx * dx + dy * dy };
+		const double bp{ ex * ex + ey * ey };
+		const double cp{ fx * fx + fy * fy };
+		return dx * ( ey * cp - bp * fy ) - dy * ( ex * cp - bp * fx ) + ap * ( ex * fy - ey * fx ) < 0.0;
+	}
+
+	// Squared circumradius, infinite for collinear points
+	static double circumradius( const double ax, const double ay, const double bx, const double by,
+			const double cx, const double cy ) {
+		const double dx{ bx - ax }, dy{ by - ay };
+		const double ex{ cx - ax }, ey{ cy - ay };
+		const double bl{ dx * dx + dy * dy };
+		const double cl{ ex * ex + ey * ey };
+		const double det{ dx * ey - dy * ex };
+		if( 0.0 == det )
+			return std::numeric_limits<double>::infinity();
+		const double d{ 0.5 / det };
+		const double x{ ( ey * bl - dy * cl ) * d };
+		const double y{ ( dx * cl - ex * bl ) * d };
+		return x * x + y * y;
+	}
+
+	static void circumcenter( const double ax, const double ay, const double bx, const double by,
+			const double cx, const double cy, double &x, double &y ) {
+		const double dx{ bx - ax }, dy{ by - ay };
+		const double ex{ cx - ax }, ey{ cy - ay };
+		const double bl{ dx * dx + dy * dy };
+		const double cl{ ex * ex + ey * ey };
+		const double d{ 0.5 / ( dx * ey - dy * ex ) };
+		x = ax + ( ey * bl - dy * cl ) * d;
+		y = ay + ( dx * cl - ex * bl ) * d;
+	}
+
+	// Monotonic in the angle of dx, dy, in [0..1)
+	static double pseudoAngle( const double dx, const double dy ) {
+		const double p{ dx / ( std::abs( dx ) + std::abs( dy ) ) };
+		return ( dy > 0.0 ? 3.0 - p : 1.0 + p ) / 4.0;
+	}
+
+	uint32_t hashKey( const double x, const double y ) const {
+		const size_t size{ hullHash.size() };
+		return static_cast<uint32_t>( static_cast<size_t>( std::floor( pseudoAngle( x - cx, y - cz ) * size ) ) % size );
+	}
+
+	void link( const uint32_t a, const uint32_t b ) {
+		halfedges[a] = b;
+		if( NO_EDGE != b )
+			halfedges[b] = a;
+	}
+
+	uint32_t addTriangle( const uint32_t i0, const uint32_t i1, const uint32_t i2, const uint32_t a,
+			const uint32_t b, const uint32_t c ) {
+		const uint32_t t{ static_cast<uint32_t>( triangles.size() ) };
+		triangles.push_back( i0 );
+		triangles.push_back( i1 );
+		triangles.push_back( i2 );
+		halfedges.resize( t + 3 );
+		link( t, a );
+		link( t + 1, b );
+		link( t + 2, c );
+		return t;
+	}
+
+	// Flip edges until the triangles around a are Delaunay, returns the edge the new point ends up on
+	uint32_t legalize( uint32_t a ) {
+		uint32_t ar{ 0 };
+		edgeStack.clear();
+		while( true ) {
+			const uint32_t b{ halfedges[a] };
+			const uint32_t a0{ a - a % 3 };
+			ar = a0 + ( a + 2 ) % 3;
+			if( NO_EDGE == b ) {
+				if( edgeStack.empty() )
+					break;
+				a = edgeStack.back();
+				edgeStack.pop_back();
+				continue;
+			}
+			const uint32_t b0{ b - b % 3 };
+			const uint32_t al{ a0 + ( a + 1 ) % 3 };
+			const uint32_t bl{ b0 + ( b + 2 ) % 3 };
+			const uint32_t p0{ triangles[ar] };
+			const uint32_t pr{ triangles[a] };
+			const uint32_t pl{ triangles[al] };
+			const uint32_t p1{ triangles[bl] };
+			if( inCircle( coords[2 * p0], coords[2 * p0 + 1], coords[2 * pr], coords[2 * pr + 1], coords[2 * pl],
+					coords[2 * pl + 1], coords[2 * p1], coords[2 * p1 + 1] ) ) {
+				triangles[a] = p1;
+				triangles[b] = p0;
+				const uint32_t hbl{ halfedges[bl] };
+				// Flipped across the hull, fix the hull's reference to the triangle
+				if( NO_EDGE == hbl ) {
+					uint32_t e{ hullStart };
+					do {
+						if( hullTri[e] == bl ) {
+							hullTri[e] = a;
+							break;
+						}
+						e = hullPrev[e];
+					} while( e != hullStart );
+				}
+				link( a, hbl );
+				link( b, halfedges[ar] );
+				link( ar, bl );
+				edgeStack.push_back( b0 + ( b + 1 ) % 3 );
+			} else {
+				if( edgeStack.empty() )
+					break;
+				a = edgeStack.back();
+				edgeStack.pop_back();
+			}
+		}
+		return ar;
+	}
+
+	void triangulate() {
+		const uint32_t n{ static_cast<uint32_t>( input.size() / 2 ) };
+		triangles.clear();
+		halfedges.clear();
+		if( n < 3 )
+			return;
+		double minX{ std::numeric_limits<double>::max() }, minY{ minX }, maxX{ -minX }, maxY{ -minX };
+		for( uint32_t i{0}; i < n; ++i ) {
+			minX = std::min( minX, input[2 * i] );
+			minY = std::min( minY, input[2 * i + 1] );
+			maxX = std::max( maxX, input[2 * i] );
+			maxY = std::max( maxY, input[2 * i + 1] );
+		}
+		const double centreX{ ( minX + maxX ) / 2.0 };
+		const double centreY{ ( minY + maxY ) / 2.0 };
+		const auto distanceSq{ [this]( const uint32_t i, const double x, const double y ) {
+			const double dx{ input[2 * i] - x };
+			const double dy{ input[2 * i + 1] - y };
+			return dx * dx + dy * dy;
+		} };
+		// Seed triangle: point closest to the centre, its closest point and the smallest circumcircle
+		uint32_t i0{0}, i1{0}, i2{0};
+		uint32_t s0{0}, s1{0}, s2{0};
+		double minDistance{ std::numeric_limits<double>::max() };
+		for( uint32_t i{0}; i < n; ++i ) {
+			const double d{ distanceSq( i, centreX, centreY ) };
+			if( d < minDistance ) {
+				i0 = i;
+				minDistance = d;
+			}
+		}
+		const double i0x{ input[2 * i0] }, i0y{ input[2 * i0 + 1] };
+		minDistance = std::numeric_limits<double>::max();
+		for( uint32_t i{0}; i < n; ++i ) {
+			const double d{ distanceSq( i, i0x, i0y ) };
+			if( i != i0 && d < minDistance && d > 0.0 ) {
+				i1 = i;
+				minDistance = d;
+			}
+		}
+		double i1x{ input[2 * i1] }, i1y{ input[2 * i1 + 1] };
+		double minRadius{ std::numeric_limits<double>::infinity() };
+		for( uint32_t i{0}; i < n; ++i ) {
+			if( i == i0 || i == i1 )
+				continue;
+			const double r{ circumradius( i0x, i0y, i1x, i1y, input[2 * i], input[2 * i + 1] ) };
+			if( r < minRadius ) {
+				i2 = i;
+				minRadius = r;
+			}
+		}
+		// All points on a line
+		if( std::isinf( minRadius ) )
+			return;
+		double i2x{ input[2 * i2] }, i2y{ input[2 * i2 + 1] };
+		if( orient( i0x, i0y, i1x, i1y, i2x, i2y ) ) {
+			std::swap( i1, i2 );
+			std::swap( i1x, i2x );
+			std::swap( i1y, i2y );
+		}
+		circumcenter( i0x, i0y, i1x, i1y, i2x, i2y, cx, cz );
+		std::vector<double> distances( n );
+		std::vector<uint32_t> ids( n );
+		for( uint32_t i{0}; i < n; ++i ) {
+			distances[i] = distanceSq( i, cx, cz );
+			ids[i] = i;
+		}
+		std::sort( ids.begin(), ids.end(), [&distances]( const uint32_t a, const uint32_t b ) {
+			return distances[a] < distances[b];
+		} );
+		coords.resize( 2 * static_cast<size_t>( n ) );
+		for( uint32_t k{0}; k < n; ++k ) {
+			coords[2 * k] = input[2 * ids[k]];
+			coords[2 * k + 1] = input[2 * ids[k] + 1];
+			if( ids[k] == i0 || ids[k] == i1 || ids[k] == i2 )
+				( ids[k] == i0 ? s0 : ids[k] == i1 ? s1 : s2 ) = k;
+		}
+		i0 = s0;
+		i1 = s1;
+		i2 = s2;
+
+		hullPrev.assign( n, 0 );
+		hullNext.assign( n, 0 );
+		hullTri.assign( n, 0 );
+		hullHash.assign( static_cast<size_t>( std::ceil( std::sqrt( n ) ) ), NO_EDGE );
+		hullStart = i0;
+		hullNext[i0] = hullPrev[i2] = i1;
+		hullNext[i1] = hullPrev[i0] = i2;
+		hullNext[i2] = hullPrev[i1] = i0;
+		hullTri[i0] = 0;
+		hullTri[i1] = 1;
+		hullTri[i2] = 2;
+		hullHash[hashKey( i0x, i0y )] = i0;
+		hullHash[hashKey( i1x, i1y )] = i1;
+		hullHash[hashKey( i2x, i2y )] = i2;
+		// At most 2n - 5 triangles
+		triangles.reserve( 3 * ( 2 * static_cast<size_t>( n ) - 5 ) );
+		halfedges.reserve( 3 * ( 2 * static_cast<size_t>( n ) - 5 ) );
+		addTriangle( i0, i1, i2, NO_EDGE, NO_EDGE, NO_EDGE );
+
+		double xp{ 0.0 }, yp{ 0.0 };
+		for( uint32_t i{0}; i < n; ++i ) {
+			const double x{ coords[2 * i] };
+			const double y{ coords[2 * i + 1] };
+			// Skip duplicates, they get no triangles
+			if( i > 0 && std::abs( x - xp ) <= std::numeric_limits<double>::epsilon() &&
+					std::abs( y - yp ) <= std::numeric_limits<double>::epsilon() )
+				continue;
+			xp = x;
+			yp = y;
+			if( i == i0 || i == i1 || i == i2 )
+				continue;
+			// A hull edge visible from the point, starting near its angle
+			uint32_t start{0};
+			const uint32_t key{ hashKey( x, y ) };
+			for( size_t j{0}; j < hullHash.size(); ++j ) {
+				start = hullHash[( key + j ) % hullHash.size()];
+				if( NO_EDGE != start && start != hullNext[start] )
+					break;
+			}
+			start = hullPrev[start];
+			uint32_t e{ start };
+			uint32_t q;
+			while( q = hullNext[e], !orient( x, y, coords[2 * e], coords[2 * e + 1], coords[2 * q], coords[2 * q + 1] ) ) {
+				e = q;
+				if( e == start ) {
+					e = NO_EDGE;
+					break;
+				}
+			}
+			// Almost a duplicate
+			if( NO_EDGE == e )
+				continue;
+			// First triangle from the point, then forward and backward along the visible hull
+			uint32_t t{ addTriangle( e, i, hullNext[e], NO_EDGE, NO_EDGE, hullTri[e] ) };
+			hullTri[i] = legalize( t + 2 );
+			hullTri[e] = t;
+			uint32_t next{ hullNext[e] };
+			while( q = hullNext[next], orient( x, y, coords[2 * next], coords[2 * next + 1], coords[2 * q], coords[2 * q + 1] ) ) {
+				t = addTriangle( next, i, q, hullTri[i], NO_EDGE, hullTri[next] );
+				hullTri[i] = legalize( t + 2 );
+				// Off the hull
+				hullNext[next] = next;
+				next = q;
+			}
+			if( e == start )
+				while( q = hullPrev[e], orient( x, y, coords[2 * q], coords[2 * q + 1], coords[2 * e], coords[2 * e + 1] ) ) {
+					t = addTriangle( q, i, e, NO_EDGE, hullTri[e], hullTri[q] );
+					legalize( t + 2 );
+					hullTri[q] = t;
+					hullNext[e] = e;
+					e = q;
+				}
+			hullStart = hullPrev[i] = e;
+			hullNext[e] = hullPrev[next] = i;
+			hullNext[i] = next;
+			hullHash[hashKey( x, y )] = i;
+			hullHash[hashKey( coords[2 * e], coords[2 * e + 1] )] = e;
+		}
+		for( uint32_t &t : triangles )
+			t = ids[t];
+	}
+};
+
 static void computeVoronoiCells() {
 	// compute voronoi cells from positions
 	// determine water entries and outlets for each cell
 	// watersheds for each cell, set of upstream connected cells
 	// compute flow: 0.42 * area^0.69. Area = sum of connected cells in graph
 	// simple rule takes into account evaporation and filtration
+	const size_t size{ network.size() };
+	std::vector<double> coords( 2 * size );
+	for( size_t i{0}; i < size; ++i ) {
+		coords[2 * i] = network[i].position.x;
+		coords[2 * i + 1] = network[i].position.z;
+	}
+	delaunay_t{ coords, voronoi.triangles, voronoi.halfedges }.triangulate();
+	const size_t numberOfTriangles{ voronoi.triangles.size() / 3 };
+	voronoi.vertices.resize( numberOfTriangles );
+	const float maxX{ nodeGrid.minX + nodeGrid.width * nodeGrid.cellsize };
+	const float maxZ{ nodeGrid.minZ + nodeGrid.height * nodeGrid.cellsize };
+	for( size_t t{0}; t < numberOfTriangles; ++t ) {
+		const uint32_t a{ voronoi.triangles[3 * t] };
+		const uint32_t b{ voronoi.triangles[3 * t + 1] };
+		const uint32_t c{ voronoi.triangles[3 * t + 2] };
+		double x, z;
+		delaunay_t::circumcenter( coords[2 * a], coords[2 * a + 1], coords[2 * b], coords[2 * b + 1], coords[2 * c],
+				coords[2 * c + 1], x, z );
+		// Slivers on the hull have their centre far outside
+		voronoi.vertices[t] = omath::vec3{ std::clamp( static_cast<float>( x ), nodeGrid.minX, maxX ), 0.0f,
+				std::clamp( static_cast<float>( z ), nodeGrid.minZ, maxZ ) };
+	}
+	voronoi.nodeEdges.assign( size, NO_EDGE );
+	for( uint32_t e{0}; e < voronoi.triangles.size(); ++e ) {
+		const uint32_t end{ voronoi.triangles[nextHalfedge( e )] };
+		if( NO_EDGE == voronoi.halfedges[e] || NO_EDGE == voronoi.nodeEdges[end] )
+			voronoi.nodeEdges[end] = e;
+	}
+	// Area of each cell, cells on the hull are closed through their node
+	voronoi.cellAreas.assign( size, 0.0f );
+	for( size_t n{0}; n < size; ++n ) {
+		const uint32_t first{ voronoi.nodeEdges[n] };
+		if( NO_EDGE == first )
+			continue;
+		const omath::vec3 &p{ network[n].position };
+		double area{ 0.0 };
+		const omath::vec3 &start{ NO_EDGE == voronoi.halfedges[first] ? p : voronoi.vertices[first / 3] };
+		omath::vec3 previous{ start };
+		uint32_t e{ first };
+		do {
+			const omath::vec3 &v{ voronoi.vertices[e / 3] };
+			area += ( previous.x - v.x ) * ( previous.z + v.z );
+			previous = v;
+			e = voronoi.halfedges[nextHalfedge( e )];
+		} while( NO_EDGE != e && e != first );
+		area += ( previous.x - start.x ) * ( previous.z + start.z );
+		voronoi.cellAreas[n] = static_cast<float>( std::abs( area ) * 0.5 );
+	}
+	// Upstream nodes come after their parents, so one backward pass accumulates the watersheds
+	// and the Horton-Strahler numbers in O(n)
+	std::vector<float> watershed{ voronoi.cellAreas };
+	std::vector<uint32_t> maxOrder( size, 0 );
+	std::vector<uint32_t> numberOfMax( size, 0 );
+	for( size_t i{ size }; i-- > 0; ) {
+		riverNode_t &node{ network[i] };
+		node.flow = 0.42f * std::pow( watershed[i], 0.69f );
+		node.hortonStrahler = 0 == maxOrder[i] ? 1 : numberOfMax[i] >= 2 ? maxOrder[i] + 1 : maxOrder[i];
+		if( NO_NODE == node.parent )
+			continue;
+		watershed[node.parent] += watershed[i];
+		if( node.hortonStrahler > maxOrder[node.parent] ) {
+			maxOrder[node.parent] = node.hortonStrahler;
+			numberOfMax[node.parent] = 1;
+		} else if( node.hortonStrahler == maxOrder[node.parent] )
+			++numberOfMax[node.parent];
+	}
 }
 
 static void computeRidges() {
@@ -92,6 +693,30 @@ static void computeRidges() {
 	// crest height = max(heights of adjacent nodes) + l(node positon) * distance to nodes,
 	// which is equal for all nodes. l is[0..0.25] slope magnitude function.
 	// describe if terrain will be plains, plateaus, valleys, or mountains
+	const size_t numberOfTriangles{ voronoi.triangles.size() / 3 };
+	for( size_t t{0}; t < numberOfTriangles; ++t ) {
+		omath::vec3 &v{ voronoi.vertices[t] };
+		float highest{ -std::numeric_limits<float>::max() };
+		float distance{ std::numeric_limits<float>::max() };
+		for( size_t k{0}; k < 3; ++k ) {
+			const omath::vec3 &p{ network[voronoi.triangles[3 * t + k]].position };
+			highest = std::max( highest, p.y );
+			// Clamped vertices are no longer equidistant, the nearest node limits the slope
+			distance = std::min( distance, std::sqrt( ( v.x - p.x ) * ( v.x - p.x ) + ( v.z - p.z ) * ( v.z - p.z ) ) );
+		}
+		v.y = highest + networkSettings.ridgeSlope * distance;
+	}
+	// Each inner edge once, a ridge unless a river runs along the Delaunay edge
+	ridges.clear();
+	for( uint32_t e{0}; e < voronoi.triangles.size(); ++e ) {
+		const uint32_t opposite{ voronoi.halfedges[e] };
+		if( NO_EDGE == opposite || opposite < e )
+			continue;
+		const nodeHandle_t a{ voronoi.triangles[e] };
+		const nodeHandle_t b{ voronoi.triangles[nextHalfedge( e )] };
+		if( network[a].parent != b && network[b].parent != a )
+			ridges.push_back( ridge_t{ e / 3, opposite / 3 } );
+	}
 }
 
 static void classifyNodes() {
@@ -102,6 +727,31 @@ static void classifyNodes() {
 	// mark rivermouth as delta if flow > threshold (idea: sediment freight),
 	// braided if close to coasts (idea: if sediment rate is high is flow low),
 	// meanders functionally
+	// Parents come first, so the distance to the coast along the river is known for them
+	std::vector<float> coastDistance( network.size(), 0.0f );
+	for( size_t i{0}; i < network.size(); ++i ) {
+		riverNode_t &node{ network[i] };
+		float slope{ 0.0f };
+		if( NO_NODE != node.parent ) {
+			const omath::vec3 &p{ network[node.parent].position };
+			const float dx{ node.position.x - p.x };
+			const float dz{ node.position.z - p.z };
+			const float d{ std::sqrt( dx * dx + dz * dz ) };
+			coastDistance[i] = coastDistance[node.parent] + d;
+			slope = d > 0.0f ? ( node.position.y - p.y ) / d : 0.0f;
+		}
+		// Rosgen stream types by slope
+		if( slope > 0.1f )
+			node.riverType = APLUS;
+		else if( slope > 0.04f )
+			node.riverType = A;
+		else if( slope > 0.02f )
+			node.riverType = B;
+		else if( coastDistance[i] < networkSettings.coastDistance )
+			node.riverType = NO_NODE == node.parent && node.flow > networkSettings.deltaFlow ? DA : D;
+		else
+			node.riverType = C;
+	}
 }
 
 static void classifyRiver() {
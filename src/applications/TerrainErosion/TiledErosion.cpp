@@ -0,0 +1,307 @@
+
+#include "TiledErosion.h"
+#include "base/logbook.h"
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+
+using namespace orf_n;
+
+namespace {
+
+uint32_t haloFor( const uint32_t iterationsPerRound ) {
+	const uint32_t blockSize{ HydroErosionMDH07::BLOCK_SIZE };
+	// Multiple of the block size, so the solver's blocks line up with the tiles. A dry block goes inactive
+	// as a whole, so a wrong boundary can reach a block further. One more block to keep that from the tile.
+	return ( iterationsPerRound * TiledErosion::HALO_PER_ITERATION + blockSize - 1 ) / blockSize * blockSize + blockSize;
+}
+
+// The solver for the largest tile with halo
+HydroErosionMDH07::settings_t solverSettings( const TiledErosion::settings_t &settings ) {
+	HydroErosionMDH07::settings_t s{ settings.solver };
+	const uint32_t halo{ haloFor( settings.iterationsPerRound ) };
+	s.width = std::min( settings.width, settings.tileSize + 2 * halo );
+	s.height = std::min( settings.height, settings.tileSize + 2 * halo );
+	s.boundaryWaterLevel = -1.0f;
+	return s;
+}
+
+}
+
+TiledErosion::TiledErosion( const settings_t &settings ) :
+		m_settings{ settings }, m_halo{ haloFor( settings.iterationsPerRound ) }, m_solver{ solverSettings( settings ) } {
+	const uint32_t size{ m_settings.tileSize };
+	if( 0 == size || size % HydroErosionMDH07::BLOCK_SIZE != 0 || size < m_halo ) {
+		const std::string s{ "Erosion tile size " + std::to_string( size ) + " must be a multiple of " +
+				std::to_string( HydroErosionMDH07::BLOCK_SIZE ) + " and at least the halo of " +
+				std::to_string( m_halo ) + " cells." };
+		logbook::log_msg( logbook::TERRAIN, logbook::ERROR, s );
+		throw std::runtime_error( s );
+	}
+	if( m_settings.solver.boundaryWaterLevel >= 0.0f )
+		logbook::log_msg( logbook::TERRAIN, logbook::WARNING, "Tiled erosion doesn't support boundary water, ignored." );
+	m_numberOfFields = m_solver.getNumberOfStateFields();
+	m_tilesX = ( m_settings.width + size - 1 ) / size;
+	m_tilesY = ( m_settings.height + size - 1 ) / size;
+	const size_t numberOfTiles{ static_cast<size_t>( m_tilesX ) * m_tilesY };
+	const size_t tileFloats{ static_cast<size_t>( size ) * size * m_numberOfFields };
+	const size_t stripFloats{ static_cast<size_t>( 4 ) * m_halo * size * m_numberOfFields };
+	m_storeSize = numberOfTiles * ( tileFloats + stripFloats ) * sizeof( float );
+	// A new sparse file reads as 0
+	m_file = open( m_settings.storeFilename.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644 );
+	void *p{ MAP_FAILED };
+	if( m_file >= 0 && 0 == ftruncate( m_file, static_cast<off_t>( m_storeSize ) ) )
+		p = mmap( nullptr, m_storeSize, PROT_READ | PROT_WRITE, MAP_SHARED, m_file, 0 );
+	if( MAP_FAILED == p ) {
+		const std::string s{ "Error creating erosion store '" + m_settings.storeFilename + "' of " +
+				std::to_string( m_storeSize >> 20 ) + "MB: " + std::strerror( errno ) };
+		logbook::log_msg( logbook::TERRAIN, logbook::ERROR, s );
+		if( m_file >= 0 )
+			close( m_file );
+		throw std::runtime_error( s );
+	}
+	m_tiles = static_cast<float *>( p );
+	m_strips = m_tiles + numberOfTiles * tileFloats;
+	m_wetTiles.assign( numberOfTiles, 0 );
+	m_changedTiles.assign( numberOfTiles, 1 );
+	m_solver.setup();
+	logbook::log_msg( logbook::TERRAIN, logbook::INFO, "Tiled erosion " + std::to_string( m_settings.width ) + 'x' +
+			std::to_string( m_settings.height ) + " in " + std::to_string( m_tilesX ) + 'x' + std::to_string( m_tilesY ) +
+			" tiles with a halo of " + std::to_string( m_halo ) + ", store " + std::to_string( m_storeSize >> 20 ) + "MB" );
+}
+
+TiledErosion::~TiledErosion() {
+	m_solver.cleanup();
+	munmap( m_tiles, m_storeSize );
+	close( m_file );
+	unlink( m_settings.storeFilename.c_str() );
+}
+
+float *TiledErosion::tile( const uint32_t tx, const uint32_t ty, const uint32_t field ) const {
+	const size_t planeFloats{ static_cast<size_t>( m_settings.tileSize ) * m_settings.tileSize };
+	return m_tiles + ( ( static_cast<size_t>( ty ) * m_tilesX + tx ) * m_numberOfFields +
+			field ) * planeFloats;
+}
+
+float *TiledErosion::strips( const uint32_t tx, const uint32_t ty, const uint32_t field ) const {
+	const size_t stripsFloats{ static_cast<size_t>( 4 ) * m_halo * m_settings.tileSize };
+	return m_strips + ( ( static_cast<size_t>( ty ) * m_tilesX + tx ) * m_numberOfFields +
+			field ) * stripsFloats;
+}
+
+void TiledErosion::setTerrain( const terrainSource_t &source ) {
+	setStateField( HydroErosionMDH07::TERRAIN, source );
+}
+
+void TiledErosion::setStateField( const HydroErosionMDH07::stateField_t field, const terrainSource_t &source ) {
+	const uint32_t size{ m_settings.tileSize };
+	for( uint32_t ty{0}; ty < m_tilesY; ++ty )
+		for( uint32_t tx{0}; tx < m_tilesX; ++tx ) {
+			const uint32_t x{ tx * size };
+			const uint32_t y{ ty * size };
+			source( x, y, std::min( size, m_settings.width - x ), std::min( size, m_settings.height - y ),
+					tile( tx, ty, field ), size );
+			m_changedTiles[ty * m_tilesX + tx] = 1;
+		}
+}
+
+void TiledErosion::saveStrips( const uint32_t tx, const uint32_t ty ) {
+	const size_t size{ m_settings.tileSize };
+	const size_t halo{ m_halo };
+	for( uint32_t field{0}; field < m_numberOfFields; ++field ) {
+		const float *const src{ tile( tx, ty, field ) };
+		float *const top{ strips( tx, ty, field ) };
+		float *const bottom{ top + halo * size };
+		float *const left{ bottom + halo * size };
+		float *const right{ left + size * halo };
+		std::memcpy( top, src, halo * size * sizeof( float ) );
+		std::memcpy( bottom, src + ( size - halo ) * size, halo * size * sizeof( float ) );
+		for( size_t r{0}; r < size; ++r ) {
+			std::memcpy( left + r * halo, src + r * size, halo * sizeof( float ) );
+			std::memcpy( right + r * halo, src + r * size + size - halo, halo * sizeof( float ) );
+		}
+	}
+}
+
+void TiledErosion::loadTile( const uint32_t tx, const uint32_t ty ) {
+	const uint32_t size{ m_settings.tileSize };
+	const uint32_t halo{ m_halo };
+	const uint32_t x0{ tx * size };
+	const uint32_t y0{ ty * size };
+	// Extent of the neighbours in the halo in -1, 0, 1 direction, less at the edges of the grid
+	const uint32_t width[3]{
+		tx > 0 ? halo : 0, std::min( size, m_settings.width - x0 ),
+		tx + 1 < m_tilesX ? std::min( halo, m_settings.width - x0 - size ) : 0
+	};
+	const uint32_t height[3]{
+		ty > 0 ? halo : 0, std::min( size, m_settings.height - y0 ),
+		ty + 1 < m_tilesY ? std::min( halo, m_settings.height - y0 - size ) : 0
+	};
+	const uint32_t solverWidth{ width[0] + width[1] + width[2] };
+	const uint32_t solverHeight{ height[0] + height[1] + height[2] };
+	if( solverWidth != m_solver.getSettings().width || solverHeight != m_solver.getSettings().height )
+		m_solver.resize( solverWidth, solverHeight );
+	const uint32_t offsetX[3]{ 0, width[0], width[0] + width[1] };
+	const uint32_t offsetY[3]{ 0, height[0], height[0] + height[1] };
+	for( uint32_t field{0}; field < m_numberOfFields; ++field ) {
+		ErosionField &dst{ m_solver.getStateField( static_cast<HydroErosionMDH07::stateField_t>( field ) ) };
+		for( int dy{-1}; dy <= 1; ++dy )
+			for( int dx{-1}; dx <= 1; ++dx ) {
+				const uint32_t w{ width[dx + 1] };
+				const uint32_t h{ height[dy + 1] };
+				if( 0 == w || 0 == h )
+					continue;
+				// Source of the region: the tile itself or a border strip of a neighbour
+				const float *src;
+				size_t stride{ size };
+				if( 0 == dx && 0 == dy )
+					src = tile( tx, ty, field );
+				else {
+					const float *const top{ strips( tx + dx, ty + dy, field ) };
+					const float *const bottom{ top + static_cast<size_t>( halo ) * size };
+					const float *const left{ bottom + static_cast<size_t>( halo ) * size };
+					const float *const right{ left + static_cast<size_t>( size ) * halo };
+					// First column in the neighbour
+					const uint32_t column{ dx < 0 ? size - w : 0 };
+					if( dy < 0 )
+						src = bottom + column;
+					else if( dy > 0 )
+						src = top + column;
+					else {
+						src = dx < 0 ? right + halo - w : left;
+						stride = halo;
+					}
+				}
+				for( uint32_t r{0}; r < h; ++r )
+					std::copy_n( src + r * stride, w, dst.row( offsetY[dy + 1] + r ) + offsetX[dx + 1] );
+			}
+	}
+	m_solver.stateChanged();
+}
+
+bool TiledErosion::storeTile( const uint32_t tx, const uint32_t ty ) {
+	const uint32_t size{ m_settings.tileSize };
+	const uint32_t x0{ tx * size };
+	const uint32_t y0{ ty * size };
+	const uint32_t w{ std::min( size, m_settings.width - x0 ) };
+	const uint32_t h{ std::min( size, m_settings.height - y0 ) };
+	// Position of the tile in the solver
+	const uint32_t offsetX{ tx > 0 ? m_halo : 0 };
+	const uint32_t offsetY{ ty > 0 ? m_halo : 0 };
+	const float threshold{ m_settings.solver.activeThreshold };
+	bool wet{ false };
+	for( uint32_t field{0}; field < m_numberOfFields; ++field ) {
+		const ErosionField &src{ m_solver.getStateField( static_cast<HydroErosionMDH07::stateField_t>( field ) ) };
+		float *const dst{ tile( tx, ty, field ) };
+		for( uint32_t r{0}; r < h; ++r ) {
+			const float *const row{ src.row( offsetY + r ) + offsetX };
+			std::copy_n( row, w, dst + static_cast<size_t>( r ) * size );
+			if( HydroErosionMDH07::WATER == field )
+				wet = wet || std::any_of( row, row + w, [threshold]( const float d ) { return d > threshold; } );
+		}
+	}
+	// Written back to the file by the kernel, drop the pages from this process
+	madvise( tile( tx, ty, 0 ), static_cast<size_t>( size ) * size * m_numberOfFields *
+			sizeof( float ), MADV_DONTNEED );
+	return wet;
+}
+
+bool TiledErosion::hasWetNeighbourhood( const uint32_t tx, const uint32_t ty ) const {
+	for( uint32_t y{ ty > 0 ? ty - 1 : 0 }; y <= std::min( ty + 1, m_tilesY - 1 ); ++y )
+		for( uint32_t x{ tx > 0 ? tx - 1 : 0 }; x <= std::min( tx + 1, m_tilesX - 1 ); ++x )
+			if( m_wetTiles[y * m_tilesX + x] )
+				return true;
+	return false;
+}
+
+float TiledErosion::getTimeStep() const {
+	const HydroErosionMDH07::settings_t &s{ m_settings.solver };
+	if( !s.adaptiveTimeStep || 0 == m_iteration )
+		return s.timeStep;
+	// Fastest flow of the last round by the CFL condition, see HydroErosionMDH07::getStableTimeStep()
+	float deltatime{ s.maxTimeStep };
+	if( m_maxSpeed > 0.0f )
+		deltatime = s.courantNumber * s.cellsize / m_maxSpeed;
+	deltatime = std::min( deltatime, 2.0f * m_lastTimeStep );
+	return std::clamp( deltatime, s.minTimeStep, s.maxTimeStep );
+}
+
+uint32_t TiledErosion::round() {
+	const float deltatime{ getTimeStep() };
+	const bool raining{ m_settings.solver.aDropOfRain * m_settings.solver.rainMultiplier > 0.0f };
+	m_solver.getSettings().rainMultiplier = m_settings.solver.rainMultiplier;
+	// Halos of this round from the state before it
+	for( uint32_t ty{0}; ty < m_tilesY; ++ty )
+		for( uint32_t tx{0}; tx < m_tilesX; ++tx )
+			if( m_changedTiles[ty * m_tilesX + tx] )
+				saveStrips( tx, ty );
+	std::vector<uint8_t> wet( m_wetTiles.size(), 0 );
+	std::fill( m_changedTiles.begin(), m_changedTiles.end(), 0 );
+	float maxSpeed{ 0.0f };
+	uint32_t simulated{0};
+	for( uint32_t ty{0}; ty < m_tilesY; ++ty )
+		for( uint32_t tx{0}; tx < m_tilesX; ++tx ) {
+			if( !raining && !hasWetNeighbourhood( tx, ty ) )
+				continue;
+			loadTile( tx, ty );
+			for( uint32_t i{0}; i < m_settings.iterationsPerRound; ++i ) {
+				m_solver.step( deltatime );
+				maxSpeed = std::max( maxSpeed, m_solver.getMaxSpeed() );
+			}
+			wet[ty * m_tilesX + tx] = storeTile( tx, ty );
+			m_changedTiles[ty * m_tilesX + tx] = 1;
+			++simulated;
+		}
+	m_wetTiles.swap( wet );
+	m_iteration += m_settings.iterationsPerRound;
+	m_simulatedTime += static_cast<double>( deltatime ) * m_settings.iterationsPerRound;
+	m_maxSpeed = maxSpeed;
+	m_lastTimeStep = deltatime;
+	return simulated;
+}
+
+void TiledErosion::read( const HydroErosionMDH07::stateField_t field, const uint32_t x, const uint32_t y,
+		const uint32_t width, const uint32_t height, float *heights, const size_t stride ) const {
+	const uint32_t size{ m_settings.tileSize };
+	for( uint32_t r{0}; r < height; ++r ) {
+		const uint32_t gy{ y + r };
+		for( uint32_t gx{ x }; gx < x + width; ) {
+			// Up to the end of the tile
+			const uint32_t n{ std::min( x + width, ( gx / size + 1 ) * size ) - gx };
+			const float *const src{ tile( gx / size, gy / size, field ) + static_cast<size_t>( gy % size ) * size + gx % size };
+			std::copy_n( src, n, heights + r * stride + ( gx - x ) );
+			gx += n;
+		}
+	}
+}
+
+TiledErosion::settings_t &TiledErosion::getSettings() {
+	return m_settings;
+}
+
+uint32_t TiledErosion::getHalo() const {
+	return m_halo;
+}
+
+uint32_t TiledErosion::getNumberOfTiles() const {
+	return m_tilesX * m_tilesY;
+}
+
+uint64_t TiledErosion::getIteration() const {
+	return m_iteration;
+}
+
+double TiledErosion::getSimulatedTime() const {
+	return m_simulatedTime;
+}
+
+size_t TiledErosion::getSizeOfStore() const {
+	return m_storeSize;
+}
+
+size_t TiledErosion::getSizeInMemory() const {
+	return m_solver.getSizeInMemory();
+}
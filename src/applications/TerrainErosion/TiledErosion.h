@@ -0,0 +1,140 @@
+#pragma once
+
+#include "HydroErosionMDH07.h"
+#include <functional>
+#include <string>
+#include <vector>
+
+/**
+ * Hydraulic erosion on grids larger than memory.
+ * The domain is split into square tiles. The state of all tiles lives in a memory mapped file, so tiles
+ * that are not in use are paged out. A round loads one tile after the other into the solver, together with a
+ * halo of the neighbouring tiles, runs a number of iterations and writes the tile back. The wrong boundary at
+ * the outer edge of the halo disturbs the solution by at most a few cells per iteration, the halo is wide
+ * enough that this doesn't reach the tile in one round.
+ * Before a round the border strips of the tiles are saved, the halos are read from them. So all tiles of a
+ * round start from the same state, as if the whole grid was simulated at once.
+ * Without rain, tiles that are dry and have dry neighbours are skipped. Dry blocks of the solver settle their
+ * sediment as a whole, which can carry a wrong halo boundary further and make results differ slightly from
+ * a simulation of the whole grid after the rain.
+ */
+class TiledErosion {
+public:
+
+	struct settings_t {
+		// Size of the whole grid in cells
+		uint32_t width{0};
+		uint32_t height{0};
+		// Edge length of the tiles in cells, a multiple of the solver's block size
+		uint32_t tileSize{1024};
+		// Iterations per tile and round, the halo grows with it
+		uint32_t iterationsPerRound{8};
+		// File for the state of all tiles and their border strips, removed when done
+		std::string storeFilename{"erosion.store"};
+		// Parameters of the solver, its size is set per tile. Boundary water is not supported.
+		HydroErosionMDH07::settings_t solver;
+	};
+
+	// Cells per iteration a disturbance travels, the flux, water, velocity and transport passes each read neighbours
+	static constexpr uint32_t HALO_PER_ITERATION{ 4 };
+
+	// Called to fill a region of the terrain: x, y, width, height of the region, heights, stride between rows
+	typedef std::function<void( uint32_t, uint32_t, uint32_t, uint32_t, float *, size_t )> terrainSource_t;
+
+	/**
+	 * Create the store, all state 0.
+	 * Throws std::runtime_error if the tile size doesn't fit or the store can't be created.
+	 */
+	TiledErosion( const settings_t &settings );
+
+	virtual ~TiledErosion();
+
+	TiledErosion( const TiledErosion & ) = delete;
+
+	TiledErosion &operator=( const TiledErosion & ) = delete;
+
+	// Fill the terrain tile by tile
+	void setTerrain( const terrainSource_t &source );
+
+	// Same for another state field, e.g. the thickness of a stratum
+	void setStateField( const HydroErosionMDH07::stateField_t field, const terrainSource_t &source );
+
+	// Simulate iterationsPerRound on all tiles that may have water, returns the number of tiles simulated
+	uint32_t round();
+
+	// Copy a region of a state field of the whole grid to heights with stride between rows
+	void read( const HydroErosionMDH07::stateField_t field, const uint32_t x, const uint32_t y,
+			const uint32_t width, const uint32_t height, float *heights, const size_t stride ) const;
+
+	// Solver parameters like rain apply from the next round, sizes must not be changed
+	settings_t &getSettings();
+
+	uint32_t getHalo() const;
+
+	uint32_t getNumberOfTiles() const;
+
+	uint64_t getIteration() const;
+
+	double getSimulatedTime() const;
+
+	size_t getSizeOfStore() const;
+
+	// Memory of the solver for one tile and its halo
+	size_t getSizeInMemory() const;
+
+private:
+	settings_t m_settings;
+
+	uint32_t m_halo{0};
+
+	uint32_t m_tilesX{0};
+
+	uint32_t m_tilesY{0};
+
+	int m_file{-1};
+
+	size_t m_storeSize{0};
+
+	// State fields of the solver in use
+	uint32_t m_numberOfFields{0};
+
+	// Per tile m_numberOfFields planes of tileSize^2 cells
+	float *m_tiles{ nullptr };
+
+	// Per tile and state field the border strips: top and bottom halo x tileSize, left and right tileSize x halo
+	float *m_strips{ nullptr };
+
+	HydroErosionMDH07 m_solver;
+
+	// Tiles with water after their last round
+	std::vector<uint8_t> m_wetTiles;
+
+	// Tiles simulated in the last round, their strips are outdated
+	std::vector<uint8_t> m_changedTiles;
+
+	uint64_t m_iteration{0};
+
+	double m_simulatedTime{0.0};
+
+	float m_maxSpeed{0.0f};
+
+	float m_lastTimeStep{0.0f};
+
+	float *tile( const uint32_t tx, const uint32_t ty, const uint32_t field ) const;
+
+	float *strips( const uint32_t tx, const uint32_t ty, const uint32_t field ) const;
+
+	void saveStrips( const uint32_t tx, const uint32_t ty );
+
+	// Load a tile with its halo into the solver
+	void loadTile( const uint32_t tx, const uint32_t ty );
+
+	// Write the tile back from the solver and release its pages, returns if it has water
+	bool storeTile( const uint32_t tx, const uint32_t ty );
+
+	// Same time step for all tiles of a round
+	float getTimeStep() const;
+
+	bool hasWetNeighbourhood( const uint32_t tx, const uint32_t ty ) const;
+
+};
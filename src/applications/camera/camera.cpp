@@ -2,6 +2,7 @@
 #include "applications/camera/camera.h"
 #include "base/glfw_window.h"
 #include "base/globals.h"		// deltaTime
+#include "base/logbook.h"
 //#include "geometry/Plane.h"
 #include "omath/mat4.h"
 #include <iostream>
@@ -43,10 +44,38 @@ camera::camera( glfw_window *win,
 	update_camera_vectors();
 }
 
+camera::camera( const float aspectRatio,
+				omath::dvec3 position,
+				omath::dvec3 target,
+				omath::vec3 up,
+				float nearPlane,
+				float farPlane,
+				camera_mode_t mode ) :
+						event_handler{ nullptr },
+						m_window{ nullptr },
+						m_aspectRatio{ aspectRatio },
+						m_position{ position },
+						m_target{ target },
+						m_nearPlane{ nearPlane },
+						m_farPlane{ farPlane },
+						m_up{ up },
+						m_mode{ mode } {
+	// No window, no input events to register
+	calculate_initial_angles();
+	calculate_fov();
+	update_camera_vectors();
+}
+
+float camera::get_aspect_ratio() const {
+	if( nullptr == m_window )
+		return m_aspectRatio;
+	return (float)m_window->get_width() / (float)m_window->get_height();
+}
+
 void camera::calculate_fov() {
 	m_perspectiveMatrix = omath::perspective(
 			omath::radians( m_zoom ),
-			(float)m_window->get_width() / (float)m_window->get_height(),
+			get_aspect_ratio(),
 			m_nearPlane, m_farPlane
 	);
 	/*const float zModMul{ 1.001f };
@@ -54,8 +83,7 @@ void camera::calculate_fov() {
 	m_zOffsetPerspectiveMatrix = omath::perspective( omath::radians( m_zoom ),
 			(float)m_window->getWidth() / (float)m_window->getHeight(),
 			m_nearPlane * zModMul + zModAdd, m_farPlane * zModMul + zModAdd );*/
-	m_frustum.set_fov( m_zoom, (float)m_window->get_width() / (float)m_window->get_height(),
-			m_nearPlane, m_farPlane );
+	m_frustum.set_fov( m_zoom, get_aspect_ratio(), m_nearPlane, m_farPlane );
 }
 
 void camera::calculate_initial_angles() {
@@ -111,7 +139,7 @@ void camera::update_camera_vectors() {
 
 // virtual
 bool camera::on_mouse_move( float x, float y ) {
-	if( !m_window->is_cursor_disabled() )
+	if( m_replaying || !m_window->is_cursor_disabled() )
 		return false;
 	bool handled{ false };
 	// @todo/fixme cursor should center automatically, according to glfw doc, but doesn't
@@ -152,6 +180,9 @@ bool camera::on_mouse_scroll( float xOffset, float yOffset ) {
 // virtual
 bool camera::on_key_pressed( int key, int scancode, int action, int mods ) {
 	bool handled{ false };
+	// A replay only listens to escape
+	if( m_replaying && GLFW_KEY_ESCAPE != key )
+		return handled;
 	// movement is mirrored between fps and orbiting mode
     if( GLFW_PRESS == action ) {
     	switch( key ) {
@@ -301,6 +332,18 @@ void camera::update_moving() {
 		if( oldNearPlane != m_nearPlane || oldFarPlane != m_farPlane || oldZoom != m_zoom )
 			calculateFOV();
 	}*/
+	if( m_replaying ) {
+		camera_path::frame_t frame;
+		if( m_path.next_frame( frame ) ) {
+			set_path_frame( frame );
+			return;
+		}
+		m_replaying = false;
+		logbook::log_msg( logbook::RENDERER, logbook::INFO, "Camera path replay finished after " +
+				std::to_string( m_path.get_current_frame() ) + " frames." );
+		if( m_closeAfterReplay && nullptr != m_window )
+			m_window->set_should_close();
+	}
 	if( m_isMoving ) {
 		float velocity = m_movementSpeed * (float)globals::delta_time;
 		switch( m_direction ) {
@@ -360,6 +403,56 @@ void camera::update_moving() {
 		}
 	}
 	update_camera_vectors();
+	if( m_path.is_recording() )
+		m_path.record( get_path_frame() );
+}
+
+void camera::start_recording( const std::string &filename ) {
+	m_path.begin_recording( filename );
+}
+
+void camera::stop_recording() {
+	m_path.end_recording();
+}
+
+void camera::start_replay( const std::string &filename, const double time_step, const bool close_when_done ) {
+	m_path.end_recording();
+	m_path.load( filename );
+	m_replayTimeStep = time_step;
+	m_closeAfterReplay = close_when_done;
+	m_isMoving = false;
+	m_replaying = true;
+}
+
+bool camera::is_replaying() const {
+	return m_replaying;
+}
+
+const double &camera::get_replay_time_step() const {
+	return m_replayTimeStep;
+}
+
+camera_path::frame_t camera::get_path_frame() const {
+	return camera_path::frame_t{ m_position, m_target, m_up, m_yaw, m_pitch, m_zoom,
+		m_nearPlane, m_farPlane, static_cast<uint8_t>( m_mode ) };
+}
+
+void camera::set_path_frame( const camera_path::frame_t &frame ) {
+	const bool fovChanged{ frame.zoom != m_zoom || frame.near_plane != m_nearPlane ||
+		frame.far_plane != m_farPlane };
+	m_position = frame.position;
+	m_target = frame.target;
+	m_distanceToTarget = omath::magnitude( m_target - m_position );
+	m_up = frame.up;
+	m_yaw = frame.yaw;
+	m_pitch = frame.pitch;
+	m_zoom = frame.zoom;
+	m_nearPlane = frame.near_plane;
+	m_farPlane = frame.far_plane;
+	m_mode = static_cast<camera_mode_t>( frame.mode );
+	if( fovChanged )
+		calculate_fov();
+	update_camera_vectors();
 }
 
 void camera::set_position_and_target( const omath::dvec3 &pos, const omath::dvec3 &target ) {
@@ -466,7 +559,8 @@ const omath::vec3 &camera::get_up() const {
 }
 
 camera::~camera() {
-	de_register_object( this );
+	if( nullptr != m_window )
+		de_register_object( this );
 }
 
 }
@@ -5,6 +5,7 @@
 
 #pragma once
 
+#include "applications/camera/camera_path.h"
 #include "base/event_handler.h"
 #include "geometry/view_frustum.h"
 #include "omath/mat4.h"
@@ -39,7 +40,19 @@ public:
 			omath::dvec3 position,
 			omath::dvec3 target,
 			omath::vec3 up = omath::vec3{ 0.0f, 1.0f, 0.0f },
-			float neaPlane = 1.0f,
+			float nearPlane = 1.0f,
+			float farPlane = 100.0f,
+			camera_mode_t mode = ORBITING );
+
+	/**
+	 * Headless camera without window and input, e.g. for benchmarks that drive the camera
+	 * themselves. The aspect ratio replaces the window's framebuffer size.
+	 */
+	camera( const float aspectRatio,
+			omath::dvec3 position,
+			omath::dvec3 target,
+			omath::vec3 up = omath::vec3{ 0.0f, 1.0f, 0.0f },
+			float nearPlane = 1.0f,
 			float farPlane = 100.0f,
 			camera_mode_t mode = ORBITING );
 
@@ -105,9 +118,42 @@ public:
 
 	void set_far_plane( const float &fp );
 
+	/**
+	 * Append the camera state of every frame to a camera path log, from the next
+	 * update_moving() on. Throws if the file can't be created.
+	 */
+	void start_recording( const std::string &filename );
+
+	void stop_recording();
+
+	/**
+	 * Replay a recorded camera path. While replaying, update_moving() sets the state
+	 * of the next recorded frame and input is ignored. The renderer advances time by the
+	 * fixed time step instead of the measured frame time. If close_when_done is set, the
+	 * window is closed after the last frame. Throws if the path can't be loaded.
+	 */
+	void start_replay( const std::string &filename, const double time_step = 1.0 / 60.0,
+			const bool close_when_done = true );
+
+	bool is_replaying() const;
+
+	const double &get_replay_time_step() const;
+
+	camera_path::frame_t get_path_frame() const;
+
+	/**
+	 * Set position, target, angles, zoom, planes and mode from a recorded frame.
+	 * Used by the replay and by headless tools stepping through a path themselves.
+	 */
+	void set_path_frame( const camera_path::frame_t &frame );
+
 private:
+	// nullptr for a headless camera
 	glfw_window *m_window;
 
+	// Used instead of the window's framebuffer size by a headless camera
+	float m_aspectRatio{ 1.0f };
+
 	omath::dvec3 m_position;
 
 	/**
@@ -182,6 +228,17 @@ private:
 	 */
 	bool m_wireframe{ false };
 
+	/**
+	 * Log for recording or replay of the camera state per frame.
+	 */
+	camera_path m_path;
+
+	bool m_replaying{ false };
+
+	double m_replayTimeStep{ 1.0 / 60.0 };
+
+	bool m_closeAfterReplay{ true };
+
 	bool on_key_pressed( int key, int scancode, int action, int mods ) override final;
 
 	bool on_mouse_move( float x, float y ) override final;
@@ -198,6 +255,11 @@ private:
 	 */
 	void calculate_initial_angles();
 
+	/**
+	 * Framebuffer width / height, or the fixed aspect ratio if headless.
+	 */
+	float get_aspect_ratio() const;
+
 	/**
 	 * Helper func calculates cam vectors on key press or mous move, depending on mode.
 	 * Depend on prior calculateInitialValues() on camera creation or change of
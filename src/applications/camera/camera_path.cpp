@@ -0,0 +1,127 @@
+#include "applications/camera/camera_path.h"
+#include "base/logbook.h"
+#include <cstring>
+#include <stdexcept>
+
+namespace orf_n {
+
+namespace {
+
+const char MAGIC[8]{ 'O', 'R', 'F', 'N', 'C', 'A', 'M', 'P' };
+
+// Field by field, so the record has no padding and the same layout on all compilers.
+void pack( const camera_path::frame_t &f, char *p ) {
+	const double d[6]{ f.position.x, f.position.y, f.position.z, f.target.x, f.target.y, f.target.z };
+	const float v[8]{ f.up.x, f.up.y, f.up.z, f.yaw, f.pitch, f.zoom, f.near_plane, f.far_plane };
+	std::memcpy( p, d, sizeof(d) );
+	std::memcpy( p + sizeof(d), v, sizeof(v) );
+	p[sizeof(d) + sizeof(v)] = static_cast<char>( f.mode );
+}
+
+void unpack( const char *p, camera_path::frame_t &f ) {
+	double d[6];
+	float v[8];
+	std::memcpy( d, p, sizeof(d) );
+	std::memcpy( v, p + sizeof(d), sizeof(v) );
+	f.position = omath::dvec3{ d[0], d[1], d[2] };
+	f.target = omath::dvec3{ d[3], d[4], d[5] };
+	f.up = omath::vec3{ v[0], v[1], v[2] };
+	f.yaw = v[3];
+	f.pitch = v[4];
+	f.zoom = v[5];
+	f.near_plane = v[6];
+	f.far_plane = v[7];
+	f.mode = static_cast<uint8_t>( p[sizeof(d) + sizeof(v)] );
+}
+
+}	// namespace
+
+camera_path::~camera_path() {
+	end_recording();
+}
+
+void camera_path::begin_recording( const std::string &filename ) {
+	end_recording();
+	m_out.open( filename, std::ios::out | std::ios::binary | std::ios::trunc );
+	if( !m_out.is_open() ) {
+		const std::string s{ "Error creating camera path '" + filename + "'." };
+		logbook::log_msg( logbook::RENDERER, logbook::ERROR, s );
+		throw std::runtime_error{ s };
+	}
+	m_out.write( MAGIC, sizeof(MAGIC) );
+	m_out.write( reinterpret_cast<const char *>( &VERSION ), sizeof(VERSION) );
+	m_out.write( reinterpret_cast<const char *>( &FRAME_SIZE ), sizeof(FRAME_SIZE) );
+	logbook::log_msg( logbook::RENDERER, logbook::INFO, "Recording camera path to '" + filename + "'." );
+}
+
+void camera_path::record( const frame_t &frame ) {
+	if( !m_out.is_open() )
+		return;
+	char record[FRAME_SIZE];
+	pack( frame, record );
+	m_out.write( record, FRAME_SIZE );
+	++m_currentFrame;
+}
+
+void camera_path::end_recording() {
+	if( !m_out.is_open() )
+		return;
+	m_out.close();
+	logbook::log_msg( logbook::RENDERER, logbook::INFO,
+			"Camera path recording ended after " + std::to_string( m_currentFrame ) + " frames." );
+	m_currentFrame = 0;
+}
+
+bool camera_path::is_recording() const {
+	return m_out.is_open();
+}
+
+void camera_path::load( const std::string &filename ) {
+	std::ifstream file{ filename, std::ios::ate | std::ios::binary };
+	if( !file.is_open() ) {
+		const std::string s{ "Error opening camera path '" + filename + "'." };
+		logbook::log_msg( logbook::RENDERER, logbook::ERROR, s );
+		throw std::runtime_error{ s };
+	}
+	const size_t fileSize{ (size_t)file.tellg() };
+	file.seekg( 0 );
+	char magic[sizeof(MAGIC)]{};
+	uint32_t version{ 0 };
+	uint32_t frameSize{ 0 };
+	file.read( magic, sizeof(magic) );
+	file.read( reinterpret_cast<char *>( &version ), sizeof(version) );
+	file.read( reinterpret_cast<char *>( &frameSize ), sizeof(frameSize) );
+	if( !file || 0 != std::memcmp( magic, MAGIC, sizeof(MAGIC) ) || VERSION != version || FRAME_SIZE != frameSize ) {
+		const std::string s{ "'" + filename + "' is not a camera path of version " + std::to_string( VERSION ) + "." };
+		logbook::log_msg( logbook::RENDERER, logbook::ERROR, s );
+		throw std::runtime_error{ s };
+	}
+	const size_t headerSize{ sizeof(MAGIC) + sizeof(version) + sizeof(frameSize) };
+	// A trailing partial record of an interrupted recording is dropped
+	const size_t numFrames{ ( fileSize - headerSize ) / FRAME_SIZE };
+	std::vector<char> buffer( numFrames * FRAME_SIZE );
+	file.read( buffer.data(), buffer.size() );
+	m_frames.resize( numFrames );
+	for( size_t i{ 0 }; i < numFrames; ++i )
+		unpack( buffer.data() + i * FRAME_SIZE, m_frames[i] );
+	m_currentFrame = 0;
+	logbook::log_msg( logbook::RENDERER, logbook::INFO,
+			"Loaded camera path '" + filename + "' with " + std::to_string( numFrames ) + " frames." );
+}
+
+bool camera_path::next_frame( frame_t &frame ) {
+	if( m_currentFrame >= m_frames.size() )
+		return false;
+	frame = m_frames[m_currentFrame++];
+	return true;
+}
+
+size_t camera_path::get_number_of_frames() const {
+	return m_frames.size();
+}
+
+size_t camera_path::get_current_frame() const {
+	return m_currentFrame;
+}
+
+}	// namespace
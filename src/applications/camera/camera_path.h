@@ -0,0 +1,83 @@
+
+/**
+ * Binary log of per frame camera states, for recording fly-throughs and replaying
+ * them frame by frame.
+ *
+ * File layout: 8 byte magic "ORFNCAMP", uint32 version, uint32 frame record size,
+ * followed by one packed record per frame in host byte order. The number of frames
+ * follows from the file size, so a log of an aborted session stays readable.
+ */
+
+#pragma once
+
+#include "omath/vec3.h"
+#include <cstdint>
+#include <fstream>
+#include <string>
+#include <vector>
+
+namespace orf_n {
+
+class camera_path {
+public:
+	/**
+	 * Camera state of one frame. Yaw and pitch are stored in addition to the target
+	 * because in first person mode the view direction does not follow from the target.
+	 */
+	typedef struct {
+		omath::dvec3 position;
+		omath::dvec3 target;
+		omath::vec3 up;
+		float yaw;
+		float pitch;
+		float zoom;
+		float near_plane;
+		float far_plane;
+		uint8_t mode;
+	} frame_t;
+
+	static constexpr uint32_t VERSION{ 1 };
+
+	// Packed size of a frame record on disk
+	static constexpr uint32_t FRAME_SIZE{ 2 * 3 * sizeof(double) + 8 * sizeof(float) + sizeof(uint8_t) };
+
+	camera_path() = default;
+
+	virtual ~camera_path();
+
+	/**
+	 * Create the log file and write the header. Frames are appended by record().
+	 * Throws if the file can't be created.
+	 */
+	void begin_recording( const std::string &filename );
+
+	void record( const frame_t &frame );
+
+	void end_recording();
+
+	bool is_recording() const;
+
+	/**
+	 * Read a whole log for replay. Throws if the file can't be read or is not a camera path.
+	 */
+	void load( const std::string &filename );
+
+	/**
+	 * Copy the next frame of a loaded log. Returns false when all frames have been replayed.
+	 */
+	bool next_frame( frame_t &frame );
+
+	size_t get_number_of_frames() const;
+
+	size_t get_current_frame() const;
+
+private:
+	std::ofstream m_out;
+
+	std::vector<frame_t> m_frames;
+
+	size_t m_currentFrame{ 0 };
+
+};
+
+}	// namespace
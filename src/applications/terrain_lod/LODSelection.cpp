@@ -2,8 +2,12 @@
 #include "LODSelection.h"
 #include "node.h"
 #include "quadtree.h"
+#include "TerrainTile.h"
 #include "base/logbook.h"
 #include "omath/common.h"	// lerp()
+#include <algorithm>
+#include <limits>
+#include <numeric>
 #include <sstream>
 #include <iostream>
 
@@ -50,6 +54,49 @@ void LODSelection::reset() {
 	m_selectionCount = 0;
 	m_maxSelectedLODLevel = 0;
 	m_minSelectedLODLevel = NUMBER_OF_LOD_LEVELS;
+	m_occludedCount = 0;
+	m_culledCount = 0;
+	m_horizon.reset( m_camera->get_view_perspective__matrix() );
+	m_untested.clear();
+	m_pendingOccluders = decltype( m_pendingOccluders ){};
+}
+
+void LODSelection::select( const std::vector<TerrainTile *> &tiles ) {
+	reset();
+	// Nearest tile first for the horizon culling
+	std::vector<int> tileOrder( tiles.size() );
+	std::iota( tileOrder.begin(), tileOrder.end(), 0 );
+	if( m_occlusionCulling )
+		std::sort( tileOrder.begin(), tileOrder.end(), [this, &tiles]( const int a, const int b ) {
+			return m_horizon.nearestDepth( *tiles[a]->getAABB() ) < m_horizon.nearestDepth( *tiles[b]->getAABB() );
+		} );
+	if( m_occlusionCulling )
+		m_untested.push_back( std::numeric_limits<float>::max() );
+	for( size_t k{ 0 }; k < tileOrder.size(); ++k ) {
+		const int i{ tileOrder[k] };
+		if( m_occlusionCulling )
+			m_untested.back() = k + 1 < tileOrder.size() ?
+				m_horizon.nearestDepth( *tiles[tileOrder[k + 1]]->getAABB() ) :
+				std::numeric_limits<float>::max();
+		m_currentTileIndex = i;
+		tiles[i]->getQuadTree()->lodSelect( this );
+	}
+	setDistancesAndSort();
+}
+
+bool LODSelection::isOccluded( const orf_n::aabb &box, const float nearestDepth ) {
+	float nearest{ nearestDepth };
+	for( const float d : m_untested )
+		nearest = std::min( nearest, d );
+	while( !m_pendingOccluders.empty() && m_pendingOccluders.top().first <= nearest ) {
+		m_horizon.addOccluder( *m_pendingOccluders.top().second );
+		m_pendingOccluders.pop();
+	}
+	return m_horizon.isOccluded( box );
+}
+
+void LODSelection::addOccluder( const orf_n::aabb *box ) {
+	m_pendingOccluders.push( { m_horizon.farthestDepth( *box ), box } );
 }
 
 static inline int compareCloserFirst( const void *arg1, const void *arg2 ) {
@@ -7,13 +7,17 @@
 #pragma once
 
 #include <applications/terrain_lod/settings.h>
+#include <applications/terrain_lod/horizon.h>
 #include "applications/camera/camera.h"
 #include "omath/vec4.h"
+#include <queue>
+#include <vector>
 
 namespace terrain {
 
 class node;
 class quad_tree;
+class TerrainTile;
 
 class LODSelection {
 public:
@@ -47,8 +51,27 @@ public:
 
 	void reset();
 
+	/**
+	 * Resets the selection and selects nodes of all tiles. With occlusion culling
+	 * the tiles are visited nearest first. Tile index is the index in the vector.
+	 */
+	void select( const std::vector<TerrainTile *> &tiles );
+
 	void print_selection() const;
 
+	/**
+	 * Horizon test of a box with the given nearest view depth. Queued occluders that lie in front
+	 * of every node not tested yet are added to the horizon first.
+	 */
+	bool isOccluded( const orf_n::aabb &box, const float nearestDepth );
+
+	/**
+	 * Queues the box of selected terrain as occluder. Sibling subtrees are finished one after
+	 * another, so it may only raise the horizon once no node in front of its farthest depth
+	 * is left to test.
+	 */
+	void addOccluder( const orf_n::aabb *box );
+
 	const omath::vec4 getMorphConsts( const int lodLevel ) const;
 
 	const orf_n::camera *m_camera{ nullptr };
@@ -73,6 +96,32 @@ public:
 
 	int m_minSelectedLODLevel{ NUMBER_OF_LOD_LEVELS };
 
+	/**
+	 * Horizon occlusion culling. Traverses nodes front to back and skips subtrees
+	 * hidden behind already selected terrain.
+	 */
+	bool m_occlusionCulling{ true };
+
+	horizon m_horizon;
+
+	/**
+	 * Nearest view depth of the next tile, top node or sibling not visited yet, one entry per
+	 * traversal level. Each level is visited by nearest depth and children are never nearer
+	 * than their parent, so the minimum bounds the depth of everything not tested.
+	 */
+	std::vector<float> m_untested;
+
+	typedef std::pair<float, const orf_n::aabb *> occluder_t;
+
+	// Selected boxes by farthest view depth that wait for the nodes in front of them to be tested
+	std::priority_queue<occluder_t, std::vector<occluder_t>, std::greater<occluder_t>> m_pendingOccluders;
+
+	// Number of nodes culled by the horizon during the last selection
+	int m_occludedCount{ 0 };
+
+	// Number of nodes culled by the view frustum during the last selection
+	int m_culledCount{ 0 };
+
 };
 
 }
@@ -11,6 +11,7 @@
 #include "base/globals.h"
 #include "scene/scene.h"
 #include "base/logbook.h"
+#include "base/profiler.h"
 #include "geometry/aabb.h"
 #include "omath/mat4.h"
 #include "renderer/IndexBuffer.h"
@@ -117,12 +118,10 @@ void TerrainLOD::render() {
 
 	// Perform selection @todo parametrize sorting and concatenate lod selection
 	// reset selection, add nodes, sort selection, sort by tile index, nearest to farest
-	m_lodSelection->reset();
-	for( int i{0}; i < MAX_NUMBER_OF_TILES; ++i ) {
-		m_lodSelection->m_currentTileIndex = i;
-		m_terrainTiles[i]->getQuadTree()->lodSelect( m_lodSelection );
+	{
+		orf_n::profiler::scoped_zone zone{ "LOD selection" };
+		m_lodSelection->select( m_terrainTiles );
 	}
-	m_lodSelection->setDistancesAndSort();
 
 	//m_lodSelection->print_selection();
 
@@ -134,26 +133,30 @@ void TerrainLOD::render() {
 	// Bind meshes, shader, reset stats, prepare and set matrices and cam pos
 	if( !m_drawSelection )
 		return;
-	m_drawGridMesh->bind();
-	m_renderStats.reset();
-	m_shaderTerrain->use();
-	if( refreshUniforms )
-		orf_n::set_uniform( m_shaderTerrain->getProgram(), "g_diffuseLightDir", m_diffuseLightPos );
-	// Build view projection matrix relative to eye
-	const omath::dmat4 view{
-		omath::lookAt( cam->get_position(), cam->get_position() + omath::dvec3{cam->get_front()}, omath::dvec3{cam->get_up()} )
-	};
-	// Identity matrix as model matrix so far
-	const omath::dmat4 mv{ view * omath::dmat4{ 1.0 } };
-	// this matrix can be used for all objects in same coord system
-	const omath::mat4 mvRTE{
-		omath::vec4{mv[0]}, omath::vec4{mv[1]}, omath::vec4{mv[2]}, omath::vec4{ 0.0f, 0.0f, 0.0f, static_cast<float>(mv[3][3]) }
-	};
-	orf_n::setModelViewProjectionMatrixRTE( cam->get_perspective_matrix() * mvRTE );
-	orf_n::setViewProjectionMatrix( cam->get_view_perspective__matrix() );
-	orf_n::set_uniform( m_shaderTerrain->getProgram(), "debugColor", orf_n::color::gray );
-	orf_n::setCameraPosition( cam->get_position() );
+	{
+		orf_n::profiler::scoped_zone zone{ "Terrain uniform setup" };
+		m_drawGridMesh->bind();
+		m_renderStats.reset();
+		m_shaderTerrain->use();
+		if( refreshUniforms )
+			orf_n::set_uniform( m_shaderTerrain->getProgram(), "g_diffuseLightDir", m_diffuseLightPos );
+		// Build view projection matrix relative to eye
+		const omath::dmat4 view{
+			omath::lookAt( cam->get_position(), cam->get_position() + omath::dvec3{cam->get_front()}, omath::dvec3{cam->get_up()} )
+		};
+		// Identity matrix as model matrix so far
+		const omath::dmat4 mv{ view * omath::dmat4{ 1.0 } };
+		// this matrix can be used for all objects in same coord system
+		const omath::mat4 mvRTE{
+			omath::vec4{mv[0]}, omath::vec4{mv[1]}, omath::vec4{mv[2]}, omath::vec4{ 0.0f, 0.0f, 0.0f, static_cast<float>(mv[3][3]) }
+		};
+		orf_n::setModelViewProjectionMatrixRTE( cam->get_perspective_matrix() * mvRTE );
+		orf_n::setViewProjectionMatrix( cam->get_view_perspective__matrix() );
+		orf_n::set_uniform( m_shaderTerrain->getProgram(), "debugColor", orf_n::color::gray );
+		orf_n::setCameraPosition( cam->get_position() );
+	}
 	// Draw tile by tile
+	orf_n::profiler::scoped_zone zone{ "Terrain draw", true };
 	GLint drawMode{ cam->get_wireframe_mode() ? GL_LINES : GL_TRIANGLES };
 	for( size_t i{0}; i < m_terrainTiles.size(); ++i ) {
 		// set tile world coords
@@ -245,9 +248,11 @@ bool TerrainLOD::refreshUI() {
 		ImGui::Checkbox( "  in viewfrustum", &m_showLowestLevelBoxes );
 		ImGui::Checkbox( "  LOD selected", &m_showSelectedBoxes );
 		ImGui::Checkbox( "Show lod", &m_drawSelection );
+		ImGui::Checkbox( "Horizon occlusion culling", &m_lodSelection->m_occlusionCulling );
 		ImGui::Separator();
 		ImGui::Text( "Render stats" );
 		ImGui::Text( "# selected nodes %d", m_lodSelection->m_selectionCount );
+		ImGui::Text( "# occluded nodes %d", m_lodSelection->m_occludedCount );
 		ImGui::Text( "# rendered nodes %d", m_renderStats.totalRenderedNodes );
 		ImGui::Text( "# rendered triangles %d", m_renderStats.totalRenderedTriangles );
 		ImGui::Text( "min selected LOD level %d", m_lodSelection->m_minSelectedLODLevel );
@@ -16,11 +16,14 @@
 
 namespace terrain {
 
-TerrainTile::TerrainTile( const std::string &filename ) :
+TerrainTile::TerrainTile( const std::string &filename, const bool upload ) :
 		m_filename{filename} {
 	// Load the heightmap and tile relative and world min/max coords for the bounding boxes
 	// @todo: check if size == terrain::TILE_SIZE !
-	m_heightMap = std::make_unique<heightmap>( filename + ".png", terrain::heightmap::B16 );
+	// Prefer the engine's binary tile format, it needs no decoding
+	const bool hasTileFile{ std::ifstream{ filename + ".tile", std::ios::in | std::ios::binary }.is_open() };
+	m_heightMap = std::make_unique<heightmap>( filename + ( hasTileFile ? ".tile" : ".png" ),
+			terrain::heightmap::B16, upload );
 	std::ifstream bbf{ filename + ".bb", std::ios::in };
 	if( !bbf.is_open() ) {
 		std::ostringstream s;
@@ -57,6 +60,12 @@ const terrain::quad_tree *TerrainTile::getQuadTree() const {
 	return m_quadTree.get();
 }
 
+void TerrainTile::updateHeights( const int x, const int z, const int w, const int h, const float *const values ) {
+	const omath::ivec4 dirty{ m_heightMap->updateArea( x, z, w, h, values ) };
+	if( dirty.z > 0 && dirty.w > 0 )
+		m_quadTree->refit( dirty.x, dirty.y, dirty.z, dirty.w );
+}
+
 const orf_n::aabb *TerrainTile::getAABB() const {
 	return m_AABB.get();
 }
@@ -25,8 +25,9 @@ public:
 	 * Pathname of the tile heightmap
 	 * Ellispoid is used to calculate world cartesian positions of posts from lower left corner
 	 * and anular distance between posts. Positions are stored as high/low floats in two textures.
+	 * Without upload the heightmap stays cpu side only, e.g. for headless benchmarks.
 	 */
-	TerrainTile( const std::string &filename );
+	TerrainTile( const std::string &filename, const bool upload = true );
 
 	TerrainTile( const TerrainTile &other ) = delete;
 
@@ -42,6 +43,13 @@ public:
 
 	const quad_tree *getQuadTree() const;
 
+	/**
+	 * Edit heights in place, e.g. with erosion results, craters or flattening.
+	 * Values are normalized (0..1), row major with w*h samples, x/z in heightmap posts.
+	 * Only the sub rectangle is uploaded and only the nodes covering it are refitted.
+	 */
+	void updateHeights( const int x, const int z, const int w, const int h, const float *const values );
+
 	// Returns the bounding box relative to heightmap in flat coords
 	// @todo: this will have to give way to the cartesian bb
 	const orf_n::aabb *getAABB() const;
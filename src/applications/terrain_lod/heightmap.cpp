@@ -1,7 +1,10 @@
 
 #include <applications/terrain_lod/heightmap.h>
+#include <applications/terrain_lod/tile_file.h>
 #include <base/logbook.h>
 #include <renderer/sampler.h>
+#include <cstring>
+#include <fstream>
 #include <iostream>
 #include <sstream>
 #include "stb/stb_image.h"
@@ -12,22 +15,29 @@ namespace terrain {
 
 /**
  * Create anew height map texture from file.
- * @param fielname Filename of the texture file. Supported format single channel 16bit png.
+ * @param fielname Filename of the texture file. Supported formats single channel 16bit png
+ * and the engine's .tile format (always 16 bit).
  * Use asc2png.cpp to create height map textures from srtm data.
  * For the shader: heightmap texture is bound to texture unit 0, high positions texture to unit 1,
  * low positions to unit 2.
  */
-heightmap::heightmap( const std::string &filename, const bitDepth_t depth ) :
+heightmap::heightmap( const std::string &filename, const bitDepth_t depth, const bool upload ) :
 				m_filename{ filename }, m_bitDepth{ depth } {
 
 	uint16_t *heightValues16{nullptr};
 	uint8_t *heightValues8{nullptr};
+	std::vector<uint16_t> tileValues;
 	//stbi_set_flip_vertically_on_load( true );
 	int w, h, numChannels;
-	if( B16 == depth )
+	if( isTileFile( m_filename ) ) {
+		// The engine's own format is always single channel 16 bit
+		if( readTileFile( m_filename, tileValues, w, h ) )
+			heightValues16 = tileValues.data();
+		numChannels = 1;
+	} else if( B16 == depth )
 		// load the data, single channel 16
 		heightValues16 = stbi_load_16( m_filename.c_str(), &w, &h, &numChannels, 1 );
-	if( B8 == depth ) {
+	if( B8 == depth && !isTileFile( m_filename ) ) {
 		// load the data, single channel 8
 		heightValues8 = stbi_load( m_filename.c_str(), &w, &h, &numChannels, 1 );
 	}
@@ -67,20 +77,22 @@ heightmap::heightmap( const std::string &filename, const bitDepth_t depth ) :
 	}
 
 	// There's only float data 0..1 from now on
-	glCreateTextures( GL_TEXTURE_2D, 1, &m_texture );
-	// no mip levels
-	glTextureStorage2D( m_texture, 1, GL_R32F, m_extent.x, m_extent.y );
-	glTextureSubImage2D( m_texture, 0,		// texture and mip level
-			0, 0, m_extent.x, m_extent.y,	// offset and size
-			GL_RED, GL_FLOAT, m_heightValuesNormalized );
-	glBindTextureUnit( HEIGHTMAP_TEXTURE_UNIT, m_texture );
-	// set the default sampler for the heightmap texture
-	set_default_sampler( m_texture, LINEAR_CLAMP );
+	if( upload ) {
+		glCreateTextures( GL_TEXTURE_2D, 1, &m_texture );
+		// no mip levels
+		glTextureStorage2D( m_texture, 1, GL_R32F, m_extent.x, m_extent.y );
+		glTextureSubImage2D( m_texture, 0,		// texture and mip level
+				0, 0, m_extent.x, m_extent.y,	// offset and size
+				GL_RED, GL_FLOAT, m_heightValuesNormalized );
+		glBindTextureUnit( HEIGHTMAP_TEXTURE_UNIT, m_texture );
+		// set the default sampler for the heightmap texture
+		set_default_sampler( m_texture, LINEAR_CLAMP );
+	}
 
 	// release mem
 	if( nullptr != heightValues8 )
 		stbi_image_free( heightValues8 );
-	if( nullptr != heightValues16 )
+	if( nullptr != heightValues16 && tileValues.empty() )
 		stbi_image_free( heightValues16 );
 
 	// @todo: query texture size !
@@ -94,10 +106,43 @@ heightmap::heightmap( const std::string &filename, const bitDepth_t depth ) :
 	logbook::log_msg( logbook::TERRAIN, logbook::INFO, s.str() );
 }
 
+// static
+bool heightmap::isTileFile( const std::string &filename ) {
+	const std::string extension{ ".tile" };
+	return filename.size() > extension.size() &&
+			0 == filename.compare( filename.size() - extension.size(), extension.size(), extension );
+}
+
+// static
+bool heightmap::readTileFile( const std::string &filename, std::vector<uint16_t> &values, int &width, int &height ) {
+	std::ifstream file{ filename, std::ios::in | std::ios::binary };
+	tileFileHeader_t header;
+	if( !file.is_open() || !file.read( reinterpret_cast<char *>( &header ), sizeof( header ) ) ||
+			0 != std::memcmp( header.magic, TILE_FILE_MAGIC, sizeof( TILE_FILE_MAGIC ) ) ||
+			TILE_FILE_VERSION != header.version ) {
+		logbook::log_msg( logbook::TERRAIN, logbook::ERROR, "'" + filename + "' is not a height tile file." );
+		return false;
+	}
+	// Little endian as written by the converter, like the hosts we run on
+	values.resize( (size_t)header.width * header.height );
+	if( !file.read( reinterpret_cast<char *>( values.data() ), values.size() * sizeof( uint16_t ) ) ) {
+		logbook::log_msg( logbook::TERRAIN, logbook::ERROR, "Height tile file '" + filename + "' is truncated." );
+		values.clear();
+		return false;
+	}
+	width = static_cast<int>( header.width );
+	height = static_cast<int>( header.height );
+	return true;
+}
+
 const omath::vec2 &heightmap::getMinMaxHeight() const {
 	return m_minMaxHeightValues;
 }
 
+size_t heightmap::getSizeInMemory() const {
+	return static_cast<size_t>( m_extent.x ) * static_cast<size_t>( m_extent.y ) * sizeof( float );
+}
+
 const GLuint &heightmap::getTexture() const {
 	return m_texture;
 }
@@ -124,13 +169,63 @@ omath::vec2 heightmap::getMinMaxHeightArea( const int x, const int z, const int
 	return omath::vec2{ values };
 }
 
+omath::ivec4 heightmap::updateArea( const int x, const int z, const int w, const int h, const float *const values ) {
+	// Clip to the extent but keep the source rectangle's row length for addressing values
+	const int x0{ std::max( x, 0 ) };
+	const int z0{ std::max( z, 0 ) };
+	const int x1{ std::min( x + w, m_extent.x ) };
+	const int z1{ std::min( z + h, m_extent.y ) };
+	if( nullptr == values || x0 >= x1 || z0 >= z1 )
+		return omath::ivec4{ 0, 0, 0, 0 };
+	// Min/max are kept in the range of the source data, see ctor. If an old extreme is overwritten
+	// the range may shrink, then the whole cpu copy is rescanned.
+	const float depthFactor{ B8 == m_bitDepth ? 255.0f : 65535.0f };
+	omath::vec2 minMax{ m_minMaxHeightValues };
+	bool extremeOverwritten{ false };
+	for( int j{ z0 }; j < z1; ++j ) {
+		const float *src{ &values[( x0 - x ) + ( j - z ) * w] };
+		float *dst{ &m_heightValuesNormalized[x0 + j * m_extent.x] };
+		for( int i{ 0 }; i < x1 - x0; ++i ) {
+			const float old{ dst[i] * depthFactor };
+			// Half a step of slack against rounding of the normalized values
+			extremeOverwritten = extremeOverwritten ||
+					old <= m_minMaxHeightValues.x + 0.5f || old >= m_minMaxHeightValues.y - 0.5f;
+			const float v{ omath::clamp( src[i], 0.0f, 1.0f ) };
+			dst[i] = v;
+			minMax.x = std::min( minMax.x, v * depthFactor );
+			minMax.y = std::max( minMax.y, v * depthFactor );
+		}
+	}
+	if( extremeOverwritten ) {
+		const int numPixels{ m_extent.x * m_extent.y };
+		minMax = omath::vec2{ std::numeric_limits<float>::max(), std::numeric_limits<float>::lowest() };
+		for( int i{ 0 }; i < numPixels; ++i ) {
+			minMax.x = std::min( minMax.x, m_heightValuesNormalized[i] * depthFactor );
+			minMax.y = std::max( minMax.y, m_heightValuesNormalized[i] * depthFactor );
+		}
+	}
+	m_minMaxHeightValues = minMax;
+	const omath::ivec4 dirty{ x0, z0, x1 - x0, z1 - z0 };
+	if( 0 == m_texture )
+		return dirty;
+	// Upload straight from the cpu copy, the unpack row length skips the rest of each row
+	glPixelStorei( GL_UNPACK_ROW_LENGTH, m_extent.x );
+	glTextureSubImage2D( m_texture, 0,			// texture and mip level
+			x0, z0, x1 - x0, z1 - z0,			// offset and size
+			GL_RED, GL_FLOAT, &m_heightValuesNormalized[x0 + z0 * m_extent.x] );
+	glPixelStorei( GL_UNPACK_ROW_LENGTH, 0 );
+	return dirty;
+}
+
 const heightmap::bitDepth_t &heightmap::getDepth() const {
 	return m_bitDepth;
 }
 
 heightmap::~heightmap() {
-	unbind();
-	glDeleteTextures( 1, &m_texture );
+	if( 0 != m_texture ) {
+		unbind();
+		glDeleteTextures( 1, &m_texture );
+	}
 	delete [] m_heightValuesNormalized;
 	logbook::log_msg( logbook::TERRAIN, logbook::INFO,
 			"Heightmap '" + m_filename + "' destroyed." );
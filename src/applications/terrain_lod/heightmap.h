@@ -4,7 +4,9 @@
 #include <renderer/texture_2d.h>
 #include "geometry/Rectangle.h"
 #include "omath/vec2.h"
+#include "omath/vec4.h"
 #include <string>
+#include <vector>
 
 namespace terrain {
 
@@ -28,8 +30,9 @@ public:
 	/**
 	 * Create Heightmap object with VertexArray and IndexBuffer from file.
 	 * Apply an factor to the height values, usually to have smaller numbers.
+	 * Without upload only the cpu copy is created, no texture (headless use, no gl context needed).
 	 */
-	heightmap( const std::string &filename, const bitDepth_t depth = B16 );
+	heightmap( const std::string &filename, const bitDepth_t depth = B16, const bool upload = true );
 
 	virtual ~heightmap();
 
@@ -48,6 +51,20 @@ public:
 
 	const omath::vec2 &getMinMaxHeight() const;
 
+	/**
+	 * Size of the cpu copy of the height values in bytes.
+	 */
+	size_t getSizeInMemory() const;
+
+	/**
+	 * Patches a rectangle of normalized (0..1) height values, row major with w*h samples,
+	 * into the cpu copy and uploads only that sub rectangle to the texture.
+	 * The rectangle is clipped to the extent, overall min/max heights are kept exact.
+	 * Returns the clipped dirty rectangle as x/z/w/h, w and h are 0 if nothing is left.
+	 * Quad tree bounds are not touched, callers must refit the dirty rectangle, see quad_tree::refit().
+	 */
+	omath::ivec4 updateArea( const int x, const int z, const int w, const int h, const float *const values );
+
 private:
 	std::string m_filename{ "" };
 
@@ -56,6 +73,7 @@ private:
 	 */
 	float *m_heightValuesNormalized{ nullptr };
 
+	// Stays 0 if the heightmap was loaded without upload
 	GLuint m_texture{ 0 };
 
 	/**
@@ -81,6 +99,13 @@ private:
 
 	const bitDepth_t &getDepth() const;
 
+	static bool isTileFile( const std::string &filename );
+
+	/**
+	 * Read the heights of a binary .tile file written by the converter.
+	 */
+	static bool readTileFile( const std::string &filename, std::vector<uint16_t> &values, int &width, int &height );
+
 };
 
 }
@@ -0,0 +1,97 @@
+#include "horizon.h"
+#include <algorithm>
+
+namespace terrain {
+
+horizon::horizon() {
+	std::fill( m_heights, m_heights + HORIZON_BUFFER_WIDTH, -1.0f );
+}
+
+horizon::~horizon() {}
+
+void horizon::reset( const omath::mat4 &viewPerspective ) {
+	for( int c{ 0 }; c < 4; ++c ) {
+		m_rowX[c] = viewPerspective[c][0];
+		m_rowY[c] = viewPerspective[c][1];
+		m_rowW[c] = viewPerspective[c][3];
+	}
+	std::fill( m_heights, m_heights + HORIZON_BUFFER_WIDTH, -1.0f );
+}
+
+bool horizon::project( const omath::vec3 &point, omath::vec2 &ndc ) const {
+	const float w{ m_rowW[0] * point.x + m_rowW[1] * point.y + m_rowW[2] * point.z + m_rowW[3] };
+	// Points near or behind the eye have no meaningful screen position
+	if( w <= 1e-3f )
+		return false;
+	const float oneOverW{ 1.0f / w };
+	ndc.x = ( m_rowX[0] * point.x + m_rowX[1] * point.y + m_rowX[2] * point.z + m_rowX[3] ) * oneOverW;
+	ndc.y = ( m_rowY[0] * point.x + m_rowY[1] * point.y + m_rowY[2] * point.z + m_rowY[3] ) * oneOverW;
+	return true;
+}
+
+bool horizon::isOccluded( const orf_n::aabb &box ) const {
+	float minX{ std::numeric_limits<float>::max() };
+	float maxX{ std::numeric_limits<float>::lowest() };
+	float maxY{ std::numeric_limits<float>::lowest() };
+	for( int i{ 0 }; i < 8; ++i ) {
+		const omath::vec3 corner{
+			i & 1 ? box.m_max.x : box.m_min.x,
+			i & 2 ? box.m_max.y : box.m_min.y,
+			i & 4 ? box.m_max.z : box.m_min.z
+		};
+		omath::vec2 ndc;
+		if( !project( corner, ndc ) )
+			return false;
+		minX = std::min( minX, ndc.x );
+		maxX = std::max( maxX, ndc.x );
+		maxY = std::max( maxY, ndc.y );
+	}
+	// Every column the box touches must be above its top
+	const float w{ static_cast<float>( HORIZON_BUFFER_WIDTH ) };
+	const int first{ std::max( 0, static_cast<int>( std::floor( ( minX + 1.0f ) * 0.5f * w ) ) ) };
+	const int last{ std::min( HORIZON_BUFFER_WIDTH - 1, static_cast<int>( std::floor( ( maxX + 1.0f ) * 0.5f * w ) ) ) };
+	if( first > last )
+		return false;
+	for( int c{ first }; c <= last; ++c )
+		if( m_heights[c] < maxY )
+			return false;
+	return true;
+}
+
+void horizon::addOccluder( const orf_n::aabb &box ) {
+	float minX{ std::numeric_limits<float>::max() };
+	float maxX{ std::numeric_limits<float>::lowest() };
+	float minY{ std::numeric_limits<float>::max() };
+	for( int i{ 0 }; i < 4; ++i ) {
+		const omath::vec3 corner{
+			i & 1 ? box.m_max.x : box.m_min.x, box.m_min.y, i & 2 ? box.m_max.z : box.m_min.z
+		};
+		omath::vec2 ndc;
+		if( !project( corner, ndc ) )
+			return;
+		minX = std::min( minX, ndc.x );
+		maxX = std::max( maxX, ndc.x );
+		minY = std::min( minY, ndc.y );
+	}
+	// Only columns completely covered by the footprint are raised
+	const float w{ static_cast<float>( HORIZON_BUFFER_WIDTH ) };
+	const int first{ std::max( 0, static_cast<int>( std::ceil( ( minX + 1.0f ) * 0.5f * w ) ) ) };
+	const int last{ std::min( HORIZON_BUFFER_WIDTH, static_cast<int>( std::floor( ( maxX + 1.0f ) * 0.5f * w ) ) ) };
+	for( int c{ first }; c < last; ++c )
+		m_heights[c] = std::max( m_heights[c], minY );
+}
+
+float horizon::nearestDepth( const orf_n::aabb &box ) const {
+	// Depth is linear, its minimum is at the corner on the near side of each axis
+	return m_rowW[0] * ( m_rowW[0] > 0.0f ? box.m_min.x : box.m_max.x ) +
+		   m_rowW[1] * ( m_rowW[1] > 0.0f ? box.m_min.y : box.m_max.y ) +
+		   m_rowW[2] * ( m_rowW[2] > 0.0f ? box.m_min.z : box.m_max.z ) + m_rowW[3];
+}
+
+float horizon::farthestDepth( const orf_n::aabb &box ) const {
+	return m_rowW[0] * ( m_rowW[0] > 0.0f ? box.m_max.x : box.m_min.x ) +
+		   m_rowW[1] * ( m_rowW[1] > 0.0f ? box.m_max.y : box.m_min.y ) +
+		   m_rowW[2] * ( m_rowW[2] > 0.0f ? box.m_max.z : box.m_min.z ) + m_rowW[3];
+}
+
+}
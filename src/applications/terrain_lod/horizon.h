@@ -0,0 +1,70 @@
+/**
+ * One dimensional screen space horizon for occlusion culling of terrain nodes.
+ * A box may only be added once every node in front of its farthest depth has been tested.
+ * Everything below the horizon in a screen column is assumed to be hidden behind
+ * terrain that has been added before.
+ */
+
+#pragma once
+
+#include "settings.h"
+#include "geometry/aabb.h"
+#include "omath/mat4.h"
+
+namespace terrain {
+
+class horizon {
+public:
+	horizon();
+
+	virtual ~horizon();
+
+	/**
+	 * Lowers the horizon to the bottom of the screen. Must be called every frame
+	 * with the camera's current view perspective matrix.
+	 */
+	void reset( const omath::mat4 &viewPerspective );
+
+	/**
+	 * True if the box projects completely below the horizon.
+	 * Boxes reaching behind the camera are never occluded.
+	 */
+	bool isOccluded( const orf_n::aabb &box ) const;
+
+	/**
+	 * Raises the horizon with the box's footprint at its minimum height.
+	 * Terrain inside the box is never lower than that, so the occluder is conservative.
+	 */
+	void addOccluder( const orf_n::aabb &box );
+
+	/**
+	 * Smallest and largest view depth, clip space w, of the box's corners. A box inside another
+	 * is never nearer. A box can only be hidden by occluders whose farthest depth is at most
+	 * its nearest depth.
+	 */
+	float nearestDepth( const orf_n::aabb &box ) const;
+
+	float farthestDepth( const orf_n::aabb &box ) const;
+
+private:
+	/**
+	 * Rows of the view perspective matrix that give clip space x, y and w.
+	 * Plain arrays because this is called for every visited node.
+	 */
+	float m_rowX[4]{ 1.0f, 0.0f, 0.0f, 0.0f };
+	float m_rowY[4]{ 0.0f, 1.0f, 0.0f, 0.0f };
+	float m_rowW[4]{ 0.0f, 0.0f, 0.0f, 1.0f };
+
+	/**
+	 * Horizon height per screen column in normalized device coords, -1 is the bottom of the screen.
+	 */
+	float m_heights[HORIZON_BUFFER_WIDTH];
+
+	/**
+	 * Projects a world point. Returns false if it lies on or behind the camera plane.
+	 */
+	bool project( const omath::vec3 &point, omath::vec2 &ndc ) const;
+
+};
+
+}
@@ -7,6 +7,8 @@
 #include "base/logbook.h"
 #include "geometry/aabb.h"
 #include "geometry/view_frustum.h"
+#include <algorithm>
+#include <limits>
 #include <sstream>
 
 namespace terrain {
@@ -100,6 +102,28 @@ bool node::isLeaf() const {
 	return m_isLeaf;
 }
 
+void node::refit( const int x, const int z, const int w, const int h, const heightmap *const heightMap ) {
+	// Nodes share their border posts with their neighbours, hence the inclusive test
+	if( x > m_x + m_size || x + w - 1 < m_x || z > m_z + m_size || z + h - 1 < m_z )
+		return;
+	if( m_isLeaf ) {
+		const int limitX = std::min( heightMap->getExtent().x, m_x + m_size + 1 );
+		const int limitZ = std::min( heightMap->getExtent().y, m_z + m_size + 1 );
+		m_minMaxHeight = heightMap->getMinMaxHeightArea( m_x, m_z, limitX - m_x, limitZ - m_z );
+	} else {
+		m_minMaxHeight = omath::vec2{ std::numeric_limits<float>::max(), std::numeric_limits<float>::lowest() };
+		node *subNodes[]{ m_subTL, m_subTR, m_subBL, m_subBR };
+		for( node *n : subNodes )
+			if( n != nullptr ) {
+				n->refit( x, z, w, h, heightMap );
+				m_minMaxHeight.x = std::min( m_minMaxHeight.x, n->m_minMaxHeight.x );
+				m_minMaxHeight.y = std::max( m_minMaxHeight.y, n->m_minMaxHeight.y );
+			}
+	}
+	m_boundingBox->m_min.y = m_minMaxHeight.x;
+	m_boundingBox->m_max.y = m_minMaxHeight.y;
+}
+
 orf_n::intersect_t node::lodSelect( LODSelection *lodSelection, bool parentCompletelyInFrustum ) {
 	// Shortcut
 	const orf_n::camera *cam{ lodSelection->m_camera };
@@ -107,31 +131,58 @@ orf_n::intersect_t node::lodSelect( LODSelection *lodSelection, bool parentCompl
 	orf_n::view_frustum f = cam->get_view_frustum();
 	orf_n::intersect_t frustumIntersection = parentCompletelyInFrustum ?
 			orf_n::INSIDE : cam->get_view_frustum().is_box_in_frustum( *m_boundingBox );
-	if( orf_n::OUTSIDE == frustumIntersection )
+	if( orf_n::OUTSIDE == frustumIntersection ) {
+		++lodSelection->m_culledCount;
 		return orf_n::OUTSIDE;
+	}
 	float distanceLimit = lodSelection->m_visibilityRanges[m_level];
 	if( !m_boundingBox->intersect_sphere_sq( cam->get_position(), distanceLimit * distanceLimit ) )
 		return orf_n::OUT_OF_RANGE;
 
-	orf_n::intersect_t subTLSelRes = orf_n::UNDEFINED;
-	orf_n::intersect_t subTRSelRes = orf_n::UNDEFINED;
-	orf_n::intersect_t subBLSelRes = orf_n::UNDEFINED;
-	orf_n::intersect_t subBRSelRes = orf_n::UNDEFINED;
+	// Whole subtree hidden behind terrain selected before ?
+	if( lodSelection->m_occlusionCulling && lodSelection->isOccluded( *m_boundingBox,
+			lodSelection->m_horizon.nearestDepth( *m_boundingBox ) ) ) {
+		++lodSelection->m_occludedCount;
+		return orf_n::OUTSIDE;
+	}
+
+	node *subNodes[4]{ m_subTL, m_subTR, m_subBL, m_subBR };
+	orf_n::intersect_t subSelRes[4]{ orf_n::UNDEFINED, orf_n::UNDEFINED, orf_n::UNDEFINED, orf_n::UNDEFINED };
 	// Stop at one below number of lod levels
 	if( m_level != lodSelection->m_stopAtLevel ) {
 		float nextDistanceLimit = lodSelection->m_visibilityRanges[m_level+1];
 		if( m_boundingBox->intersect_sphere_sq( cam->get_position(), nextDistanceLimit * nextDistanceLimit ) ) {
 			bool weAreCompletelyInFrustum = frustumIntersection == orf_n::INSIDE;
-			if( m_subTL != nullptr )
-				subTLSelRes = m_subTL->lodSelect( lodSelection, weAreCompletelyInFrustum );
-			if( m_subTR != nullptr )
-				subTRSelRes = m_subTR->lodSelect( lodSelection, weAreCompletelyInFrustum );
-			if( m_subBL != nullptr )
-				subBLSelRes = m_subBL->lodSelect( lodSelection, weAreCompletelyInFrustum );
-			if( m_subBR != nullptr )
-				subBRSelRes = m_subBR->lodSelect( lodSelection, weAreCompletelyInFrustum );
+			// The horizon needs the sub nodes front to back
+			int order[4]{ 0, 1, 2, 3 };
+			float depths[4];
+			if( lodSelection->m_occlusionCulling ) {
+				for( int i{ 0 }; i < 4; ++i )
+					depths[i] = subNodes[i] != nullptr ?
+						lodSelection->m_horizon.nearestDepth( *subNodes[i]->m_boundingBox ) :
+						std::numeric_limits<float>::max();
+				std::sort( order, order + 4, [&depths]( const int a, const int b ) {
+					return depths[a] < depths[b];
+				} );
+				lodSelection->m_untested.push_back( std::numeric_limits<float>::max() );
+			}
+			for( int k{ 0 }; k < 4; ++k ) {
+				const int i{ order[k] };
+				if( subNodes[i] == nullptr )
+					continue;
+				// Siblings not visited yet bound what may be drawn into the horizon
+				if( lodSelection->m_occlusionCulling )
+					lodSelection->m_untested.back() = k < 3 ? depths[order[k + 1]] : std::numeric_limits<float>::max();
+				subSelRes[i] = subNodes[i]->lodSelect( lodSelection, weAreCompletelyInFrustum );
+			}
+			if( lodSelection->m_occlusionCulling )
+				lodSelection->m_untested.pop_back();
 		}
 	}
+	const orf_n::intersect_t subTLSelRes{ subSelRes[0] };
+	const orf_n::intersect_t subTRSelRes{ subSelRes[1] };
+	const orf_n::intersect_t subBLSelRes{ subSelRes[2] };
+	const orf_n::intersect_t subBRSelRes{ subSelRes[3] };
 
 	// We don't want to select sub nodes that are invisible (out of frustum) or are selected;
 	// (we DO want to select if they are out of range, since we are not)
@@ -163,6 +214,17 @@ orf_n::intersect_t node::lodSelect( LODSelection *lodSelection, bool parentCompl
 					std::sqrt( lodSelection->m_selectedNodes[lodSelection->m_selectionCount].
 					p_node->getBoundingBox()->min_distance_from_point_sq( cam->get_position() ) );
 		lodSelection->m_selectionCount++;
+		// What is drawn now hides farther terrain once everything nearer has been tested
+		if( lodSelection->m_occlusionCulling ) {
+			if( !( removeSubTL || removeSubTR || removeSubBL || removeSubBR ) )
+				lodSelection->addOccluder( m_boundingBox );
+			else {
+				const bool drawn[4]{ !removeSubTL, !removeSubTR, !removeSubBL, !removeSubBR };
+				for( int i{ 0 }; i < 4; ++i )
+					if( drawn[i] && subNodes[i] != nullptr )
+						lodSelection->addOccluder( subNodes[i]->m_boundingBox );
+			}
+		}
 		return orf_n::SELECTED;
 	}
 	// if any of child nodes are selected, then return selected -
@@ -36,6 +36,13 @@ public:
 
     orf_n::intersect_t lodSelect( LODSelection *lodSelection, bool parentCompletelyInFrustum = false );
 
+    /**
+     * Recalculates min/max heights of this node and its sub nodes that overlap the
+     * heightmap rectangle x/z/w/h. Leaves read the heightmap, the others are
+     * refitted from their sub nodes on the way back up.
+     */
+    void refit( const int x, const int z, const int w, const int h, const heightmap *const heightMap );
+
     const node *getUpperRight() const;
 
     const node *getUpperLeft() const;
@@ -68,7 +75,7 @@ private:
     node *m_subBL{ nullptr };
     node *m_subBR{ nullptr };
 
-    const orf_n::aabb* m_boundingBox{ nullptr };
+    orf_n::aabb* m_boundingBox{ nullptr };
 
 };
 
@@ -3,7 +3,10 @@
 #include <applications/terrain_lod/quadtree.h>
 #include <applications/terrain_lod/TerrainTile.h>
 #include <base/logbook.h>
+#include <algorithm>
+#include <limits>
 #include <sstream>
+#include <vector>
 
 namespace terrain {
 
@@ -93,10 +96,41 @@ int quad_tree::getNodeCount() const {
 	return m_nodeCount;
 }
 
+size_t quad_tree::getSizeInMemory() const {
+	return static_cast<size_t>( m_nodeCount ) * ( sizeof( node ) + sizeof( orf_n::aabb ) );
+}
+
 void quad_tree::lodSelect( LODSelection *lodSelection ) const {
+	if( !lodSelection->m_occlusionCulling ) {
+		for( int z{ 0 }; z < m_topNodeCountZ; ++z )
+			for( int x{ 0 }; x < m_topNodeCountX; ++x )
+				m_topLevelNodes[z][x]->lodSelect( lodSelection, false );
+		return;
+	}
+	// Horizon culling needs the top level nodes front to back
+	std::vector<std::pair<float, node *>> topNodes;
+	topNodes.reserve( m_topNodeCountX * m_topNodeCountZ );
 	for( int z{ 0 }; z < m_topNodeCountZ; ++z )
 		for( int x{ 0 }; x < m_topNodeCountX; ++x )
-			m_topLevelNodes[z][x]->lodSelect( lodSelection, false );
+			topNodes.push_back( { lodSelection->m_horizon.nearestDepth( *m_topLevelNodes[z][x]->getBoundingBox() ),
+								  m_topLevelNodes[z][x] } );
+	std::sort( topNodes.begin(), topNodes.end(),
+			[]( const std::pair<float, node *> &a, const std::pair<float, node *> &b ) {
+		return a.first < b.first;
+	} );
+	lodSelection->m_untested.push_back( std::numeric_limits<float>::max() );
+	for( size_t k{ 0 }; k < topNodes.size(); ++k ) {
+		lodSelection->m_untested.back() = k + 1 < topNodes.size() ?
+				topNodes[k + 1].first : std::numeric_limits<float>::max();
+		topNodes[k].second->lodSelect( lodSelection, false );
+	}
+	lodSelection->m_untested.pop_back();
+}
+
+void quad_tree::refit( const int x, const int z, const int w, const int h ) {
+	for( int j{ 0 }; j < m_topNodeCountZ; ++j )
+		for( int i{ 0 }; i < m_topNodeCountX; ++i )
+			m_topLevelNodes[j][i]->refit( x, z, w, h, m_terrainTile->getHeightMap() );
 }
 
 }
@@ -22,9 +22,20 @@ public:
 
 	int getNodeCount() const;
 
+	/**
+	 * Size of nodes and their bounding boxes in bytes.
+	 */
+	size_t getSizeInMemory() const;
+
 	// tile index is saved in selection list for sorting by tile and distance
 	void lodSelect( LODSelection *lodSelectlion ) const;
 
+	/**
+	 * Refits min/max heights of all nodes covering the heightmap rectangle x/z/w/h
+	 * after the heightmap has been changed there. Nodes outside are not visited.
+	 */
+	void refit( const int x, const int z, const int w, const int h );
+
 private:
 	int m_rasterSizeX{ 0 };
 
@@ -45,6 +45,9 @@ static const int RENDER_GRID_RESULUTION_MULT{ 8 };
 
 static const float HEIGHT_FACTOR{2.0f};
 
+// Number of screen columns of the horizon used for occlusion culling of nodes
+static const int HORIZON_BUFFER_WIDTH{ 512 };
+
 static const int GRIDMESH_DIMENSION{ LEAF_NODE_SIZE * RENDER_GRID_RESULUTION_MULT };
 
 static const bool SHADOW_MAP_HIGH_QUALITY{false};
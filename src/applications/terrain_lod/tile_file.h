@@ -0,0 +1,34 @@
+
+/**
+ * The engine's binary height tile format, written by the converter in utils.
+ * A fixed header followed by width * height 16 bit heights, row major, little endian.
+ * Heights can be used as they are, without decoding.
+ */
+
+#pragma once
+
+#include <cstdint>
+
+namespace terrain {
+
+struct tileFileHeader_t {
+	char magic[8];
+	uint32_t version;
+	uint32_t width;
+	uint32_t height;
+	// Minimum and maximum height value of the tile
+	uint16_t minValue;
+	uint16_t maxValue;
+	// Geodetic lower left and distance between posts, as in the .bb file
+	double llLong;
+	double llLat;
+	double cellsize;
+};
+
+static_assert( sizeof( tileFileHeader_t ) == 48, "Tile file header must not be padded" );
+
+constexpr char TILE_FILE_MAGIC[8]{ 'O', 'R', 'F', 'N', 'T', 'I', 'L', 'E' };
+
+constexpr uint32_t TILE_FILE_VERSION{ 1 };
+
+}
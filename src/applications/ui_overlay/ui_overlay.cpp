@@ -2,6 +2,7 @@
 #include <applications/camera/camera.h>	// near- and far plane
 #include "base/globals.h"
 #include <base/logbook.h>
+#include <base/profiler.h>
 #include <renderer/texture_2d.h>
 #include <renderer/uniform.h>
 #include <scene/scene.h>
@@ -164,6 +165,7 @@ void ui_overlay::render() {
 	ImGui::SliderFloat( "UI alpha", &style.Alpha, 0.3f, 1.0f );
 	ImGui::Separator();
 	ImGui::Checkbox( "Show App UI", &globals::show_app_ui );
+	profilerUI();
 	ImGui::End();
 	ImGui::Render();
 
@@ -319,4 +321,35 @@ bool ui_overlay::on_char( unsigned int code ) {
 	return false;
 }
 
+void ui_overlay::profilerUI() {
+	if( !ImGui::CollapsingHeader( "Profiler" ) )
+		return;
+	bool enabled{ profiler::is_enabled() };
+	if( ImGui::Checkbox( "Enabled", &enabled ) )
+		profiler::set_enabled( enabled );
+	ImGui::SameLine();
+	if( profiler::is_capturing() )
+		ImGui::Text( "Capturing trace ..." );
+	else if( ImGui::Button( "Capture trace (120 frames)" ) )
+		profiler::capture_trace( 120, "orfn_trace.json" );
+	uint32_t thread{ ~0u };
+	for( const profiler::zone_t &z : profiler::get_last_frame() ) {
+		if( z.thread != thread ) {
+			thread = z.thread;
+			if( profiler::GPU_THREAD_ID == thread )
+				ImGui::Text( "GPU" );
+			else
+				ImGui::Text( "CPU thread %u", thread );
+		}
+		const std::string key{ std::to_string( z.thread ) + '/' + z.name };
+		const float ms{ ( z.end - z.start ) * 1e-6f };
+		auto it{ m_zoneAverages.find( key ) };
+		if( it == m_zoneAverages.end() )
+			it = m_zoneAverages.insert( { key, ms } ).first;
+		else
+			it->second += 0.1f * ( ms - it->second );
+		ImGui::Text( "%*s%-*s %7.3f ms", 2 * (int)z.depth + 2, "", 28 - 2 * (int)z.depth, z.name, it->second );
+	}
+}
+
 } /* namespace orf_n */
@@ -11,6 +11,8 @@
 #include <renderer/program.h>
 #include <scene/renderable.h>
 #include "imgui/imgui.h"
+#include <map>
+#include <string>
 
 namespace orf_n {
 
@@ -61,6 +63,17 @@ private:
 
 	GLuint m_elementsHandle;
 
+	/**
+	 * Smoothed milliseconds per profiler zone, keyed by thread and zone name,
+	 * so the breakdown stays readable.
+	 */
+	std::map<std::string, float> m_zoneAverages;
+
+	/**
+	 * Live breakdown of the profiler zones of the last frame, trace capture.
+	 */
+	void profilerUI();
+
 	virtual bool on_mouse_move( float x, float y ) override;
 
 	virtual bool on_mouse_button( int button, int action, int mods ) override;
@@ -9,6 +9,9 @@ namespace orf_n {
 std::vector<event_handler::registered_object_t> event_handler::s_registered_objects {};
 
 event_handler::event_handler( glfw_window *win ) : m_window { win } {
+	// Headless objects (no window) get no callbacks
+	if( nullptr == m_window )
+		return;
 	glfwSetCursorPosCallback( m_window->get_window(), cursorPosCallback );
 	glfwSetKeyCallback( m_window->get_window(), keyCallback );
 	glfwSetScrollCallback( m_window->get_window(), scrollCallback );
@@ -0,0 +1,247 @@
+
+#include "profiler.h"
+#include "logbook.h"
+#include "glad/glad.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <fstream>
+#include <iomanip>
+#include <mutex>
+
+namespace orf_n {
+
+namespace profiler {
+
+namespace {
+
+constexpr size_t NO_ZONE{ ~size_t{ 0 } };
+
+/**
+ * Gpu zones of one frame and their timestamp queries, 2 per zone.
+ * end is set to 1 when the end query has been issued.
+ */
+typedef struct {
+	std::vector<GLuint> queries;
+	std::vector<zone_t> zones;
+	// Profiler clock - gl timestamp at the beginning of the frame
+	int64_t offset{ 0 };
+	// Query issued last in the frame, zones end in reverse nesting order so its index tells nothing
+	size_t lastQuery{ NO_ZONE };
+} gpu_frame_t;
+
+std::mutex profiler_mutex{};
+
+bool enabled{ true };
+
+uint64_t frame_number{ 0 };
+
+std::vector<zone_t> current_zones{};
+
+std::vector<zone_t> last_cpu_zones{};
+
+std::vector<zone_t> last_gpu_zones{};
+
+// Written in frame n, read back at the beginning of frame n + 2
+gpu_frame_t gpu_frames[2]{};
+
+uint32_t gpu_depth{ 0 };
+
+std::atomic<uint32_t> next_thread_id{ 0 };
+
+thread_local uint32_t thread_id{ next_thread_id++ };
+
+thread_local uint32_t thread_depth{ 0 };
+
+std::vector<zone_t> trace_zones{};
+
+int trace_frames_left{ 0 };
+
+std::string trace_filename{};
+
+int64_t now() {
+	static const std::chrono::steady_clock::time_point epoch{ std::chrono::steady_clock::now() };
+	return std::chrono::duration_cast<std::chrono::nanoseconds>( std::chrono::steady_clock::now() - epoch ).count();
+}
+
+// Gl functions are loaded and a context exists
+bool has_gl() {
+	return nullptr != glQueryCounter && nullptr != glGetInteger64v;
+}
+
+void write_escaped( std::ostream &o, const char *s ) {
+	for( ; '\0' != *s; ++s ) {
+		if( '"' == *s || '\\' == *s )
+			o << '\\';
+		o << *s;
+	}
+}
+
+void write_chrome_trace() {
+	std::ofstream o{ trace_filename, std::ios::out };
+	if( !o.is_open() ) {
+		logbook::log_msg( logbook::RENDERER, logbook::ERROR, "Error creating trace file '" + trace_filename + "'." );
+		return;
+	}
+	std::vector<uint32_t> threads;
+	for( const zone_t &z : trace_zones )
+		if( std::find( threads.begin(), threads.end(), z.thread ) == threads.end() )
+			threads.push_back( z.thread );
+	o << "{\"traceEvents\":[\n";
+	for( const uint32_t t : threads )
+		o << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":0,\"tid\":" << t << ",\"args\":{\"name\":\"" <<
+				( GPU_THREAD_ID == t ? std::string{ "GPU" } : "CPU thread " + std::to_string( t ) ) << "\"}},\n";
+	// Microseconds as chrome expects them, with nanosecond precision
+	o << std::fixed << std::setprecision( 3 );
+	for( size_t i{ 0 }; i < trace_zones.size(); ++i ) {
+		const zone_t &z{ trace_zones[i] };
+		o << "{\"name\":\"";
+		write_escaped( o, z.name );
+		o << "\",\"cat\":\"" << ( GPU_THREAD_ID == z.thread ? "gpu" : "cpu" ) << "\",\"ph\":\"X\",\"ts\":" <<
+				z.start * 1e-3 << ",\"dur\":" << ( z.end - z.start ) * 1e-3 << ",\"pid\":0,\"tid\":" << z.thread << '}' <<
+				( i + 1 < trace_zones.size() ? ",\n" : "\n" );
+	}
+	o << "]}\n";
+	o.close();
+	logbook::log_msg( logbook::RENDERER, logbook::INFO, "Trace with " + std::to_string( trace_zones.size() ) +
+			" zones written to '" + trace_filename + "'." );
+	trace_zones.clear();
+}
+
+// Read back the gpu zones of a frame if the last query issued has a result. Queries complete in order.
+void resolve_gpu_frame( gpu_frame_t &g ) {
+	if( NO_ZONE != g.lastQuery ) {
+		GLint available{ 0 };
+		glGetQueryObjectiv( g.queries[g.lastQuery], GL_QUERY_RESULT_AVAILABLE, &available );
+		if( available ) {
+			last_gpu_zones.clear();
+			for( size_t i{ 0 }; i < g.zones.size(); ++i ) {
+				if( 0 == g.zones[i].end )
+					continue;
+				GLint64 start, end;
+				glGetQueryObjecti64v( g.queries[2 * i], GL_QUERY_RESULT, &start );
+				glGetQueryObjecti64v( g.queries[2 * i + 1], GL_QUERY_RESULT, &end );
+				zone_t z{ g.zones[i] };
+				z.start = start + g.offset;
+				z.end = end + g.offset;
+				last_gpu_zones.push_back( z );
+			}
+			if( trace_frames_left > 0 )
+				trace_zones.insert( trace_zones.end(), last_gpu_zones.begin(), last_gpu_zones.end() );
+		}
+	}
+	g.lastQuery = NO_ZONE;
+	g.zones.clear();
+}
+
+}	// namespace
+
+scoped_zone::scoped_zone( const char *name, const bool gpu ) :
+		m_cpuIndex{ NO_ZONE }, m_gpuIndex{ NO_ZONE }, m_frame{ 0 } {
+	std::lock_guard<std::mutex> lock{ profiler_mutex };
+	if( !enabled )
+		return;
+	m_frame = frame_number;
+	m_cpuIndex = current_zones.size();
+	current_zones.push_back( zone_t{ name, thread_id, thread_depth++, 0, 0 } );
+	if( gpu && has_gl() ) {
+		gpu_frame_t &g{ gpu_frames[frame_number % 2] };
+		m_gpuIndex = g.zones.size();
+		if( g.queries.size() < 2 * ( m_gpuIndex + 1 ) ) {
+			g.queries.resize( 2 * ( m_gpuIndex + 1 ) );
+			glGenQueries( 2, &g.queries[2 * m_gpuIndex] );
+		}
+		g.zones.push_back( zone_t{ name, GPU_THREAD_ID, gpu_depth++, 0, 0 } );
+		glQueryCounter( g.queries[2 * m_gpuIndex], GL_TIMESTAMP );
+	}
+	// Last, so the zone doesn't measure its own bookkeeping
+	current_zones[m_cpuIndex].start = now();
+}
+
+scoped_zone::~scoped_zone() {
+	const int64_t end{ now() };
+	if( NO_ZONE == m_cpuIndex )
+		return;
+	std::lock_guard<std::mutex> lock{ profiler_mutex };
+	--thread_depth;
+	// A zone that spans the beginning of a frame is dropped
+	if( m_frame == frame_number )
+		current_zones[m_cpuIndex].end = end;
+	if( NO_ZONE != m_gpuIndex ) {
+		--gpu_depth;
+		if( m_frame == frame_number ) {
+			gpu_frame_t &g{ gpu_frames[frame_number % 2] };
+			glQueryCounter( g.queries[2 * m_gpuIndex + 1], GL_TIMESTAMP );
+			g.zones[m_gpuIndex].end = 1;
+			g.lastQuery = 2 * m_gpuIndex + 1;
+		}
+	}
+}
+
+void begin_frame() {
+	std::lock_guard<std::mutex> lock{ profiler_mutex };
+	last_cpu_zones.clear();
+	for( const zone_t &z : current_zones )
+		if( 0 != z.end )
+			last_cpu_zones.push_back( z );
+	current_zones.clear();
+	if( trace_frames_left > 0 )
+		trace_zones.insert( trace_zones.end(), last_cpu_zones.begin(), last_cpu_zones.end() );
+	++frame_number;
+	if( has_gl() ) {
+		// The buffer for this frame holds the zones of the frame before last
+		gpu_frame_t &g{ gpu_frames[frame_number % 2] };
+		resolve_gpu_frame( g );
+		GLint64 gpuNow;
+		glGetInteger64v( GL_TIMESTAMP, &gpuNow );
+		g.offset = now() - gpuNow;
+	}
+	if( trace_frames_left > 0 && 0 == --trace_frames_left )
+		write_chrome_trace();
+}
+
+void set_enabled( const bool e ) {
+	std::lock_guard<std::mutex> lock{ profiler_mutex };
+	enabled = e;
+}
+
+bool is_enabled() {
+	std::lock_guard<std::mutex> lock{ profiler_mutex };
+	return enabled;
+}
+
+std::vector<zone_t> get_last_frame() {
+	std::lock_guard<std::mutex> lock{ profiler_mutex };
+	std::vector<zone_t> zones{ last_cpu_zones };
+	zones.insert( zones.end(), last_gpu_zones.begin(), last_gpu_zones.end() );
+	std::stable_sort( zones.begin(), zones.end(), []( const zone_t &a, const zone_t &b ) {
+		return a.thread < b.thread || ( a.thread == b.thread && a.start < b.start );
+	} );
+	return zones;
+}
+
+void capture_trace( const int frames, const std::string &filename ) {
+	std::lock_guard<std::mutex> lock{ profiler_mutex };
+	trace_zones.clear();
+	trace_frames_left = frames;
+	trace_filename = filename;
+}
+
+bool is_capturing() {
+	std::lock_guard<std::mutex> lock{ profiler_mutex };
+	return trace_frames_left > 0;
+}
+
+void cleanup() {
+	std::lock_guard<std::mutex> lock{ profiler_mutex };
+	for( gpu_frame_t &g : gpu_frames ) {
+		if( !g.queries.empty() && has_gl() )
+			glDeleteQueries( (GLsizei)g.queries.size(), g.queries.data() );
+		g.queries.clear();
+		g.zones.clear();
+	}
+}
+
+}
+
+}
@@ -0,0 +1,88 @@
+
+/**
+ * Lightweight frame profiler.
+ * Scoped zones measure cpu time with a nanosecond clock per thread and, optionally,
+ * gpu time with GL timestamp queries. Queries are double buffered: results of a frame
+ * are read two frames later and only if available, so reading never stalls.
+ * Zones of the last complete frame can be displayed, a number of frames can be
+ * captured and written as Chrome trace JSON (chrome://tracing, Perfetto).
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace orf_n {
+
+namespace profiler {
+
+typedef struct {
+	// Must outlive the profiler data, e.g. a string literal or a renderable's name
+	const char *name;
+	// Small sequential id per thread, GPU_THREAD_ID for gpu zones
+	uint32_t thread;
+	// Nesting depth per thread
+	uint32_t depth;
+	// Profiler clock in nanoseconds, gpu times converted to it
+	int64_t start;
+	int64_t end;
+} zone_t;
+
+constexpr uint32_t GPU_THREAD_ID{ 1000 };
+
+/**
+ * Measures the lifetime of the object as a zone. Measures gpu time too if gpu is set
+ * and a gl context is current. Gpu zones must begin and end on the render thread.
+ */
+class scoped_zone {
+public:
+	scoped_zone( const char *name, const bool gpu = false );
+
+	~scoped_zone();
+
+	scoped_zone( const scoped_zone & ) = delete;
+
+	scoped_zone &operator=( const scoped_zone & ) = delete;
+
+private:
+	size_t m_cpuIndex;
+
+	size_t m_gpuIndex;
+
+	uint64_t m_frame;
+
+};
+
+/**
+ * Start a new frame. Call on the render thread outside of any zone.
+ * Completes the cpu zones of the last frame and reads available gpu results.
+ */
+void begin_frame();
+
+void set_enabled( const bool enabled );
+
+bool is_enabled();
+
+/**
+ * Cpu zones of the last complete frame and gpu zones of the latest frame with results,
+ * ordered by start time per thread.
+ */
+std::vector<zone_t> get_last_frame();
+
+/**
+ * Collect the zones of the next frames and write them as a Chrome trace when done.
+ */
+void capture_trace( const int frames, const std::string &filename );
+
+bool is_capturing();
+
+/**
+ * Delete gl queries. Call before the gl context is destroyed.
+ */
+void cleanup();
+
+}
+
+}
@@ -0,0 +1,114 @@
+#include "thread_pool.h"
+#include <algorithm>
+
+namespace orf_n {
+
+namespace {
+
+// Pool the current thread works for, loops started from its jobs or bands run serially
+thread_local const thread_pool *worker_of{ nullptr };
+
+}
+
+thread_pool::thread_pool( unsigned int num_threads ) {
+	if( 0 == num_threads )
+		num_threads = std::max( 1u, std::thread::hardware_concurrency() );
+	// The calling thread works on loops too
+	for( unsigned int i{1}; i < num_threads; ++i )
+		m_threads.emplace_back( [this]() { work(); } );
+}
+
+thread_pool::~thread_pool() {
+	{
+		std::lock_guard<std::mutex> lock{ m_mutex };
+		m_stop = true;
+	}
+	m_start.notify_all();
+	for( std::thread &t : m_threads )
+		t.join();
+}
+
+unsigned int thread_pool::get_number_of_threads() const {
+	return static_cast<unsigned int>( m_threads.size() ) + 1;
+}
+
+void thread_pool::parallel_for( const uint32_t first, const uint32_t last,
+		const std::function<void( uint32_t, uint32_t )> &band, uint32_t grain ) {
+	if( first >= last )
+		return;
+	if( 0 == grain )
+		grain = std::max( 1u, ( last - first + get_number_of_threads() - 1 ) / get_number_of_threads() );
+	// Not worth waking the workers, or nested in a job or band of this pool
+	if( m_threads.empty() || last - first <= grain || this == worker_of ) {
+		for( uint32_t b{ first }; b < last; b += grain )
+			band( b, std::min( last, b + grain ) );
+		return;
+	}
+	{
+		std::lock_guard<std::mutex> lock{ m_mutex };
+		m_band = &band;
+		m_first = first;
+		m_last = last;
+		m_grain = grain;
+		m_next = first;
+		++m_generation;
+	}
+	m_start.notify_all();
+	run_bands();
+	// All bands are taken. Close the loop to workers that come late and wait for the ones in it.
+	std::unique_lock<std::mutex> lock{ m_mutex };
+	m_band = nullptr;
+	m_done.wait( lock, [this]() { return 0 == m_busy; } );
+}
+
+bool thread_pool::wait_for( std::vector<std::future<bool>> &results ) {
+	bool success{ true };
+	for( std::future<bool> &r : results )
+		success = r.get() && success;
+	results.clear();
+	return success;
+}
+
+void thread_pool::run_bands() {
+	while( true ) {
+		const uint32_t b{ m_next.fetch_add( m_grain ) };
+		if( b >= m_last || b < m_first )
+			break;
+		( *m_band )( b, std::min( m_last, b + m_grain ) );
+	}
+}
+
+void thread_pool::work() {
+	worker_of = this;
+	uint64_t generation{ 0 };
+	while( true ) {
+		std::packaged_task<bool()> job;
+		{
+			std::unique_lock<std::mutex> lock{ m_mutex };
+			m_start.wait( lock, [&]() { return m_stop || generation != m_generation || !m_jobs.empty(); } );
+			const bool joinLoop{ generation != m_generation && nullptr != m_band };
+			generation = m_generation;
+			if( joinLoop )
+				++m_busy;
+			else if( !m_jobs.empty() ) {
+				job = std::move( m_jobs.front() );
+				m_jobs.pop_front();
+			} else if( m_stop )
+				return;
+			else
+				continue;
+		}
+		if( job.valid() ) {
+			job();
+			continue;
+		}
+		run_bands();
+		{
+			std::lock_guard<std::mutex> lock{ m_mutex };
+			--m_busy;
+		}
+		m_done.notify_one();
+	}
+}
+
+}
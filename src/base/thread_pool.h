@@ -0,0 +1,105 @@
+/**
+ * Fixed pool of worker threads, for data parallel loops like the stencil passes of the erosion solver
+ * and for independent jobs like the tiles of the converter.
+ * parallel_for() splits a range into bands that the calling thread and the idle workers take in turn,
+ * and returns when all bands are done. Workers busy with a job don't hold a loop up. One loop runs at
+ * a time; a loop started from inside a job or a band runs on that thread alone.
+ * submit() queues a job that returns true on success and returns a future for the result, wait_for()
+ * blocks on a set of futures. Without workers, submit() runs the job right away.
+ */
+
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <future>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace orf_n {
+
+class thread_pool {
+public:
+	/**
+	 * Start the workers. 0 means one thread per hardware thread, including the calling thread.
+	 */
+	explicit thread_pool( unsigned int num_threads = 0 );
+
+	virtual ~thread_pool();
+
+	thread_pool( const thread_pool & ) = delete;
+
+	thread_pool &operator=( const thread_pool & ) = delete;
+
+	// Number of threads working on a loop, including the calling thread
+	unsigned int get_number_of_threads() const;
+
+	/**
+	 * Call band( first, last ) for consecutive bands of [first, last) of at most grain elements,
+	 * 0 for a band per thread, in parallel. Blocks until all bands are done.
+	 */
+	void parallel_for( const uint32_t first, const uint32_t last,
+			const std::function<void( uint32_t, uint32_t )> &band, uint32_t grain = 0 );
+
+	template<typename F>
+	std::future<bool> submit( F job ) {
+		std::packaged_task<bool()> task{ std::move( job ) };
+		std::future<bool> result{ task.get_future() };
+		if( m_threads.empty() ) {
+			task();
+			return result;
+		}
+		{
+			std::lock_guard<std::mutex> lock{ m_mutex };
+			m_jobs.push_back( std::move( task ) );
+		}
+		m_start.notify_one();
+		return result;
+	}
+
+	/**
+	 * Wait for all results and clear them, true if all jobs succeeded.
+	 */
+	static bool wait_for( std::vector<std::future<bool>> &results );
+
+private:
+	std::vector<std::thread> m_threads;
+
+	std::deque<std::packaged_task<bool()>> m_jobs;
+
+	std::mutex m_mutex;
+
+	std::condition_variable m_start;
+
+	std::condition_variable m_done;
+
+	// Current loop
+	const std::function<void( uint32_t, uint32_t )> *m_band{ nullptr };
+
+	uint32_t m_first{ 0 };
+
+	uint32_t m_last{ 0 };
+
+	uint32_t m_grain{ 1 };
+
+	std::atomic<uint32_t> m_next{ 0 };
+
+	// Incremented per loop, wakes the workers
+	uint64_t m_generation{ 0 };
+
+	// Workers that joined the current loop and haven't left it yet
+	unsigned int m_busy{ 0 };
+
+	bool m_stop{ false };
+
+	void work();
+
+	void run_bands();
+
+};
+
+}
@@ -3,6 +3,9 @@
 
 #include <noise/Generator.h>
 #include <noise/Misc.h>
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
 
 namespace noise {
 
@@ -27,6 +30,9 @@ const int DEFAULT_SEED{ 0 };
 /// Maximum number of octaves for the noise::module::RidgedMulti noise module.
 const int MAX_OCTAVE_COUNT{ 30 };
 
+/// Number of input values a batch of coherent noise is generated for at once.
+const size_t NOISE_BATCH_SIZE{ 256 };
+
 
 /// Abstract base class for noise modules.
 ///
@@ -216,6 +222,22 @@ public:
 
 	virtual double getValue( double x, double y, double z ) const = 0;
 
+	/// Generates the output values for a number of input values.
+	///
+	/// @param x The @a x coordinates of the input values.
+	/// @param y The @a y coordinates of the input values.
+	/// @param z The @a z coordinates of the input values.
+	/// @param values Receives the output value for each input value.
+	/// @param count The number of input values.
+	///
+	/// The results are the same as from getValue().  This version calls getValue()
+	/// for each input value, generator modules override it with vectorised versions.
+	virtual void getValues( const double *x, const double *y, const double *z, double *values,
+			const size_t count ) const {
+		for( size_t i{0}; i < count; ++i )
+			values[i] = getValue( x[i], y[i], z[i] );
+	}
+
 	virtual ~BaseNoise() {};
 
 	virtual void setOctaveCount( const int octaveCount ) {
@@ -251,6 +273,48 @@ public:
 	}
 
 protected:
+	/// Runs the octaves of the input values in batches of NOISE_BATCH_SIZE, as getValue() does
+	/// for one: the coordinates are scaled by the frequency and then by the lacunarity for each
+	/// octave, and the coherent noise of each octave is generated for the whole batch.
+	///
+	/// @param seedMask Applied to the seed of each octave.
+	/// @param combine Called as combine( octave, persistence, signal, values, n ) for each octave of a
+	/// batch, adds the @a n coherent-noise values in @a signal to @a values, which start at 0.
+	template<typename Combine>
+	void getOctaveValues( const double *x, const double *y, const double *z, double *values,
+			const size_t count, const int seedMask, Combine combine ) const {
+		double cx[NOISE_BATCH_SIZE], cy[NOISE_BATCH_SIZE], cz[NOISE_BATCH_SIZE];
+		double nx[NOISE_BATCH_SIZE], ny[NOISE_BATCH_SIZE], nz[NOISE_BATCH_SIZE];
+		double signal[NOISE_BATCH_SIZE];
+		for( size_t first{0}; first < count; first += NOISE_BATCH_SIZE ) {
+			const size_t n{ std::min( NOISE_BATCH_SIZE, count - first ) };
+			double *const v{ values + first };
+			for( size_t i{0}; i < n; ++i ) {
+				cx[i] = x[first + i] * m_frequency;
+				cy[i] = y[first + i] * m_frequency;
+				cz[i] = z[first + i] * m_frequency;
+				v[i] = 0.0;
+			}
+			double curPersistence{ 1.0 };
+			for( int curOctave{0}; curOctave < m_octaveCount; ++curOctave ) {
+				// Most coordinates are in range already, then makeInt32Range() returns them
+				for( size_t i{0}; i < n; ++i ) {
+					nx[i] = std::abs( cx[i] ) < 1073741824.0 ? cx[i] : makeInt32Range( cx[i] );
+					ny[i] = std::abs( cy[i] ) < 1073741824.0 ? cy[i] : makeInt32Range( cy[i] );
+					nz[i] = std::abs( cz[i] ) < 1073741824.0 ? cz[i] : makeInt32Range( cz[i] );
+				}
+				gradientCoherentNoise3D( nx, ny, nz, signal, n, ( m_seed + curOctave ) & seedMask, m_quality );
+				combine( curOctave, curPersistence, signal, v, n );
+				for( size_t i{0}; i < n; ++i ) {
+					cx[i] *= m_lacunarity;
+					cy[i] *= m_lacunarity;
+					cz[i] *= m_lacunarity;
+				}
+				curPersistence *= m_persistence;
+			}
+		}
+	}
+
 	double m_frequency{ DEFAULT_FREQUENCY };
 
 	double m_lacunarity{ DEFAULT_LACUNARITY };
@@ -51,6 +51,17 @@ public:
 		return value += 0.5;
 	}
 
+	virtual void getValues( const double *x, const double *y, const double *z, double *values,
+			const size_t count ) const override final {
+		getOctaveValues( x, y, z, values, count, 0xffffffff, []( const int, const double curPersistence,
+				const double *signal, double *value, const size_t n ) {
+			for( size_t i{0}; i < n; ++i )
+				value[i] += ( 2.0 * std::abs( signal[i] ) - 1.0 ) * curPersistence;
+		} );
+		for( size_t i{0}; i < count; ++i )
+			values[i] += 0.5;
+	}
+
 };
 
 }
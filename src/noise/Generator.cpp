@@ -1,5 +1,7 @@
 
 #include <noise/Generator.h>
+#include <emmintrin.h>
+#include <cstdint>
 
 namespace noise {
 
@@ -75,5 +77,114 @@ double gradientCoherentNoise3D( double x, double y, double z, int seed, noiseQua
 	return noiselerp (iy0, iy1, zs);
 }
 
+namespace {
+
+// Multiplies 32 bit lanes, SSE2 only has _mm_mul_epu32 for every other lane
+inline __m128i mulloSSE2( const __m128i a, const int b ) {
+	const __m128i factor{ _mm_set1_epi32( b ) };
+	const __m128i even{ _mm_mul_epu32( a, factor ) };
+	const __m128i odd{ _mm_mul_epu32( _mm_srli_si128( a, 4 ), factor ) };
+	return _mm_unpacklo_epi32( _mm_shuffle_epi32( even, _MM_SHUFFLE( 0, 0, 2, 0 ) ),
+			_mm_shuffle_epi32( odd, _MM_SHUFFLE( 0, 0, 2, 0 ) ) );
+}
+
+// gradientNoise3D() for the two lanes
+inline __m128d gradientNoiseSSE2( const __m128d x, const __m128d y, const __m128d z, const __m128i ix,
+		const __m128i iy, const __m128i iz, const __m128i seedTerm ) {
+	__m128i index{ _mm_add_epi32( _mm_add_epi32( _mm_add_epi32( mulloSSE2( ix, X_NOISE_GEN ),
+			mulloSSE2( iy, Y_NOISE_GEN ) ), mulloSSE2( iz, Z_NOISE_GEN ) ), seedTerm ) };
+	index = _mm_xor_si128( index, _mm_srai_epi32( index, SHIFT_NOISE_GEN ) );
+	index = _mm_slli_epi32( _mm_and_si128( index, _mm_set1_epi32( 0xff ) ), 2 );
+	const int i0{ _mm_cvtsi128_si32( index ) };
+	const int i1{ _mm_cvtsi128_si32( _mm_srli_si128( index, 4 ) ) };
+	const __m128d xvGradient{ _mm_set_pd( RANDOM_VECTORS[i1], RANDOM_VECTORS[i0] ) };
+	const __m128d yvGradient{ _mm_set_pd( RANDOM_VECTORS[i1 + 1], RANDOM_VECTORS[i0 + 1] ) };
+	const __m128d zvGradient{ _mm_set_pd( RANDOM_VECTORS[i1 + 2], RANDOM_VECTORS[i0 + 2] ) };
+	const __m128d xvPoint{ _mm_sub_pd( x, _mm_cvtepi32_pd( ix ) ) };
+	const __m128d yvPoint{ _mm_sub_pd( y, _mm_cvtepi32_pd( iy ) ) };
+	const __m128d zvPoint{ _mm_sub_pd( z, _mm_cvtepi32_pd( iz ) ) };
+	return _mm_mul_pd( _mm_add_pd( _mm_add_pd( _mm_mul_pd( xvGradient, xvPoint ), _mm_mul_pd( yvGradient, yvPoint ) ),
+			_mm_mul_pd( zvGradient, zvPoint ) ), _mm_set1_pd( 2.12 ) );
+}
+
+// Lower corner of the unit cube, as int and as double
+inline void cubeSSE2( const __m128d x, __m128d &x0d, __m128i &x0 ) {
+	const __m128d truncated{ _mm_cvtepi32_pd( _mm_cvttpd_epi32( x ) ) };
+	x0d = _mm_sub_pd( truncated, _mm_and_pd( _mm_cmple_pd( x, _mm_setzero_pd() ), _mm_set1_pd( 1.0 ) ) );
+	x0 = _mm_cvttpd_epi32( x0d );
 }
 
+inline __m128d sCurveSSE2( const __m128d a, const noiseQuality_t noiseQuality ) {
+	switch( noiseQuality ) {
+		case QUALITY_FAST:
+			return a;
+		case QUALITY_STD:
+			return _mm_mul_pd( _mm_mul_pd( a, a ), _mm_sub_pd( _mm_set1_pd( 3.0 ), _mm_mul_pd( _mm_set1_pd( 2.0 ), a ) ) );
+		case QUALITY_BEST: {
+			const __m128d a3{ _mm_mul_pd( _mm_mul_pd( a, a ), a ) };
+			const __m128d a4{ _mm_mul_pd( a3, a ) };
+			const __m128d a5{ _mm_mul_pd( a4, a ) };
+			return _mm_add_pd( _mm_sub_pd( _mm_mul_pd( _mm_set1_pd( 6.0 ), a5 ), _mm_mul_pd( _mm_set1_pd( 15.0 ), a4 ) ),
+					_mm_mul_pd( _mm_set1_pd( 10.0 ), a3 ) );
+		}
+	}
+	return _mm_setzero_pd();
+}
+
+inline __m128d lerpSSE2( const __m128d n0, const __m128d n1, const __m128d a ) {
+	return _mm_add_pd( _mm_mul_pd( _mm_sub_pd( _mm_set1_pd( 1.0 ), a ), n0 ), _mm_mul_pd( a, n1 ) );
+}
+
+}
+
+void gradientCoherentNoise3DSSE2( const double *x, const double *y, const double *z, double *values,
+		const size_t count, const int seed, const noiseQuality_t noiseQuality ) {
+	const __m128i seedTerm{ _mm_set1_epi32( static_cast<int>( static_cast<uint32_t>( SEED_NOISE_GEN ) *
+			static_cast<uint32_t>( seed ) ) ) };
+	const __m128i one{ _mm_set1_epi32( 1 ) };
+	size_t i{0};
+	for( ; i + 2 <= count; i += 2 ) {
+		const __m128d vx{ _mm_loadu_pd( x + i ) };
+		const __m128d vy{ _mm_loadu_pd( y + i ) };
+		const __m128d vz{ _mm_loadu_pd( z + i ) };
+		__m128d x0d, y0d, z0d;
+		__m128i x0, y0, z0;
+		cubeSSE2( vx, x0d, x0 );
+		cubeSSE2( vy, y0d, y0 );
+		cubeSSE2( vz, z0d, z0 );
+		const __m128i x1{ _mm_add_epi32( x0, one ) };
+		const __m128i y1{ _mm_add_epi32( y0, one ) };
+		const __m128i z1{ _mm_add_epi32( z0, one ) };
+		const __m128d xs{ sCurveSSE2( _mm_sub_pd( vx, x0d ), noiseQuality ) };
+		const __m128d ys{ sCurveSSE2( _mm_sub_pd( vy, y0d ), noiseQuality ) };
+		const __m128d zs{ sCurveSSE2( _mm_sub_pd( vz, z0d ), noiseQuality ) };
+		__m128d n0{ gradientNoiseSSE2( vx, vy, vz, x0, y0, z0, seedTerm ) };
+		__m128d n1{ gradientNoiseSSE2( vx, vy, vz, x1, y0, z0, seedTerm ) };
+		__m128d ix0{ lerpSSE2( n0, n1, xs ) };
+		n0 = gradientNoiseSSE2( vx, vy, vz, x0, y1, z0, seedTerm );
+		n1 = gradientNoiseSSE2( vx, vy, vz, x1, y1, z0, seedTerm );
+		__m128d ix1{ lerpSSE2( n0, n1, xs ) };
+		const __m128d iy0{ lerpSSE2( ix0, ix1, ys ) };
+		n0 = gradientNoiseSSE2( vx, vy, vz, x0, y0, z1, seedTerm );
+		n1 = gradientNoiseSSE2( vx, vy, vz, x1, y0, z1, seedTerm );
+		ix0 = lerpSSE2( n0, n1, xs );
+		n0 = gradientNoiseSSE2( vx, vy, vz, x0, y1, z1, seedTerm );
+		n1 = gradientNoiseSSE2( vx, vy, vz, x1, y1, z1, seedTerm );
+		ix1 = lerpSSE2( n0, n1, xs );
+		const __m128d iy1{ lerpSSE2( ix0, ix1, ys ) };
+		_mm_storeu_pd( values + i, lerpSSE2( iy0, iy1, zs ) );
+	}
+	for( ; i < count; ++i )
+		values[i] = gradientCoherentNoise3D( x[i], y[i], z[i], seed, noiseQuality );
+}
+
+void gradientCoherentNoise3D( const double *x, const double *y, const double *z, double *values,
+		const size_t count, const int seed, const noiseQuality_t noiseQuality ) {
+	static const bool hasAVX2{ 0 != __builtin_cpu_supports( "avx2" ) };
+	if( hasAVX2 )
+		gradientCoherentNoise3DAVX2( x, y, z, values, count, seed, noiseQuality );
+	else
+		gradientCoherentNoise3DSSE2( x, y, z, values, count, seed, noiseQuality );
+}
+
+}
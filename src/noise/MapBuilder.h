@@ -9,6 +9,7 @@
 #include <fstream>
 #include <limits>
 #include <stdexcept>
+#include <vector>
 #include <png++/image.hpp>
 #include <png++/gray_pixel.hpp>
 
@@ -225,26 +226,37 @@ public:
 		const double zDelta{ zExtent / (double)h };
 		double xCur{ m_lowerX };
 		double zCur{ m_lowerZ };
+		// A row of input values at a time, to generate the output values in a batch.
+		std::vector<double> xs( w ), xsEast( w ), ys( w, 0.0 ), zs( w ), zsNorth( w );
+		std::vector<double> sw( w ), se( w ), nw( w ), ne( w );
+		xCur = m_lowerX;
+		for( uint16_t x{0}; x < w; ++x ) {
+			xs[x] = xCur;
+			xsEast[x] = xCur + xExtent;
+			xCur += xDelta;
+		}
 		// Fill every point in the noise map with the output values from the model.
 		for( uint16_t z{0}; z < h; ++z ) {
-			xCur = m_lowerX;
+			std::fill( zs.begin(), zs.end(), zCur );
+			m_source->getValues( xs.data(), ys.data(), zs.data(), sw.data(), w );
+			if( m_enableSeamless ) {
+				std::fill( zsNorth.begin(), zsNorth.end(), zCur + zExtent );
+				m_source->getValues( xsEast.data(), ys.data(), zs.data(), se.data(), w );
+				m_source->getValues( xs.data(), ys.data(), zsNorth.data(), nw.data(), w );
+				m_source->getValues( xsEast.data(), ys.data(), zsNorth.data(), ne.data(), w );
+			}
 			for( uint16_t x{0}; x < w; ++x ) {
 				float finalValue;
 				if( !m_enableSeamless )
-					finalValue = m_source->getValue( xCur, 0.0, zCur );
+					finalValue = sw[x];
 				else {
-					const double swValue{ m_source->getValue( xCur, 0.0, zCur ) };
-					const double seValue{ m_source->getValue( xCur + xExtent, 0.0, zCur ) };
-					const double nwValue{ m_source->getValue( xCur, 0.0, zCur + zExtent ) };
-					const double neValue{ m_source->getValue( xCur + xExtent, 0.0, zCur + zExtent ) };
-					const double xBlend{ 1.0 - ( ( xCur - m_lowerX ) / xExtent ) };
+					const double xBlend{ 1.0 - ( ( xs[x] - m_lowerX ) / xExtent ) };
 					const double zBlend{ 1.0 - ( ( zCur - m_lowerZ ) / zExtent ) };
-					const double z0{ noiselerp( swValue, seValue, xBlend ) };
-					const double z1{ noiselerp( nwValue, neValue, xBlend ) };
+					const double z0{ noiselerp( sw[x], se[x], xBlend ) };
+					const double z1{ noiselerp( nw[x], ne[x], xBlend ) };
 					finalValue = (float)noiselerp( z0, z1, zBlend );
 				}
 				m_noiseMap->setValue( x, z, finalValue );
-				xCur += xDelta;
 			}
 		    zCur += zDelta;
 		}
@@ -288,15 +300,19 @@ public:
 		const double yDelta{ latExtent / (double)m_noiseMap->getHeight() };
 		double curLon{ m_westLon };
 		double curLat{ m_southLat };
+		// A row of input values at a time, to generate the output values in a batch.
+		const int width{ m_noiseMap->getWidth() };
+		std::vector<double> xs( width ), ys( width ), zs( width ), values( width );
 		// Fill every point in the noise map with the output values from the model.
 		for( int h{0}; h < m_noiseMap->getHeight(); ++h ) {
 			curLon = m_westLon;
-			for( int w{0}; w < m_noiseMap->getWidth(); ++w ) {
-				double x, y, z;
-				latLonToXYZ( curLat, curLon, x, y, z );
-				m_noiseMap->setValue( w, h, m_source->getValue( x, y, z ) );
+			for( int w{0}; w < width; ++w ) {
+				latLonToXYZ( curLat, curLon, xs[w], ys[w], zs[w] );
 				curLon += xDelta;
 			}
+			m_source->getValues( xs.data(), ys.data(), zs.data(), values.data(), width );
+			for( int w{0}; w < width; ++w )
+				m_noiseMap->setValue( w, h, values[w] );
 			curLat += yDelta;
 		}
 	}
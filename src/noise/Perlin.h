@@ -138,6 +138,15 @@ public:
 		return value;
 	}
 
+	virtual void getValues( const double *x, const double *y, const double *z, double *values,
+			const size_t count ) const override final {
+		getOctaveValues( x, y, z, values, count, 0xffffffff, []( const int, const double curPersistence,
+				const double *signal, double *value, const size_t n ) {
+			for( size_t i{0}; i < n; ++i )
+				value[i] += signal[i] * curPersistence;
+		} );
+	}
+
 };
 
 }
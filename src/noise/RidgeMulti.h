@@ -126,6 +126,28 @@ public:
 		return value * 1.25 - 1.0;
 	}
 
+	virtual void getValues( const double *x, const double *y, const double *z, double *values,
+			const size_t count ) const override final {
+		const double offset{ 1.0 };
+		const double gain{ 2.0 };
+		// Weight of each value of a batch from the previous octave
+		double weight[NOISE_BATCH_SIZE];
+		getOctaveValues( x, y, z, values, count, 0x7fffffff, [&]( const int curOctave, const double,
+				const double *signal, double *value, const size_t n ) {
+			if( 0 == curOctave )
+				std::fill_n( weight, n, 1.0 );
+			for( size_t i{0}; i < n; ++i ) {
+				double s{ offset - std::abs( signal[i] ) };
+				s *= s;
+				s *= weight[i];
+				weight[i] = std::clamp( s * gain, 0.0, 1.0 );
+				value[i] += s * m_spectralWeights[curOctave];
+			}
+		} );
+		for( size_t i{0}; i < count; ++i )
+			values[i] = values[i] * 1.25 - 1.0;
+	}
+
 private:
 	/// Calculates the spectral weights for each octave.
 	/// This method is called when the lacunarity changes.
@@ -4,7 +4,9 @@
 #include "renderer/renderer.h"
 #include "glad/glad.h"
 #include <iostream>
+#include <cstdlib>	// strtod()
 #include <cstring>	// strcmp()
+#include <string>
 //#include "../utils/asc2png.h"
 
 using namespace orf_n;
@@ -19,16 +21,36 @@ int main( int argc, char *argv[] ) {
 	logbook::log_msg( "Program started." );
 
 	bool debug{ true };
-	if( argc > 1 ) {
-		if( 0 == strcmp( argv[1], "-d" ) || 0 == strcmp( argv[1], "--debug" ) )
+	std::string recordFile;
+	std::string replayFile;
+	double replayTimeStep{ 1.0 / 60.0 };
+	for( int i{ 1 }; i < argc; ++i ) {
+		if( 0 == strcmp( argv[i], "-d" ) || 0 == strcmp( argv[i], "--debug" ) )
 			debug = true;
-		else
-			std::cout << "Unknown parameter: " << argv[1] << "\n";
+		else if( 0 == strcmp( argv[i], "--record" ) && i + 1 < argc )
+			recordFile = argv[++i];
+		else if( 0 == strcmp( argv[i], "--replay" ) && i + 1 < argc )
+			replayFile = argv[++i];
+		else if( 0 == strcmp( argv[i], "--timestep" ) && i + 1 < argc ) {
+			const char *value{ argv[++i] };
+			char *end{ nullptr };
+			replayTimeStep = std::strtod( value, &end );
+			if( end == value || '\0' != *end || !( replayTimeStep > 0.0 ) ) {
+				std::cerr << "Invalid time step: " << value << "\n";
+				logbook::log_msg( "Program ending on invalid time step." );
+				return EXIT_FAILURE;
+			}
+		} else
+			std::cout << "Unknown parameter: " << argv[i] << "\n";
 	}
 
 	try {
 		renderer* r = new renderer( debug );
 		r->setupRenderer();
+		if( !recordFile.empty() )
+			r->record_camera_path( recordFile );
+		if( !replayFile.empty() )
+			r->replay_camera_path( replayFile, replayTimeStep );
 		r->setup();
 		r->render();
 		r->cleanup();
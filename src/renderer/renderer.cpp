@@ -5,6 +5,7 @@
 #include "applications/camera/camera.h"
 #include "base/globals.h"	// deltaTime
 #include "base/logbook.h"
+#include "base/profiler.h"
 //#include "applications/icosphere_ellipsoid/icosphere_ellipsoid.h"
 #include "applications/SkyBox/SkyBox.h"
 
@@ -52,16 +53,36 @@ void renderer::setup() const {
 	m_scene->setup();
 }
 
+void renderer::record_camera_path( const std::string &filename ) {
+	m_recordFilename = filename;
+}
+
+void renderer::replay_camera_path( const std::string &filename, const double time_step ) {
+	m_replayFilename = filename;
+	m_replayTimeStep = time_step;
+}
+
 void renderer::render() const {
+	// After setup, applications may have positioned the camera
+	if( !m_replayFilename.empty() )
+		m_camera->start_replay( m_replayFilename, m_replayTimeStep );
+	else if( !m_recordFilename.empty() )
+		m_camera->start_recording( m_recordFilename );
 	logbook::log_msg( orf_n::logbook::RENDERER, orf_n::logbook::INFO,
 			"--- Entering main loop ---" );
 	double lastFrame { 0.0 };
 	uint64_t frameCounter { 0 };
 
 	while( !glfwWindowShouldClose( m_window->get_window() ) ) {
+		profiler::begin_frame();
+		profiler::scoped_zone frameZone{ "Frame", true };
 		double currentFrame { glfwGetTime() };
 		++frameCounter;
-		orf_n::globals::delta_time = currentFrame - lastFrame;
+		// A replay runs with a fixed time step to be repeatable frame for frame
+		if( m_camera->is_replaying() )
+			orf_n::globals::delta_time = m_replayTimeStep;
+		else
+			orf_n::globals::delta_time = currentFrame - lastFrame;
 		lastFrame = currentFrame;
 
 		//glEnable( GL_FRAMEBUFFER_SRGB );
@@ -69,29 +90,37 @@ void renderer::render() const {
 		m_framebuffer->bind( GL_DRAW_FRAMEBUFFER );
 		m_framebuffer->clear( omath::vec4{ 0.0f, 0.0f, 0.0f, 1.0f } );
 
-		m_scene->prepareFrame();
-		// Called after prepareFrame() because UIOverlay has to start a new frame.
-		m_scene->get_camera()->update_moving();
+		{
+			profiler::scoped_zone zone{ "Prepare frame" };
+			m_scene->prepareFrame();
+			// Called after prepareFrame() because UIOverlay has to start a new frame.
+			m_scene->get_camera()->update_moving();
+		}
 
 		m_scene->render();
 		m_scene->endFrame();
 		//glDisable( GL_FRAMEBUFFER_SRGB );
 
-		// Blit framebuffer to default window framebuffer
-		m_framebuffer->bind( GL_READ_FRAMEBUFFER );
-		// or m_framebuffer->unbind()
-		glBindFramebuffer( GL_DRAW_FRAMEBUFFER, 0 );
-		// clear to blue to distinguish between draw framebuffer; color::blue
-		glClearColor( 0.0f, 0.0f, 1.0f, 1.0f );
-		glClear( GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT );
-		glBlitFramebuffer( 0, 0, m_window->get_width(), m_window->get_height(),
-						   0, 0, m_window->get_width(), m_window->get_height(),
-						   GL_COLOR_BUFFER_BIT, GL_NEAREST );
-
+		{
+			profiler::scoped_zone zone{ "Blit", true };
+			// Blit framebuffer to default window framebuffer
+			m_framebuffer->bind( GL_READ_FRAMEBUFFER );
+			// or m_framebuffer->unbind()
+			glBindFramebuffer( GL_DRAW_FRAMEBUFFER, 0 );
+			// clear to blue to distinguish between draw framebuffer; color::blue
+			glClearColor( 0.0f, 0.0f, 1.0f, 1.0f );
+			glClear( GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT );
+			glBlitFramebuffer( 0, 0, m_window->get_width(), m_window->get_height(),
+							   0, 0, m_window->get_width(), m_window->get_height(),
+							   GL_COLOR_BUFFER_BIT, GL_NEAREST );
+		}
+
+		profiler::scoped_zone zone{ "Events and swap" };
 		glfwPollEvents();
 		glfwSwapBuffers( m_scene->get_window()->get_window() );
 
 	}
+	m_camera->stop_recording();
 	logbook::log_msg( orf_n::logbook::RENDERER, orf_n::logbook::INFO,
 			"--- Leaving main loop ---" );
 }
@@ -101,6 +130,7 @@ void renderer::cleanup() const {
 }
 
 void renderer::cleanupRenderer() {
+	profiler::cleanup();
 	delete m_framebuffer;
 	delete m_scene;
 	delete m_overlay;
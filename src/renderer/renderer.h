@@ -9,6 +9,7 @@
 
 #include <scene/scene.h>
 #include "Framebuffer.h"
+#include <string>
 
 namespace orf_n {
 
@@ -28,6 +29,17 @@ public:
 	 */
 	void setup() const;
 
+	/**
+	 * Record the camera path of the session to a file. Call before render().
+	 */
+	void record_camera_path( const std::string &filename );
+
+	/**
+	 * Replay a recorded camera path with a fixed time step per frame instead of
+	 * the measured frame time. The window closes after the last frame. Call before render().
+	 */
+	void replay_camera_path( const std::string &filename, const double time_step );
+
 	/**
 	 * Call the scene's render() method to render objects in their order.
 	 */
@@ -57,6 +69,12 @@ private:
 
 	ui_overlay *m_overlay{ nullptr };
 
+	std::string m_recordFilename;
+
+	std::string m_replayFilename;
+
+	double m_replayTimeStep{ 1.0 / 60.0 };
+
 	/**
 	 * A stub now. In future, suitability checks should be done here.
 	 */
@@ -1,6 +1,7 @@
 
 #include <base/globals.h>
 #include <base/logbook.h>
+#include <base/profiler.h>
 #include <scene/scene.h>
 
 namespace orf_n {
@@ -25,9 +26,12 @@ void scene::prepareFrame() {
 }
 
 void scene::render() {
-	for( auto &e : m_ordered_renderables )
+	for( auto &e : m_ordered_renderables ) {
+		profiler::scoped_zone zone{ e.second->get_name().c_str(), true };
 		e.second->render();
+	}
 	// Render overlay last
+	profiler::scoped_zone zone{ m_overlay->get_name().c_str(), true };
 	m_overlay->render();
 }
 
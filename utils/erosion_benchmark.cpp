@@ -0,0 +1,315 @@
+/**
+ * Headless benchmark for the hydraulic erosion solver.
+ * Renders a number of frames on the default terrain and prints time per iteration,
+ * throughput in cells per second, memory usage and sums of terrain, water and sediment
+ * to compare runs with different settings. Fails if terrain and sediment together don't keep their volume.
+ *
+ * Params:
+ * grid width, grid height, number of frames
+ * Options:
+ * -t <count> number of threads, 0 (default) for one per hardware thread
+ * -s <seconds> simulated time per frame
+ * -f one fixed time step per frame instead of adaptive steps
+ * -r <frames> rain only during the first frames, then let the water run off
+ * -x scalar kernels only
+ * -l <count> strata of increasing hardness, 1m thick each, on bedrock
+ * -w <rate> thermal weathering with this part of the excess height per second
+ * -k <cells> out of core with tiles of this size, a frame is a round of iterations on all tiles
+ * -K <count> iterations per tile and round, default 8
+ * -m <levels> start with this many coarse grids, see MultigridErosion.h
+ * -M <seconds> simulated time per coarse grid, default 5
+ * -d <droplets> droplet erosion instead, the number of frames is ignored
+ * -c <frames> write a snapshot every this many frames to erosion_<iteration>.erosion
+ * -R <file> restart from a snapshot, see ErosionCheckpoint.h
+ *
+ * Build with src/ as include path, together with HydroErosionMDH07, TiledErosion, MultigridErosion, DropletErosion,
+ * ErosionCheckpoint, ErosionKernels, ErosionKernelsAVX2, thread_pool, logbook and renderable.
+ */
+
+#include "applications/TerrainErosion/DropletErosion.h"
+#include "applications/TerrainErosion/ErosionCheckpoint.h"
+#include "applications/TerrainErosion/HydroErosionMDH07.h"
+#include "applications/TerrainErosion/MultigridErosion.h"
+#include "applications/TerrainErosion/TiledErosion.h"
+#include "base/logbook.h"
+#include <sys/resource.h>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <iostream>
+#include <limits>
+#include <memory>
+#include <string>
+#include <vector>
+
+using namespace orf_n;
+
+namespace {
+
+// Peak resident set size of the process in kB
+long peakMemoryKB() {
+	rusage usage;
+	getrusage( RUSAGE_SELF, &usage );
+	return usage.ru_maxrss;
+}
+
+double sum( const ErosionField &field ) {
+	double total{ 0.0 };
+	for( uint32_t y{0}; y < field.getHeight(); ++y ) {
+		const float *const r{ field.row( y ) };
+		for( uint32_t x{0}; x < field.getWidth(); ++x )
+			total += r[x];
+	}
+	return total;
+}
+
+// Same terrain as HydroErosionMDH07::setup() for a grid of width x height
+void defaultTerrain( const uint32_t width, const uint32_t height, const float cellsize, const uint32_t x0,
+		const uint32_t y0, const uint32_t w, const uint32_t h, float *heights, const size_t stride ) {
+	const float amplitude{ 0.05f * std::max( width, height ) * cellsize };
+	const float pi{ 3.14159265f };
+	for( uint32_t y{0}; y < h; ++y )
+		for( uint32_t x{0}; x < w; ++x ) {
+			const float u{ static_cast<float>( x0 + x ) / width };
+			const float v{ static_cast<float>( y0 + y ) / height };
+			heights[y * stride + x] = amplitude * ( 0.5f + 0.25f * std::sin( 6.0f * pi * u ) * std::cos( 4.0f * pi * v ) +
+					0.25f * std::sin( 2.0f * pi * ( u + v ) ) );
+		}
+}
+
+// Erosion, deposition and transport only move material, the terrain loses what the sediment gains.
+// Float sums over the grid leave a rounding error, a part of the terrain volume.
+bool conservesMass( const double terrainBefore, const double terrainAfter, const double sediment ) {
+	const double error{ terrainAfter - terrainBefore + sediment };
+	if( std::abs( error ) <= 1e-6 * std::abs( terrainBefore ) )
+		return true;
+	std::cerr << "Terrain change + sediment is " << error << ", mass is not conserved\n";
+	return false;
+}
+
+double sum( const TiledErosion &erosion, const HydroErosionMDH07::stateField_t field, const uint32_t width,
+		const uint32_t height ) {
+	std::vector<float> row( width );
+	double total{ 0.0 };
+	for( uint32_t y{0}; y < height; ++y ) {
+		erosion.read( field, 0, y, width, 1, row.data(), width );
+		for( const float f : row )
+			total += f;
+	}
+	return total;
+}
+
+int runTiled( const TiledErosion::settings_t &settings, const unsigned long frames, const unsigned long rainFrames ) {
+	std::unique_ptr<TiledErosion> erosion;
+	try {
+		erosion = std::make_unique<TiledErosion>( settings );
+	} catch( std::exception &e ) {
+		std::cerr << e.what() << std::endl;
+		return EXIT_FAILURE;
+	}
+	const uint32_t width{ settings.width };
+	const uint32_t height{ settings.height };
+	erosion->setTerrain( [&]( const uint32_t x, const uint32_t y, const uint32_t w, const uint32_t h, float *heights,
+			const size_t stride ) {
+		defaultTerrain( width, height, settings.solver.cellsize, x, y, w, h, heights, stride );
+	} );
+	const double terrainBefore{ sum( *erosion, HydroErosionMDH07::TERRAIN, width, height ) };
+	uint64_t tiles{0};
+	const auto start{ std::chrono::steady_clock::now() };
+	for( unsigned long i{0}; i < frames; ++i ) {
+		if( i == rainFrames )
+			erosion->getSettings().solver.rainMultiplier = 0.0f;
+		tiles += erosion->round();
+	}
+	const double seconds{ std::chrono::duration<double>( std::chrono::steady_clock::now() - start ).count() };
+	const uint64_t iterations{ erosion->getIteration() };
+
+	const double cells{ static_cast<double>( width ) * height * iterations };
+	const double terrainAfter{ sum( *erosion, HydroErosionMDH07::TERRAIN, width, height ) };
+	const double sediment{ sum( *erosion, HydroErosionMDH07::SEDIMENT, width, height ) };
+	std::cout << "Grid " << width << 'x' << height << " in " << erosion->getNumberOfTiles() << " tiles, halo " <<
+			erosion->getHalo() << ", " << frames << " rounds, " << iterations << " iterations, " <<
+			erosion->getSimulatedTime() << "s simulated\n" <<
+			"Time: " << seconds << "s, per iteration " << seconds * 1000.0 / std::max<uint64_t>( 1, iterations ) << "ms\n" <<
+			"Throughput: " << cells / seconds * 1e-6 << " Mcells/s\n" <<
+			"Store: " << ( erosion->getSizeOfStore() >> 20 ) << "MB, solver " << ( erosion->getSizeInMemory() >> 20 ) <<
+			"MB, peak rss " << ( peakMemoryKB() >> 10 ) << "MB\n" <<
+			"Tiles simulated: " << tiles << " of " << frames * erosion->getNumberOfTiles() << '\n' <<
+			"Water: " << sum( *erosion, HydroErosionMDH07::WATER, width, height ) << '\n' <<
+			"Sediment: " << sediment << '\n' <<
+			"Terrain change + sediment: " << terrainAfter - terrainBefore + sediment << '\n';
+	return conservesMass( terrainBefore, terrainAfter, sediment ) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+int runDroplets( DropletErosion::settings_t &settings, const uint64_t droplets ) {
+	std::unique_ptr<DropletErosion> erosion;
+	try {
+		erosion = std::make_unique<DropletErosion>( settings );
+	} catch( std::exception &e ) {
+		std::cerr << e.what() << std::endl;
+		return EXIT_FAILURE;
+	}
+	std::vector<float> heights( static_cast<size_t>( settings.width ) * settings.height );
+	defaultTerrain( settings.width, settings.height, 1.0f, 0, 0, settings.width, settings.height, heights.data(),
+			settings.width );
+	erosion->setTerrain( heights.data() );
+	const double terrainBefore{ sum( erosion->getTerrain() ) };
+	const auto start{ std::chrono::steady_clock::now() };
+	erosion->erode( droplets );
+	const double seconds{ std::chrono::duration<double>( std::chrono::steady_clock::now() - start ).count() };
+	// Same seed, same bits
+	uint32_t checksum{0};
+	for( uint32_t y{0}; y < settings.height; ++y ) {
+		const float *const r{ erosion->getTerrain().row( y ) };
+		for( uint32_t x{0}; x < settings.width; ++x ) {
+			uint32_t bits;
+			std::memcpy( &bits, r + x, sizeof( bits ) );
+			checksum = ( checksum ^ bits ) * 16777619u;
+		}
+	}
+	std::cout << "Grid " << settings.width << 'x' << settings.height << ", " << droplets << " droplets\n" <<
+			"Time: " << seconds << "s, " << droplets / seconds * 1e-6 << " Mdroplets/s\n" <<
+			"Memory: " << ( erosion->getSizeInMemory() >> 20 ) << "MB, peak rss " << ( peakMemoryKB() >> 10 ) << "MB\n" <<
+			"Terrain change: " << sum( erosion->getTerrain() ) - terrainBefore << '\n' <<
+			"Checksum: " << std::hex << checksum << std::dec << '\n';
+	return EXIT_SUCCESS;
+}
+
+}	// namespace
+
+int main( int argc, char *argv[] ) {
+	TiledErosion::settings_t tiled;
+	HydroErosionMDH07::settings_t &settings{ tiled.solver };
+	unsigned long rainFrames{ std::numeric_limits<unsigned long>::max() };
+	bool tiledMode{ false };
+	MultigridErosion::settings_t multigrid;
+	uint64_t droplets{0};
+	unsigned long snapshotFrames{0};
+	std::string restartFile;
+	multigrid.levels = 0;
+	std::vector<std::string> params;
+	for( int i{1}; i < argc; ++i ) {
+		if( 0 == strcmp( argv[i], "-t" ) && i + 1 < argc )
+			settings.numberOfThreads = static_cast<unsigned int>( std::stoul( argv[++i] ) );
+		else if( 0 == strcmp( argv[i], "-s" ) && i + 1 < argc )
+			settings.timeStep = std::stof( argv[++i] );
+		else if( 0 == strcmp( argv[i], "-r" ) && i + 1 < argc )
+			rainFrames = std::stoul( argv[++i] );
+		else if( 0 == strcmp( argv[i], "-f" ) )
+			settings.adaptiveTimeStep = false;
+		else if( 0 == strcmp( argv[i], "-l" ) && i + 1 < argc )
+			settings.numberOfLayers = static_cast<uint32_t>( std::stoul( argv[++i] ) );
+		else if( 0 == strcmp( argv[i], "-w" ) && i + 1 < argc )
+			settings.thermalErosionConstant_KT = std::stof( argv[++i] );
+		else if( 0 == strcmp( argv[i], "-x" ) )
+			settings.useSimd = false;
+		else if( 0 == strcmp( argv[i], "-k" ) && i + 1 < argc ) {
+			tiled.tileSize = static_cast<uint32_t>( std::stoul( argv[++i] ) );
+			tiledMode = true;
+		}
+		else if( 0 == strcmp( argv[i], "-K" ) && i + 1 < argc )
+			tiled.iterationsPerRound = static_cast<uint32_t>( std::stoul( argv[++i] ) );
+		else if( 0 == strcmp( argv[i], "-d" ) && i + 1 < argc )
+			droplets = std::stoull( argv[++i] );
+		else if( 0 == strcmp( argv[i], "-m" ) && i + 1 < argc )
+			multigrid.levels = static_cast<uint32_t>( std::stoul( argv[++i] ) );
+		else if( 0 == strcmp( argv[i], "-M" ) && i + 1 < argc )
+			multigrid.timePerLevel = std::stof( argv[++i] );
+		else if( 0 == strcmp( argv[i], "-c" ) && i + 1 < argc )
+			snapshotFrames = std::stoul( argv[++i] );
+		else if( 0 == strcmp( argv[i], "-R" ) && i + 1 < argc )
+			restartFile = argv[++i];
+		else
+			params.push_back( argv[i] );
+	}
+	if( params.size() < 3 ) {
+		std::cerr << "Usage: erosion_benchmark [-t threads] [-s timestep] [-r frames] [-f] [-x] [-l strata] [-w rate] [-k tilesize] [-K iterations] [-m levels] [-M seconds] [-d droplets] [-c frames] [-R file] <width> <height> <frames>\n";
+		return EXIT_FAILURE;
+	}
+
+	logbook::set_log_filename( "erosion_benchmark.log" );
+	settings.width = static_cast<uint32_t>( std::stoul( params[0] ) );
+	settings.height = static_cast<uint32_t>( std::stoul( params[1] ) );
+	const unsigned long frames{ std::stoul( params[2] ) };
+	if( droplets > 0 ) {
+		DropletErosion::settings_t dropletSettings;
+		dropletSettings.width = settings.width;
+		dropletSettings.height = settings.height;
+		dropletSettings.numberOfThreads = settings.numberOfThreads;
+		return runDroplets( dropletSettings, droplets );
+	}
+	if( tiledMode ) {
+		tiled.width = settings.width;
+		tiled.height = settings.height;
+		return runTiled( tiled, frames, rainFrames );
+	}
+	for( uint32_t l{0}; l < settings.materials.size(); ++l )
+		settings.materials[l].hardness = static_cast<float>( 1u << l );
+	HydroErosionMDH07 erosion{ settings };
+	try {
+		erosion.setup();
+	} catch( std::exception &e ) {
+		std::cerr << e.what() << std::endl;
+		return EXIT_FAILURE;
+	}
+	for( uint32_t l{0}; l < settings.numberOfLayers; ++l )
+		erosion.getStateField( static_cast<HydroErosionMDH07::stateField_t>( HydroErosionMDH07::LAYER_0 + l ) ).fill( 1.0f );
+	// Before a restart, so the change covers the whole run from the default terrain on
+	double terrainBefore{ sum( erosion.getTerrain() ) };
+	if( !restartFile.empty() )
+		try {
+			ErosionCheckpoint{ restartFile }.restore( erosion );
+		} catch( std::exception &e ) {
+			std::cerr << e.what() << std::endl;
+			return EXIT_FAILURE;
+		}
+	const uint32_t width{ erosion.getTerrain().getWidth() };
+	const uint32_t height{ erosion.getTerrain().getHeight() };
+	if( width != settings.width || height != settings.height ) {
+		// The snapshot was taken on another grid size, compare with that grid's default terrain
+		std::vector<float> heights( static_cast<size_t>( width ) * height );
+		defaultTerrain( width, height, settings.cellsize, 0, 0, width, height, heights.data(), width );
+		terrainBefore = 0.0;
+		for( const float h : heights )
+			terrainBefore += h;
+	}
+	if( multigrid.levels > 0 ) {
+		const auto multigridStart{ std::chrono::steady_clock::now() };
+		MultigridErosion coarseToFine{ multigrid };
+		const uint64_t coarseIterations{ coarseToFine.run( erosion ) };
+		std::cout << "Multigrid: " << coarseToFine.getNumberOfLevels() << " levels, " << coarseIterations <<
+				" iterations, " << std::chrono::duration<double>( std::chrono::steady_clock::now() - multigridStart ).count() <<
+				"s\n";
+	}
+	ErosionSnapshotWriter snapshots;
+	const uint64_t firstIteration{ erosion.getIteration() };
+	const auto start{ std::chrono::steady_clock::now() };
+	for( unsigned long i{0}; i < frames; ++i ) {
+		if( i == rainFrames )
+			erosion.getSettings().rainMultiplier = 0.0f;
+		erosion.render();
+		if( snapshotFrames > 0 && 0 == ( i + 1 ) % snapshotFrames )
+			snapshots.write( erosion, "erosion_" + std::to_string( erosion.getIteration() ) + ".erosion" );
+	}
+	const double seconds{ std::chrono::duration<double>( std::chrono::steady_clock::now() - start ).count() };
+	const uint64_t iterations{ erosion.getIteration() - firstIteration };
+	snapshots.flush();
+
+	const double cells{ static_cast<double>( width ) * height * iterations };
+	const double terrainAfter{ sum( erosion.getTerrain() ) };
+	const double sediment{ sum( erosion.getSediment() ) };
+	std::cout << "Grid " << width << 'x' << height << ", " << frames << " frames, " <<
+			iterations << " iterations, " << erosion.getSimulatedTime() << "s simulated\n" <<
+			"Time: " << seconds << "s, per iteration " << seconds * 1000.0 / std::max<uint64_t>( 1, iterations ) << "ms\n" <<
+			"Throughput: " << cells / seconds * 1e-6 << " Mcells/s\n" <<
+			"Fields: " << ( erosion.getSizeInMemory() >> 20 ) << "MB, peak rss " << ( peakMemoryKB() >> 10 ) << "MB\n" <<
+			"Active blocks: " << erosion.getNumberOfActiveBlocks() << " of " << erosion.getNumberOfBlocks() << '\n' <<
+			"Water: " << sum( erosion.getWater() ) << '\n' <<
+			"Sediment: " << sediment << '\n' <<
+			"Terrain change + sediment: " << terrainAfter - terrainBefore + sediment << '\n';
+	if( snapshotFrames > 0 )
+		std::cout << "Snapshots: " << snapshots.getNumberOfWritten() << " written, " << snapshots.getNumberOfDropped() <<
+				" dropped, " << snapshots.getNumberOfFailed() << " failed\n";
+	erosion.cleanup();
+	return conservesMass( terrainBefore, terrainAfter, sediment ) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,183 @@
+/**
+ * Headless benchmark for the terrain LOD selection.
+ * Loads terrain tiles cpu side only (no window, no gl context, no texture upload),
+ * replays a recorded camera path and writes per frame selection times, node counts
+ * per LOD level, cull counts and memory usage as JSON.
+ *
+ * Params:
+ * camera path file, a binary log as recorded by orf_n --record, see camera_path.h
+ * output JSON file
+ * one or more tile basenames as for TerrainTile (without .png/.bb)
+ * Options:
+ * -n disable horizon occlusion culling
+ * -r <count> replay the path count times, the fastest time per frame is reported
+ *
+ * Build with src/ and extern/ as include paths, together with the terrain_lod sources
+ * (without TerrainLOD.cpp), camera, camera_path, event_handler, glfw_window, logbook, view_frustum,
+ * renderer program and module, glad and stb_image. The glfw library must be linked but no window is opened.
+ */
+
+#include "applications/camera/camera.h"
+#include "applications/camera/camera_path.h"
+#include "applications/terrain_lod/LODSelection.h"
+#include "applications/terrain_lod/quadtree.h"
+#include "applications/terrain_lod/TerrainTile.h"
+#include "base/globals.h"
+#include "base/logbook.h"
+#include <sys/resource.h>
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <limits>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+using namespace orf_n;
+
+double globals::delta_time = 0.0;
+bool globals::show_app_ui = false;
+
+namespace benchmark {
+
+// Same as the renderer's default window
+static const float ASPECT_RATIO{ 1600.0f / 900.0f };
+
+struct frameResult_t {
+	double selectionMicroseconds{ std::numeric_limits<double>::max() };
+	int selectedNodes{ 0 };
+	int culledNodes{ 0 };
+	int occludedNodes{ 0 };
+	int nodesPerLODLevel[terrain::NUMBER_OF_LOD_LEVELS + 1]{};
+};
+
+// Peak resident set size of the process in kB
+static long peakMemoryKB() {
+	rusage usage;
+	getrusage( RUSAGE_SELF, &usage );
+	return usage.ru_maxrss;
+}
+
+static void writeJSON( std::ostream &o, const std::vector<frameResult_t> &results,
+		const std::vector<terrain::TerrainTile *> &tiles, const bool occlusionCulling, const int repeats ) {
+	std::vector<double> times;
+	for( const frameResult_t &r : results )
+		times.push_back( r.selectionMicroseconds );
+	std::sort( times.begin(), times.end() );
+	double total{ 0.0 };
+	for( const double t : times )
+		total += t;
+	size_t heightmapBytes{ 0 };
+	size_t quadTreeBytes{ 0 };
+	for( const terrain::TerrainTile *t : tiles ) {
+		heightmapBytes += t->getHeightMap()->getSizeInMemory();
+		quadTreeBytes += t->getQuadTree()->getSizeInMemory();
+	}
+	o << "{\n";
+	o << "\t\"tiles\": " << tiles.size() << ",\n";
+	o << "\t\"occlusion_culling\": " << ( occlusionCulling ? "true" : "false" ) << ",\n";
+	o << "\t\"repeats\": " << repeats << ",\n";
+	o << "\t\"frames\": " << results.size() << ",\n";
+	o << "\t\"selection_us\": { \"total\": " << total << ", \"mean\": " << total / times.size() <<
+			", \"min\": " << times.front() << ", \"median\": " << times[times.size() / 2] <<
+			", \"max\": " << times.back() << " },\n";
+	o << "\t\"memory\": { \"heightmaps_bytes\": " << heightmapBytes << ", \"quad_trees_bytes\": " <<
+			quadTreeBytes << ", \"peak_rss_kb\": " << peakMemoryKB() << " },\n";
+	o << "\t\"per_frame\": [\n";
+	for( size_t i{0}; i < results.size(); ++i ) {
+		const frameResult_t &r{ results[i] };
+		o << "\t\t{ \"frame\": " << i << ", \"selection_us\": " << r.selectionMicroseconds <<
+				", \"selected\": " << r.selectedNodes << ", \"culled\": " << r.culledNodes <<
+				", \"occluded\": " << r.occludedNodes << ", \"nodes_per_lod\": [";
+		for( int l{0}; l <= terrain::NUMBER_OF_LOD_LEVELS; ++l )
+			o << r.nodesPerLODLevel[l] << ( l < terrain::NUMBER_OF_LOD_LEVELS ? ", " : "" );
+		o << "] }" << ( i + 1 < results.size() ? "," : "" ) << '\n';
+	}
+	o << "\t]\n}\n";
+}
+
+}	// namespace
+
+int main( int argc, char *argv[] ) {
+	bool occlusionCulling{ true };
+	int repeats{ 1 };
+	std::vector<std::string> params;
+	for( int i{1}; i < argc; ++i ) {
+		if( 0 == strcmp( argv[i], "-n" ) )
+			occlusionCulling = false;
+		else if( 0 == strcmp( argv[i], "-r" ) && i + 1 < argc )
+			repeats = std::max( 1, std::stoi( argv[++i] ) );
+		else
+			params.push_back( argv[i] );
+	}
+	if( params.size() < 3 ) {
+		std::cerr << "Usage: lod_benchmark [-n] [-r count] <camera path> <output json> <tile> [tile ...]\n";
+		return EXIT_FAILURE;
+	}
+
+	logbook::set_log_filename( "lod_benchmark.log" );
+	std::vector<camera_path::frame_t> path;
+	std::vector<terrain::TerrainTile *> tiles;
+	try {
+		camera_path log;
+		log.load( params[0] );
+		camera_path::frame_t frame;
+		while( log.next_frame( frame ) )
+			path.push_back( frame );
+		if( path.empty() )
+			throw std::runtime_error{ "Benchmark: camera path '" + params[0] + "' has no frames" };
+		for( size_t i{2}; i < params.size(); ++i )
+			tiles.push_back( new terrain::TerrainTile{ params[i], false /*no upload*/ } );
+	} catch( std::runtime_error &e ) {
+		std::cerr << e.what() << std::endl;
+		return EXIT_FAILURE;
+	}
+
+	camera cam{ benchmark::ASPECT_RATIO, path[0].position, path[0].target, path[0].up,
+				path[0].near_plane, path[0].far_plane, static_cast<camera::camera_mode_t>( path[0].mode ) };
+	terrain::LODSelection *selection{ new terrain::LODSelection{ &cam, false /*don't sort*/ } };
+	selection->m_occlusionCulling = occlusionCulling;
+
+	std::vector<benchmark::frameResult_t> results( path.size() );
+	for( int r{0}; r < repeats; ++r ) {
+		for( size_t i{0}; i < path.size(); ++i ) {
+			const camera_path::frame_t &f{ path[i] };
+			// Camera setup is not part of the measurement
+			const bool rangesChanged{ f.near_plane != cam.get_near_plane() || f.far_plane != cam.get_far_plane() };
+			cam.set_path_frame( f );
+			if( rangesChanged )
+				selection->calculateRanges();
+
+			const auto start{ std::chrono::steady_clock::now() };
+			selection->select( tiles );
+			const auto end{ std::chrono::steady_clock::now() };
+
+			benchmark::frameResult_t &result{ results[i] };
+			result.selectionMicroseconds = std::min( result.selectionMicroseconds,
+					std::chrono::duration<double, std::micro>( end - start ).count() );
+			result.selectedNodes = selection->m_selectionCount;
+			result.culledNodes = selection->m_culledCount;
+			result.occludedNodes = selection->m_occludedCount;
+			std::fill( result.nodesPerLODLevel, result.nodesPerLODLevel + terrain::NUMBER_OF_LOD_LEVELS + 1, 0 );
+			for( int n{0}; n < selection->m_selectionCount; ++n )
+				++result.nodesPerLODLevel[ omath::clamp( selection->m_selectedNodes[n].lodLevel, 0,
+						terrain::NUMBER_OF_LOD_LEVELS ) ];
+		}
+	}
+
+	std::ofstream outFile{ params[1] };
+	if( !outFile.is_open() ) {
+		std::cerr << "Benchmark: error opening output file '" << params[1] << "'\n";
+		return EXIT_FAILURE;
+	}
+	benchmark::writeJSON( outFile, results, tiles, occlusionCulling, repeats );
+	outFile.close();
+	std::cout << "Benchmark: " << path.size() << " frames written to '" << params[1] << "'\n";
+
+	delete selection;
+	for( terrain::TerrainTile *t : tiles )
+		delete t;
+	return EXIT_SUCCESS;
+}
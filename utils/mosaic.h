@@ -0,0 +1,250 @@
+
+/**
+ * Mosaic mode of the converter: cuts one global tile grid over the union of several rasters,
+ * e.g. adjacent srtm cells, so tiles are aligned and share their seams across input files.
+ *
+ * Params:
+ * names of the input rasters, see raster_input.h for the formats. All must have the same cellsize.
+ * tile size, default 2048
+ * reference ellipsoid semi major axis, default WGS84
+ * reference ellipsoid semi minor axis
+ * output format, see tile_writer.h
+ * fill no data voids instead of setting them to 0, see void_fill.h, default false
+ * write overview tiles of lower resolution, see overviews.h, default false
+ * name of the scratch file, default mosaic.scratch in the working directory
+ *
+ * Each input is streamed once into a scratch file on disk that holds the heights of the global grid.
+ * Posts that more than one input cover, like the shared edges of .hgt cells, are written by the later
+ * one. Posts no input covers stay 0, like no data. Voids are filled on the mapped scratch file,
+ * where the rows below a tile are already available for its halo. The scratch file is then mapped and its tiles are
+ * cut band by band, exactly like asc2png() does for one input. Resident memory is bounded by a chunk
+ * of input rows and two bands of the mapped scratch file, not by the size of the mosaic.
+ */
+
+#pragma once
+
+#include <chrono>
+#include <cmath>
+#include <iostream>
+#include <string>
+#include <vector>
+#include "omath/vec3.h"
+#include "geometry/geodetic.h"
+#include "geometry/ellipsoid.h"
+#include "overviews.h"
+#include "raster_input.h"
+#include "tile_writer.h"
+#include "void_fill.h"
+#include "base/thread_pool.h"
+
+namespace converter {
+
+// Position of an input in the global grid, row 0 is the northernmost row
+struct mosaicInput_t {
+	std::string filename;
+	rasterHeader_t header;
+	int64_t firstRow;
+	int64_t firstColumn;
+};
+
+/* Read the headers of all inputs and lay out the global grid over their union.
+ * The returned header describes the global grid. */
+static bool layoutMosaic( const std::vector<std::string> &inFilenames, const uint16_t tilesize,
+		std::vector<mosaicInput_t> &inputs, rasterHeader_t &grid ) {
+	inputs.clear();
+	double minLong{ 0.0 }, maxLong{ 0.0 }, minLat{ 0.0 }, maxLat{ 0.0 };
+	for( const std::string &filename : inFilenames ) {
+		rasterInput_t in;
+		std::cout << "\nReading header of raster file '" << filename << "':\n";
+		// Open with the smallest tile size, a single input may be smaller than a tile
+		if( !openRaster( filename, 1, in ) )
+			return false;
+		const rasterHeader_t h{ in.header };
+		closeRaster( in );
+		const double right{ h.llLong + h.numberOfColumns * h.cellsize };
+		const double top{ h.llLat + h.numberOfRows * h.cellsize };
+		if( inputs.empty() ) {
+			grid = h;
+			minLong = h.llLong;
+			minLat = h.llLat;
+			maxLong = right;
+			maxLat = top;
+		} else if( std::abs( h.cellsize - grid.cellsize ) > 1e-6 * grid.cellsize ) {
+			std::cerr << "Converter: cellsize of '" << filename << "' differs from the first input's\n";
+			return false;
+		}
+		minLong = std::min( minLong, h.llLong );
+		minLat = std::min( minLat, h.llLat );
+		maxLong = std::max( maxLong, right );
+		maxLat = std::max( maxLat, top );
+		inputs.push_back( mosaicInput_t{ filename, h, 0, 0 } );
+	}
+	if( inputs.empty() ) {
+		std::cerr << "Converter: no input rasters\n";
+		return false;
+	}
+	grid.llLong = minLong;
+	grid.llLat = minLat;
+	grid.numberOfColumns = static_cast<uint32_t>( std::lround( ( maxLong - minLong ) / grid.cellsize ) );
+	grid.numberOfRows = static_cast<uint32_t>( std::lround( ( maxLat - minLat ) / grid.cellsize ) );
+	grid.tilesize = tilesize;
+	if( grid.numberOfColumns < tilesize || grid.numberOfRows < tilesize ) {
+		std::cerr << "Error, tile size > size of the mosaic\n";
+		return false;
+	}
+	for( mosaicInput_t &input : inputs ) {
+		const double column{ ( input.header.llLong - minLong ) / grid.cellsize };
+		const double row{ ( maxLat - ( input.header.llLat + input.header.numberOfRows * grid.cellsize ) ) / grid.cellsize };
+		input.firstColumn = std::llround( column );
+		input.firstRow = std::llround( row );
+		if( std::abs( column - input.firstColumn ) > 0.01 || std::abs( row - input.firstRow ) > 0.01 )
+			std::cerr << "Converter: warning, '" << input.filename << "' is not aligned to the grid, snapped\n";
+	}
+	return true;
+}
+
+/* Stream one input into the scratch file, clipped to the used part of the grid.
+ * Rows are read in chunks into buffer and written with one pwrite per row. */
+static bool streamIntoScratch( orf_n::thread_pool &pool, const mosaicInput_t &input, const uint32_t usedRows,
+		const uint32_t usedColumns, const bool fillVoids, const int scratch, std::vector<uint16_t> &buffer ) {
+	if( input.firstRow >= usedRows || input.firstColumn >= usedColumns )
+		return true;
+	rasterInput_t in;
+	if( !openRaster( input.filename, 1, in ) )
+		return false;
+	in.noDataHeight = fillVoids ? VOID_HEIGHT : 0;
+	const uint32_t rows{ static_cast<uint32_t>( std::min<int64_t>( in.header.numberOfRows, usedRows - input.firstRow ) ) };
+	const uint32_t columns{ static_cast<uint32_t>( std::min<int64_t>( in.header.numberOfColumns, usedColumns - input.firstColumn ) ) };
+	buffer.resize( static_cast<size_t>( ROWS_PER_CHUNK ) * columns );
+	bool success{ true };
+	for( uint32_t chunkRow{0}; chunkRow < rows && success; chunkRow += ROWS_PER_CHUNK ) {
+		const uint32_t numRows{ std::min( ROWS_PER_CHUNK, rows - chunkRow ) };
+		success = readRows( pool, in, buffer.data(), columns, columns, numRows );
+		for( uint32_t r{0}; r < numRows && success; ++r ) {
+			const uint64_t offset{ ( ( input.firstRow + chunkRow + r ) * static_cast<uint64_t>( usedColumns ) +
+				input.firstColumn ) * sizeof( uint16_t ) };
+			const ssize_t size{ static_cast<ssize_t>( columns * sizeof( uint16_t ) ) };
+			success = size == pwrite( scratch, buffer.data() + r * static_cast<size_t>( columns ), size, offset );
+		}
+	}
+	if( !success )
+		std::cerr << "Converter: error streaming '" << input.filename << "' into the scratch file\n";
+	closeRaster( in );
+	return success;
+}
+
+static bool mosaic(
+		const std::vector<std::string> &inFilenames,
+		const uint16_t tilesize = 2048,
+		const double semiMajorAxis = 6378137.0,
+		const double semiMinorAxis = 6356752.314245,
+		const outputFormat_t format = PNG,
+		const bool fillVoids = false,
+		const bool overviews = false,
+		const std::string &scratchFilename = "mosaic.scratch" ) {
+
+	if( !omath::is_power_of_2( tilesize ) || tilesize < 256 || tilesize > 8192 ) {
+		std::cerr << "Converter: Tilesize must be power of 2 and between 256 and 8192\n";
+		return false;
+	}
+	if( semiMajorAxis <= 0.0 ) {
+		std::cerr << "Converter: Semi major axis must be > 0.0\n";
+		return false;
+	}
+	if( semiMinorAxis <= 0.0 || semiMinorAxis > semiMajorAxis ) {
+		std::cerr << "Semi minor axis must be > 0.0 and <= semi major axis\n";
+		return false;
+	}
+	std::cout << "Converter, mosaic of " << inFilenames.size() << " rasters:\n";
+	std::cout << "\ttile size: " << tilesize << '\n';
+	std::cout << "\tsemi major axis of reference ellipsoid: " << semiMajorAxis << '\n';
+	std::cout << "\tsemi minor axis of reference ellipsoid: " << semiMinorAxis << '\n';
+	std::cout << "\toutput format: " << fileExtension( format ) << '\n';
+	std::cout << "\tfill voids: " << ( fillVoids ? "yes" : "no" ) << '\n';
+	std::cout << "\toverviews: " << ( overviews ? "yes" : "no" ) << '\n';
+	std::cout << "\tscratch file: '" << scratchFilename << "'\n";
+
+	const auto startTime{ std::chrono::steady_clock::now() };
+	std::vector<mosaicInput_t> inputs;
+	rasterHeader_t grid;
+	if( !layoutMosaic( inFilenames, tilesize, inputs, grid ) )
+		return false;
+	std::cout << "\nMosaic columns/rows: " << grid.numberOfColumns << '/' << grid.numberOfRows <<
+			"\nLower left longitude/latitude: " << grid.llLong << '/' << grid.llLat << '\n';
+
+	omath::dvec3 axes{ semiMajorAxis, semiMajorAxis, semiMinorAxis };
+	orf_n::ellipsoid eps{ axes };
+	omath::dvec3 llCartesian{
+		eps.to_cartesian( orf_n::geodetic{ omath::radians( grid.llLat ), omath::radians( grid.llLong ) } )
+	};
+	std::cout << "Lower left in cartesian coords: " << std::fixed << llCartesian << std::endl;
+
+	const uint32_t numberOfHTiles{ grid.numberOfColumns / tilesize };
+	const uint32_t numberOfVTiles{ grid.numberOfRows / tilesize };
+	std::cout << "Number of tiles horizontal/vertical: " << numberOfHTiles << '/' << numberOfVTiles << '\n';
+	// Same tile layout as asc2png(): tiles share their edge posts, rows and columns beyond the last tile are unused
+	const uint32_t usedColumns{ numberOfHTiles * ( tilesize - 1 ) + 1 };
+	const uint32_t usedRows{ numberOfVTiles * ( tilesize - 1 ) + 1 };
+	const uint64_t scratchSize{ static_cast<uint64_t>( usedRows ) * usedColumns * sizeof( uint16_t ) };
+
+	// Sparse, posts no input covers read as 0
+	const int scratch{ open( scratchFilename.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644 ) };
+	if( scratch < 0 || 0 != ftruncate( scratch, static_cast<off_t>( scratchSize ) ) ) {
+		std::cerr << "Converter: error creating scratch file '" << scratchFilename << "'\n";
+		if( scratch >= 0 )
+			close( scratch );
+		return false;
+	}
+	// The calling thread reads and waits, a worker per hardware thread besides it
+	orf_n::thread_pool pool{ std::max( 1u, std::thread::hardware_concurrency() ) + 1 };
+	bool success{ true };
+	{
+		std::vector<uint16_t> buffer;
+		for( size_t i{0}; i < inputs.size() && success; ++i ) {
+			std::cout << "Streaming '" << inputs[i].filename << "' into the mosaic at row/column " <<
+					inputs[i].firstRow << '/' << inputs[i].firstColumn << std::endl;
+			success = streamIntoScratch( pool, inputs[i], usedRows, usedColumns, fillVoids, scratch, buffer );
+		}
+	}
+	if( success && fillVoids ) {
+		std::cout << "Filling voids ..." << std::endl;
+		void *const p{ mmap( nullptr, scratchSize, PROT_READ | PROT_WRITE, MAP_SHARED, scratch, 0 ) };
+		if( MAP_FAILED == p ) {
+			std::cerr << "Converter: error mapping scratch file '" << scratchFilename << "'\n";
+			success = false;
+		} else {
+			converter::fillVoids( pool, static_cast<uint16_t *>( p ), usedColumns, usedRows, usedColumns, tilesize );
+			munmap( p, scratchSize );
+		}
+	}
+	close( scratch );
+	mappedFile_t scratchFile;
+	if( success && !mapFile( scratchFilename, scratchFile ) ) {
+		std::cerr << "Converter: error mapping scratch file '" << scratchFilename << "'\n";
+		success = false;
+	}
+
+	// Tiles are cut straight from the mapping
+	std::cout << "Converting images with " << pool.get_number_of_threads() << " threads ..." << std::endl;
+	success = success && cutTiles( pool, scratchFile, reinterpret_cast<const uint16_t *>( scratchFile.data ),
+			nullptr, nullptr, usedColumns, numberOfHTiles, numberOfVTiles, grid, format );
+	if( success && overviews ) {
+		std::cout << "Building overviews ..." << std::endl;
+		std::vector<dataExtent_t> extents;
+		for( const mosaicInput_t &input : inputs )
+			extents.push_back( { input.firstRow, input.firstColumn, input.header.numberOfRows, input.header.numberOfColumns } );
+		success = writeOverviews( pool, scratchFile, usedRows, usedColumns, extents, grid, format, scratchFilename );
+	}
+	unmapFile( scratchFile );
+	std::remove( scratchFilename.c_str() );
+	if( !success )
+		return false;
+
+	const double seconds{ std::chrono::duration<double>( std::chrono::steady_clock::now() - startTime ).count() };
+	std::cout << "Converted " << numberOfHTiles * numberOfVTiles << " tiles from " << inputs.size() <<
+			" rasters in " << seconds << "s\n";
+	std::cout << "Program ending" << std::endl;
+	return true;
+}
+
+}	// namespace
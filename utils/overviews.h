@@ -0,0 +1,213 @@
+
+/**
+ * Overview tiles for the converter: a pyramid of levels of half the resolution of the level below,
+ * cut into tiles of the same size as the full resolution ones, so distant terrain can be drawn from
+ * a few coarse tiles. Level k tiles are written as tile_<tilesize>_L<k>_<number>.
+ *
+ * Each level lives in a scratch file with three planes: averaged heights to display, and minimum
+ * and maximum heights for the bounds. Post (r, c) of a level lies on post (2r, 2c) of the level below.
+ * Its height is the 1-2-1 tent filtered average of the 3x3 posts around it, its minimum and maximum
+ * those of the 3x3 posts, so bounds enclose all full resolution heights of a tile. Posts outside the
+ * level below repeat its edge. Full resolution posts outside the data extents, like the gaps between
+ * the inputs of a mosaic that read as 0, are left out of averages and bounds. A post with none of
+ * them has height 0 and an empty range, minimum above maximum. Levels are built bottom up, the rows
+ * of a level in parallel, until a level fits into one tile.
+ */
+
+#pragma once
+
+#include "raster_input.h"
+#include "tile_writer.h"
+#include "base/thread_pool.h"
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <iostream>
+#include <string>
+#include <vector>
+
+namespace converter {
+
+// Rectangle of full resolution posts that hold data
+struct dataExtent_t {
+	int64_t firstRow;
+	int64_t firstColumn;
+	int64_t numberOfRows;
+	int64_t numberOfColumns;
+};
+
+// One level of the pyramid, mapped from its scratch file
+struct overviewLevel_t {
+	std::string filename;
+	mappedFile_t file;
+	uint32_t numberOfRows;
+	uint32_t numberOfColumns;
+	uint32_t numberOfHTiles;
+	uint32_t numberOfVTiles;
+	uint16_t *heights;
+	uint16_t *minHeights;
+	uint16_t *maxHeights;
+};
+
+// Sparse scratch file of three planes, mapped for writing
+static bool createOverviewLevel( const std::string &filename, const uint32_t numberOfVTiles,
+		const uint32_t numberOfHTiles, const uint16_t tilesize, overviewLevel_t &level ) {
+	level.filename = filename;
+	level.numberOfVTiles = numberOfVTiles;
+	level.numberOfHTiles = numberOfHTiles;
+	level.numberOfRows = numberOfVTiles * ( tilesize - 1u ) + 1;
+	level.numberOfColumns = numberOfHTiles * ( tilesize - 1u ) + 1;
+	const size_t planeSize{ static_cast<size_t>( level.numberOfRows ) * level.numberOfColumns };
+	level.file = mappedFile_t{};
+	level.file.size = 3 * planeSize * sizeof( uint16_t );
+	level.file.fd = open( filename.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644 );
+	if( level.file.fd < 0 || 0 != ftruncate( level.file.fd, static_cast<off_t>( level.file.size ) ) ) {
+		std::cerr << "Converter: error creating scratch file '" << filename << "'\n";
+		unmapFile( level.file );
+		return false;
+	}
+	void *p{ mmap( nullptr, level.file.size, PROT_READ | PROT_WRITE, MAP_SHARED, level.file.fd, 0 ) };
+	if( MAP_FAILED == p ) {
+		std::cerr << "Converter: error mapping scratch file '" << filename << "'\n";
+		unmapFile( level.file );
+		return false;
+	}
+	level.file.data = static_cast<const char *>( p );
+	level.heights = static_cast<uint16_t *>( p );
+	level.minHeights = level.heights + planeSize;
+	level.maxHeights = level.minHeights + planeSize;
+	return true;
+}
+
+static void releaseOverviewLevel( overviewLevel_t &level ) {
+	unmapFile( level.file );
+	std::remove( level.filename.c_str() );
+}
+
+/* Downsample rows [firstRow, lastRow) of a level from the planes of the level below.
+ * The full resolution level has one plane, heights, minimum and maximum are the same, and its posts
+ * with data are those within extents. Above it, posts with data have a range. */
+static void downsampleRows( const uint16_t *heights, const uint16_t *minHeights, const uint16_t *maxHeights,
+		const uint32_t numberOfRows, const uint32_t numberOfColumns, const std::vector<dataExtent_t> *extents,
+		overviewLevel_t &level, const uint32_t firstRow, const uint32_t lastRow ) {
+	static const uint32_t weights[3]{ 1, 2, 1 };
+	const size_t stride{ numberOfColumns };
+	std::vector<uint32_t> columns( level.numberOfColumns * 3 );
+	for( uint32_t c{0}; c < level.numberOfColumns; ++c )
+		for( uint32_t i{0}; i < 3; ++i )
+			columns[3 * c + i] = std::min( static_cast<uint32_t>( std::max( 2 * static_cast<int64_t>( c ) + i - 1, int64_t{ 0 } ) ),
+					numberOfColumns - 1 );
+	// Full resolution posts with data in the 3 source rows
+	std::vector<uint8_t> hasData[3];
+	for( uint32_t r{ firstRow }; r < lastRow; ++r ) {
+		uint32_t rows[3];
+		for( uint32_t i{0}; i < 3; ++i )
+			rows[i] = std::min( static_cast<uint32_t>( std::max( 2 * static_cast<int64_t>( r ) + i - 1, int64_t{ 0 } ) ),
+					numberOfRows - 1 );
+		if( nullptr != extents )
+			for( uint32_t i{0}; i < 3; ++i ) {
+				hasData[i].assign( numberOfColumns, 0 );
+				for( const dataExtent_t &e : *extents )
+					if( rows[i] >= e.firstRow && rows[i] < e.firstRow + e.numberOfRows )
+						std::fill( hasData[i].begin() + std::clamp<int64_t>( e.firstColumn, 0, numberOfColumns ),
+								hasData[i].begin() + std::clamp<int64_t>( e.firstColumn + e.numberOfColumns, 0, numberOfColumns ), 1 );
+			}
+		const size_t out{ static_cast<size_t>( r ) * level.numberOfColumns };
+		for( uint32_t c{0}; c < level.numberOfColumns; ++c ) {
+			uint32_t sum{ 0 };
+			uint32_t weightSum{ 0 };
+			uint16_t minValue{ 65535 };
+			uint16_t maxValue{ 0 };
+			for( uint32_t y{0}; y < 3; ++y )
+				for( uint32_t x{0}; x < 3; ++x ) {
+					const uint32_t column{ columns[3 * c + x] };
+					const size_t i{ rows[y] * stride + column };
+					if( nullptr != extents ? 0 == hasData[y][column] : minHeights[i] > maxHeights[i] )
+						continue;
+					sum += weights[y] * weights[x] * heights[i];
+					weightSum += weights[y] * weights[x];
+					minValue = std::min( minValue, minHeights[i] );
+					maxValue = std::max( maxValue, maxHeights[i] );
+				}
+			level.heights[out + c] = 0 != weightSum ? static_cast<uint16_t>( ( sum + weightSum / 2 ) / weightSum ) : 0;
+			level.minHeights[out + c] = minValue;
+			level.maxHeights[out + c] = maxValue;
+		}
+	}
+}
+
+// Build a level from the one below it, in parallel over chunks of rows
+static void downsampleLevel( orf_n::thread_pool &pool, const mappedFile_t &sourceFile, const uint16_t *heights,
+		const uint16_t *minHeights, const uint16_t *maxHeights, const uint32_t numberOfRows,
+		const uint32_t numberOfColumns, const std::vector<dataExtent_t> *extents, overviewLevel_t &level ) {
+	const size_t stride{ numberOfColumns };
+	for( uint32_t chunkRow{0}; chunkRow < level.numberOfRows; chunkRow += ROWS_PER_CHUNK ) {
+		const uint32_t chunkEnd{ std::min( chunkRow + ROWS_PER_CHUNK, level.numberOfRows ) };
+		const size_t numJobs{ std::min<size_t>( pool.get_number_of_threads(), chunkEnd - chunkRow ) };
+		std::vector<std::future<bool>> jobs;
+		for( size_t j{0}; j < numJobs; ++j ) {
+			jobs.push_back( pool.submit( [&, j]() {
+				const uint32_t first{ chunkRow + static_cast<uint32_t>( ( chunkEnd - chunkRow ) * j / numJobs ) };
+				const uint32_t last{ chunkRow + static_cast<uint32_t>( ( chunkEnd - chunkRow ) * ( j + 1 ) / numJobs ) };
+				downsampleRows( heights, minHeights, maxHeights, numberOfRows, numberOfColumns, extents, level, first, last );
+				return true;
+			} ) );
+		}
+		orf_n::thread_pool::wait_for( jobs );
+		// Source rows above the next chunk's first source row are done
+		const size_t doneRows{ std::min<size_t>( 2 * static_cast<size_t>( chunkEnd ) - 1, numberOfRows ) };
+		for( const uint16_t *plane : { heights, minHeights, maxHeights } )
+			releaseMappedRange( sourceFile, reinterpret_cast<const char *>( plane ),
+					reinterpret_cast<const char *>( plane + doneRows * stride ) );
+	}
+}
+
+/* Build the overview levels above a full resolution grid of numberOfRows x numberOfColumns mapped heights
+ * and write their tiles. Only posts within extents hold data. Scratch files are named after scratchFilename. */
+static bool writeOverviews( orf_n::thread_pool &pool, const mappedFile_t &file, const uint32_t numberOfRows,
+		const uint32_t numberOfColumns, const std::vector<dataExtent_t> &extents, const rasterHeader_t &grid,
+		const outputFormat_t format, const std::string &scratchFilename ) {
+	const uint16_t tilesize{ grid.tilesize };
+	const uint16_t *heights{ reinterpret_cast<const uint16_t *>( file.data ) };
+	const uint16_t *minHeights{ heights };
+	const uint16_t *maxHeights{ heights };
+	const mappedFile_t *sourceFile{ &file };
+	uint32_t rows{ numberOfRows };
+	uint32_t columns{ numberOfColumns };
+	overviewLevel_t levels[2];
+	bool success{ true };
+	for( uint32_t l{1}; success && ( rows > tilesize || columns > tilesize ); ++l ) {
+		overviewLevel_t &level{ levels[l % 2] };
+		// Posts of this level covering the level below, in whole tiles
+		const uint32_t levelRows{ rows / 2 + 1 };
+		const uint32_t levelColumns{ columns / 2 + 1 };
+		const uint32_t numberOfVTiles{ std::max( 1u, ( levelRows - 1 + tilesize - 2 ) / ( tilesize - 1u ) ) };
+		const uint32_t numberOfHTiles{ std::max( 1u, ( levelColumns - 1 + tilesize - 2 ) / ( tilesize - 1u ) ) };
+		success = createOverviewLevel( scratchFilename + ".L" + std::to_string( l ), numberOfVTiles, numberOfHTiles,
+				tilesize, level );
+		if( !success )
+			break;
+		downsampleLevel( pool, *sourceFile, heights, minHeights, maxHeights, rows, columns, 1 == l ? &extents : nullptr,
+				level );
+		if( 1 < l )
+			releaseOverviewLevel( levels[( l + 1 ) % 2] );
+		{
+			std::lock_guard<std::mutex> lock{ consoleMutex };
+			std::cout << "Overview level " << l << ": " << numberOfHTiles << '/' << numberOfVTiles << " tiles\n";
+		}
+		success = cutTiles( pool, level.file, level.heights, level.minHeights, level.maxHeights, level.numberOfColumns,
+				numberOfHTiles, numberOfVTiles, grid, format, l );
+		heights = level.heights;
+		minHeights = level.minHeights;
+		maxHeights = level.maxHeights;
+		sourceFile = &level.file;
+		rows = level.numberOfRows;
+		columns = level.numberOfColumns;
+	}
+	for( overviewLevel_t &level : levels )
+		if( nullptr != level.file.data )
+			releaseOverviewLevel( level );
+	return success;
+}
+
+}	// namespace
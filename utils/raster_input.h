@@ -0,0 +1,683 @@
+
+/**
+ * Elevation raster input for the converter.
+ * Supported: ESRI ascii grid (.asc), BIL/BIP/BSQ with an ESRI .hdr sidecar (.bil, .bip, .bsq),
+ * raw big endian int16 SRTM cells (.hgt) and uncompressed, strip organized GeoTIFF (.tif, .tiff)
+ * with one 16 bit integer sample per pixel, or the first band of several.
+ * Files are memory mapped. Rows are read in order from the top (north), binary rows are converted
+ * straight from the mapping, with a simd byte swap if the file isn't little endian.
+ * No data and negative values become 0, see parseAsciiRow(). No data can instead be marked as
+ * VOID_HEIGHT, to be filled later, see void_fill.h.
+ */
+
+#pragma once
+
+#include "base/thread_pool.h"
+#include <algorithm>
+#include <atomic>
+#include <cctype>
+#include <charconv>		// from_chars
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <mutex>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include <fcntl.h>		// open
+#include <sys/mman.h>	// mmap
+#include <sys/stat.h>
+#include <unistd.h>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+namespace converter {
+
+// header info of an input raster; the ascii header fields, other formats are mapped to them
+struct rasterHeader_t {
+	uint32_t numberOfColumns;
+	uint32_t numberOfRows;
+	// Lower left corner of the lower left cell
+	double llLong;
+	double llLat;
+	// Distance between posts in degrees
+	double cellsize;
+	int noDataValue;
+	bool hasNoData;
+	uint16_t tilesize;
+};
+
+// Marks no data samples to be filled; real heights are clamped below it
+static const uint16_t VOID_HEIGHT{ 65535 };
+
+// Rows of text parsed in parallel between releases of the mapped input
+static const uint32_t ROWS_PER_CHUNK{ 256 };
+
+// Serializes progress output of the worker jobs
+static std::mutex consoleMutex;
+
+// Read only memory map of a whole file
+struct mappedFile_t {
+	const char *data{ nullptr };
+	size_t size{ 0 };
+	int fd{ -1 };
+};
+
+/* An opened raster, read top down by readRows().
+ * Binary rasters are described by strips of rows: row r starts at
+ * stripOffsets[r / rowsPerStrip] + ( r % rowsPerStrip ) * rowBytes, samples are sampleStride bytes apart. */
+struct rasterInput_t {
+	typedef enum {
+		ASCII, BINARY
+	} type_t;
+	type_t type{ ASCII };
+	mappedFile_t file;
+	rasterHeader_t header;
+	// Next row to be read
+	uint32_t nextRow{ 0 };
+	// Height no data samples are set to, 0 or VOID_HEIGHT
+	uint16_t noDataHeight{ 0 };
+	// Ascii: position of the next row's text
+	const char *next{ nullptr };
+	// Binary layout
+	bool bigEndian{ false };
+	bool isSigned{ true };
+	size_t sampleStride{ 2 };
+	size_t rowBytes{ 0 };
+	uint32_t rowsPerStrip{ 0 };
+	std::vector<uint64_t> stripOffsets;
+};
+
+static bool mapFile( const std::string &filename, mappedFile_t &file ) {
+	file.fd = open( filename.c_str(), O_RDONLY );
+	if( file.fd < 0 )
+		return false;
+	struct stat st;
+	if( 0 != fstat( file.fd, &st ) || 0 == st.st_size ) {
+		close( file.fd );
+		return false;
+	}
+	file.size = static_cast<size_t>( st.st_size );
+	void *p{ mmap( nullptr, file.size, PROT_READ, MAP_PRIVATE, file.fd, 0 ) };
+	if( MAP_FAILED == p ) {
+		close( file.fd );
+		return false;
+	}
+	// Read once front to back; lets the kernel read ahead and drop pages behind us
+	madvise( p, file.size, MADV_SEQUENTIAL );
+	file.data = static_cast<const char *>( p );
+	return true;
+}
+
+static void unmapFile( mappedFile_t &file ) {
+	if( nullptr != file.data )
+		munmap( const_cast<char *>( file.data ), file.size );
+	if( file.fd >= 0 )
+		close( file.fd );
+	file = mappedFile_t{};
+}
+
+/* Release the pages of a mapped range that has been consumed, so resident memory
+ * doesn't grow with the file size. The pages are clean, they are just dropped. */
+static void releaseMappedRange( const mappedFile_t &file, const char *begin, const char *end ) {
+	const uintptr_t pageSize{ static_cast<uintptr_t>( sysconf( _SC_PAGESIZE ) ) };
+	const uintptr_t first{ ( reinterpret_cast<uintptr_t>( begin ) + pageSize - 1 ) & ~( pageSize - 1 ) };
+	const uintptr_t last{ reinterpret_cast<uintptr_t>( end ) & ~( pageSize - 1 ) };
+	if( last > first && first >= reinterpret_cast<uintptr_t>( file.data ) )
+		madvise( reinterpret_cast<void *>( first ), last - first, MADV_DONTNEED );
+}
+
+static bool hasExtension( const std::string &filename, const std::string &extension ) {
+	if( filename.size() <= extension.size() )
+		return false;
+	for( size_t i{0}; i < extension.size(); ++i )
+		if( std::tolower( filename[filename.size() - extension.size() + i] ) != extension[i] )
+			return false;
+	return true;
+}
+
+// Next line of mapped text without the line break. Advances p behind the line break.
+static std::string nextLine( const char *&p, const char *const end ) {
+	const char *lineEnd{ static_cast<const char *>( std::memchr( p, '\n', end - p ) ) };
+	if( nullptr == lineEnd )
+		lineEnd = end;
+	std::string line{ p, lineEnd };
+	p = lineEnd < end ? lineEnd + 1 : end;
+	return line;
+}
+
+// ******** Ascii grid
+
+static bool readSrtmAsciiHeader( const char *&p, const char *const end, rasterHeader_t &asciiFileHeader ) {
+	// Read header data, hader data of srtm v 4.1 files is fixed
+	std::string inString{ nextLine( p, end ) };
+	if( 1 == std::sscanf( inString.c_str(), "ncols %u\n", &asciiFileHeader.numberOfColumns ) )
+		std::cout << "Number of columns: " << asciiFileHeader.numberOfColumns << std::endl;
+	else {
+		std::cerr << "Error reading ascii header number of columns\n";
+		return false;
+	}
+	inString = nextLine( p, end );
+	if( 1 == std::sscanf( inString.c_str(), "nrows %u\n", &asciiFileHeader.numberOfRows ) )
+		std::cout << "Number of rows: " << asciiFileHeader.numberOfRows << std::endl;
+	else {
+		std::cerr << "Error reading ascii header number of rows\n";
+		return false;
+	}
+	inString = nextLine( p, end );
+	if( 1 == std::sscanf( inString.c_str(), "xllcorner %lf\n", &asciiFileHeader.llLong ) )
+		std::cout << "Lower left longitude: " << asciiFileHeader.llLong << std::endl;
+	else {
+		std::cerr << "Error reading ascii header lower left x (longitude)\n";
+		return false;
+	}
+	inString = nextLine( p, end );
+	if( 1 == std::sscanf( inString.c_str(), "yllcorner %lf\n", &asciiFileHeader.llLat ) )
+		std::cout << "Lower left latitude: " << asciiFileHeader.llLat << std::endl;
+	else {
+		std::cerr << "Error reading ascii header lower left y (latitude)\n";
+		return false;
+	}
+	inString = nextLine( p, end );
+	if( 1 == std::sscanf( inString.c_str(), "cellsize %lf\n", &asciiFileHeader.cellsize ) )
+		std::cout << "Distance between posts in arc seconds: " << asciiFileHeader.cellsize << '\n';
+	else {
+		std::cerr << "Cellsize could not be determined\n";
+		return false;
+	}
+	inString = nextLine( p, end );
+	if( 1 == std::sscanf( inString.c_str(), "NODATA_value %d\n", &asciiFileHeader.noDataValue ) )
+		std::cout << "No data value: " << asciiFileHeader.noDataValue << '\n';
+	else {
+		std::cerr << "Error reading no data value\n";
+		return false;
+	}
+	asciiFileHeader.hasNoData = true;
+	return true;
+}
+
+/* Parse the first numberOfColumns values of a line of text into out.
+ * Set no data to 0 but this can cause holes in some areas where there is a no data value,
+ * e.g. on some glaciers or where it was particularly cloudy, which happens in the srtm data.
+ * Also clip negative values to 0; it is often sea surface.
+ * Real negative height values below the reference ellipsoid's surface are excluded.
+ * No data can be set to noDataHeight instead, to fill the holes later. */
+static bool parseAsciiRow( const char *p, const char *const end, const uint32_t numberOfColumns,
+		const int noDataValue, const uint16_t noDataHeight, uint16_t *out ) {
+	for( uint32_t column{0}; column < numberOfColumns; ++column ) {
+		while( p < end && ( ' ' == *p || '\t' == *p || '\r' == *p ) )
+			++p;
+		int color;
+		const std::from_chars_result r{ std::from_chars( p, end, color ) };
+		if( std::errc{} != r.ec )
+			return false;
+		// Skip a fractional part, only the integer part of a value is used
+		p = r.ptr;
+		while( p < end && ' ' != *p && '\t' != *p && '\r' != *p )
+			++p;
+		if( color == noDataValue )
+			color = noDataHeight;
+		else if( color < 0 )
+			color = 0;
+		else if( color >= VOID_HEIGHT )
+			color = VOID_HEIGHT - 1;
+		out[column] = static_cast<uint16_t>( color );
+	}
+	return true;
+}
+
+/* Parse lines into consecutive rows, split into contiguous ranges of lines, one job per worker.
+ * Returns the index of the first line that could not be parsed, or lines.size(). */
+static size_t parseAsciiRows( orf_n::thread_pool &pool, const std::vector<std::pair<const char *, const char *>> &lines,
+		const uint32_t numberOfColumns, const int noDataValue, const uint16_t noDataHeight, uint16_t *rows,
+		const size_t stride ) {
+	const size_t numJobs{ std::min<size_t>( pool.get_number_of_threads(), lines.size() ) };
+	std::atomic<size_t> firstError{ lines.size() };
+	std::vector<std::future<bool>> jobs;
+	for( size_t j{0}; j < numJobs; ++j ) {
+		jobs.push_back( pool.submit( [&, j]() {
+			const size_t first{ lines.size() * j / numJobs };
+			const size_t last{ lines.size() * ( j + 1 ) / numJobs };
+			for( size_t i{ first }; i < last; ++i ) {
+				if( !parseAsciiRow( lines[i].first, lines[i].second, numberOfColumns, noDataValue, noDataHeight,
+						rows + i * stride ) ) {
+					size_t expected{ firstError.load() };
+					while( i < expected && !firstError.compare_exchange_weak( expected, i ) );
+					return false;
+				}
+			}
+			return true;
+		} ) );
+	}
+	orf_n::thread_pool::wait_for( jobs );
+	return firstError.load();
+}
+
+static bool readAsciiRows( orf_n::thread_pool &pool, rasterInput_t &in, uint16_t *rows, const size_t stride,
+		const uint32_t numColumns, const uint32_t numRows ) {
+	const char *const end{ in.file.data + in.file.size };
+	std::vector<std::pair<const char *, const char *>> lines;
+	// In chunks, so only a chunk of text is resident at a time
+	for( uint32_t chunkRow{0}; chunkRow < numRows; chunkRow += ROWS_PER_CHUNK ) {
+		const char *const chunkBegin{ in.next };
+		const uint32_t chunkEnd{ std::min( chunkRow + ROWS_PER_CHUNK, numRows ) };
+		// Find the line boundaries of the chunk's rows
+		lines.clear();
+		for( uint32_t row{ chunkRow }; row < chunkEnd; ++row ) {
+			if( in.next >= end ) {
+				std::lock_guard<std::mutex> lock{ consoleMutex };
+				std::cerr << "Converter: unexpected end of data in row " << in.nextRow + row << '\n';
+				return false;
+			}
+			const char *lineEnd{ static_cast<const char *>( std::memchr( in.next, '\n', end - in.next ) ) };
+			if( nullptr == lineEnd )
+				lineEnd = end;
+			lines.push_back( { in.next, lineEnd } );
+			in.next = lineEnd < end ? lineEnd + 1 : end;
+		}
+		const size_t error{ parseAsciiRows( pool, lines, numColumns, in.header.noDataValue, in.noDataHeight,
+				rows + chunkRow * stride, stride ) };
+		if( error < lines.size() ) {
+			std::lock_guard<std::mutex> lock{ consoleMutex };
+			std::cerr << "Converter: error parsing row " << in.nextRow + chunkRow + error << '\n';
+			return false;
+		}
+		releaseMappedRange( in.file, chunkBegin, in.next );
+	}
+	in.nextRow += numRows;
+	return true;
+}
+
+// ******** Binary rasters
+
+/* Convert count 16 bit samples, sampleStride bytes apart, to heights. Swap bytes if the file is
+ * big endian (we run on little endian hosts), set no data to noDataHeight and, if signed, negative
+ * values to 0. Heights are clamped below VOID_HEIGHT. */
+static void convertSamples( const char *src, const size_t sampleStride, const size_t count, const bool swap,
+		const bool isSigned, const bool hasNoData, const uint16_t noData, const uint16_t noDataHeight, uint16_t *out ) {
+	size_t i{ 0 };
+#ifdef __SSE2__
+	// Packed samples 8 at a time; sse2 is part of x86-64, no runtime check needed
+	if( 2 == sampleStride ) {
+		const __m128i zero{ _mm_setzero_si128() };
+		const __m128i noDataV{ _mm_set1_epi16( static_cast<short>( noData ) ) };
+		const __m128i noDataHeightV{ _mm_set1_epi16( static_cast<short>( noDataHeight ) ) };
+		// Unsigned compare by flipping the sign bit, sse2 has no unsigned 16 bit min
+		const __m128i signBit{ _mm_set1_epi16( static_cast<short>( 0x8000 ) ) };
+		const __m128i maxHeightV{ _mm_set1_epi16( static_cast<short>( ( VOID_HEIGHT - 1 ) ^ 0x8000 ) ) };
+		for( ; i + 8 <= count; i += 8 ) {
+			__m128i v{ _mm_loadu_si128( reinterpret_cast<const __m128i *>( src + 2 * i ) ) };
+			if( swap )
+				v = _mm_or_si128( _mm_slli_epi16( v, 8 ), _mm_srli_epi16( v, 8 ) );
+			const __m128i isNoData{ hasNoData ? _mm_cmpeq_epi16( v, noDataV ) : zero };
+			if( isSigned )
+				v = _mm_max_epi16( v, zero );
+			v = _mm_xor_si128( _mm_min_epi16( _mm_xor_si128( v, signBit ), maxHeightV ), signBit );
+			v = _mm_or_si128( _mm_andnot_si128( isNoData, v ), _mm_and_si128( isNoData, noDataHeightV ) );
+			_mm_storeu_si128( reinterpret_cast<__m128i *>( out + i ), v );
+		}
+	}
+#endif
+	for( ; i < count; ++i ) {
+		uint16_t v;
+		std::memcpy( &v, src + i * sampleStride, sizeof( v ) );
+		if( swap )
+			v = static_cast<uint16_t>( ( v << 8 ) | ( v >> 8 ) );
+		if( hasNoData && v == noData )
+			v = noDataHeight;
+		else if( isSigned && static_cast<int16_t>( v ) < 0 )
+			v = 0;
+		else if( v >= VOID_HEIGHT )
+			v = VOID_HEIGHT - 1;
+		out[i] = v;
+	}
+}
+
+static const char *binaryRow( const rasterInput_t &in, const uint32_t row ) {
+	return in.file.data + in.stripOffsets[row / in.rowsPerStrip] + ( row % in.rowsPerStrip ) * in.rowBytes;
+}
+
+// Checks that all rows lie inside the file, so rows can be read without further checks
+static bool checkBinaryLayout( const rasterInput_t &in, const std::string &filename ) {
+	if( 0 == in.rowsPerStrip ||
+			in.stripOffsets.size() < ( in.header.numberOfRows + in.rowsPerStrip - 1 ) / in.rowsPerStrip ||
+			in.rowBytes < ( in.header.numberOfColumns - 1 ) * in.sampleStride + 2 ) {
+		std::cerr << "Converter: inconsistent raster layout in '" << filename << "'\n";
+		return false;
+	}
+	for( uint32_t row{0}; row < in.header.numberOfRows; row += in.rowsPerStrip ) {
+		const uint32_t lastRow{ std::min( row + in.rowsPerStrip, in.header.numberOfRows ) - 1 };
+		const uint64_t end{ static_cast<uint64_t>( binaryRow( in, lastRow ) - in.file.data ) +
+			( in.header.numberOfColumns - 1 ) * in.sampleStride + 2 };
+		if( end > in.file.size ) {
+			std::cerr << "Converter: raster data of '" << filename << "' is truncated\n";
+			return false;
+		}
+	}
+	return true;
+}
+
+static bool readBinaryRows( orf_n::thread_pool &pool, rasterInput_t &in, uint16_t *rows, const size_t stride,
+		const uint32_t numColumns, const uint32_t numRows ) {
+	const bool hasNoData{ in.header.hasNoData && in.header.noDataValue >= ( in.isSigned ? -32768 : 0 ) &&
+		in.header.noDataValue <= ( in.isSigned ? 32767 : 65535 ) };
+	const uint16_t noData{ static_cast<uint16_t>( in.header.noDataValue ) };
+	for( uint32_t chunkRow{0}; chunkRow < numRows; chunkRow += ROWS_PER_CHUNK ) {
+		const uint32_t chunkEnd{ std::min( chunkRow + ROWS_PER_CHUNK, numRows ) };
+		const size_t numJobs{ std::min<size_t>( pool.get_number_of_threads(), chunkEnd - chunkRow ) };
+		std::vector<std::future<bool>> jobs;
+		for( size_t j{0}; j < numJobs; ++j ) {
+			jobs.push_back( pool.submit( [&, j]() {
+				const uint32_t first{ chunkRow + static_cast<uint32_t>( ( chunkEnd - chunkRow ) * j / numJobs ) };
+				const uint32_t last{ chunkRow + static_cast<uint32_t>( ( chunkEnd - chunkRow ) * ( j + 1 ) / numJobs ) };
+				for( uint32_t r{ first }; r < last; ++r )
+					convertSamples( binaryRow( in, in.nextRow + r ), in.sampleStride, numColumns, in.bigEndian,
+							in.isSigned, hasNoData, noData, in.noDataHeight, rows + r * stride );
+				return true;
+			} ) );
+		}
+		orf_n::thread_pool::wait_for( jobs );
+		const char *const first{ binaryRow( in, in.nextRow + chunkRow ) };
+		const char *const last{ binaryRow( in, in.nextRow + chunkEnd - 1 ) + in.rowBytes };
+		if( last > first )
+			releaseMappedRange( in.file, first, std::min( last, in.file.data + in.file.size ) );
+	}
+	in.nextRow += numRows;
+	return true;
+}
+
+/* ESRI .hdr sidecar of BIL/BIP/BSQ files. Keys are case insensitive, unknown keys are ignored.
+ * Positions are those of the center of the upper left cell. */
+static bool readEsriHeader( const std::string &hdrFilename, const std::string &layout, rasterInput_t &in ) {
+	std::ifstream hdr{ hdrFilename, std::ios::in };
+	if( !hdr.is_open() ) {
+		std::cerr << "Converter: error opening header file '" << hdrFilename << "'\n";
+		return false;
+	}
+	uint64_t nbands{ 1 }, nbits{ 8 }, skipBytes{ 0 }, bandRowBytes{ 0 }, totalRowBytes{ 0 };
+	double ulx{ 0.0 }, uly{ 0.0 }, xdim{ 0.0 }, ydim{ 0.0 };
+	bool hasPosition{ false };
+	// Without PIXELTYPE samples are unsigned, as with GDAL's EHdr reader
+	in.isSigned = false;
+	std::string line;
+	while( std::getline( hdr, line ) ) {
+		std::istringstream s{ line };
+		std::string key, value;
+		if( !( s >> key >> value ) )
+			continue;
+		std::transform( key.begin(), key.end(), key.begin(), ::toupper );
+		std::transform( value.begin(), value.end(), value.begin(), ::toupper );
+		try {
+			if( "NROWS" == key )
+				in.header.numberOfRows = static_cast<uint32_t>( std::stoul( value ) );
+			else if( "NCOLS" == key )
+				in.header.numberOfColumns = static_cast<uint32_t>( std::stoul( value ) );
+			else if( "NBANDS" == key )
+				nbands = std::stoull( value );
+			else if( "NBITS" == key )
+				nbits = std::stoull( value );
+			else if( "BYTEORDER" == key )
+				in.bigEndian = 'M' == value[0];
+			else if( "PIXELTYPE" == key )
+				in.isSigned = "SIGNEDINT" == value;
+			else if( "SKIPBYTES" == key )
+				skipBytes = std::stoull( value );
+			else if( "BANDROWBYTES" == key )
+				bandRowBytes = std::stoull( value );
+			else if( "TOTALROWBYTES" == key )
+				totalRowBytes = std::stoull( value );
+			else if( "NODATA" == key ) {
+				in.header.noDataValue = std::stoi( value );
+				in.header.hasNoData = true;
+			} else if( "ULXMAP" == key ) {
+				ulx = std::stod( value );
+				hasPosition = true;
+			} else if( "ULYMAP" == key )
+				uly = std::stod( value );
+			else if( "XDIM" == key )
+				xdim = std::stod( value );
+			else if( "YDIM" == key )
+				ydim = std::stod( value );
+		} catch( std::logic_error & ) {
+			// invalid_argument or out_of_range from the number conversions
+			std::cerr << "Converter: invalid value '" << value << "' of " << key << " in '" << hdrFilename << "'\n";
+			return false;
+		}
+	}
+	if( 16 != nbits || 0 == nbands || !hasPosition || xdim <= 0.0 ) {
+		std::cerr << "Converter: '" << hdrFilename << "' must describe 16 bit samples with ulxmap, ulymap and xdim\n";
+		return false;
+	}
+	if( 0.0 == ydim )
+		ydim = xdim;
+	if( std::abs( xdim - ydim ) > 1e-9 * xdim )
+		std::cerr << "Converter: warning, cells are not square, xdim is used as cellsize\n";
+	const uint64_t columns{ in.header.numberOfColumns };
+	if( 0 == bandRowBytes )
+		bandRowBytes = columns * 2;
+	// Only the first band is read
+	if( "BIP" == layout ) {
+		in.sampleStride = 2 * nbands;
+		in.rowBytes = 0 != totalRowBytes ? totalRowBytes : columns * 2 * nbands;
+	} else if( "BSQ" == layout ) {
+		in.sampleStride = 2;
+		in.rowBytes = bandRowBytes;
+	} else {
+		in.sampleStride = 2;
+		in.rowBytes = 0 != totalRowBytes ? totalRowBytes : bandRowBytes * nbands;
+	}
+	in.rowsPerStrip = std::max( 1u, in.header.numberOfRows );
+	in.stripOffsets.assign( 1, skipBytes );
+	in.header.cellsize = xdim;
+	in.header.llLong = ulx - 0.5 * xdim;
+	in.header.llLat = uly + 0.5 * ydim - static_cast<double>( in.header.numberOfRows ) * ydim;
+	return true;
+}
+
+/* SRTM .hgt cell: square, big endian signed 16 bit, -32768 no data. The filename gives the
+ * position of the lower left post, e.g. N45E006.hgt. Posts are cell centers. */
+static bool readHgtLayout( const std::string &filename, rasterInput_t &in ) {
+	const uint32_t size{ static_cast<uint32_t>( std::lround( std::sqrt( in.file.size / 2.0 ) ) ) };
+	const std::string name{ filename.substr( filename.find_last_of( "/\\" ) + 1 ) };
+	int lat, lon;
+	char ns, ew;
+	if( static_cast<size_t>( size ) * size * 2 != in.file.size || size < 2 ||
+			4 != std::sscanf( name.c_str(), "%c%d%c%d", &ns, &lat, &ew, &lon ) ) {
+		std::cerr << "Converter: '" << filename << "' is not an srtm .hgt cell (NddEddd.hgt, square)\n";
+		return false;
+	}
+	if( 'S' == std::toupper( ns ) )
+		lat = -lat;
+	if( 'W' == std::toupper( ew ) )
+		lon = -lon;
+	in.header.numberOfColumns = size;
+	in.header.numberOfRows = size;
+	in.header.cellsize = 1.0 / static_cast<double>( size - 1 );
+	in.header.llLong = lon - 0.5 * in.header.cellsize;
+	in.header.llLat = lat - 0.5 * in.header.cellsize;
+	in.header.noDataValue = -32768;
+	in.header.hasNoData = true;
+	in.bigEndian = true;
+	in.isSigned = true;
+	in.sampleStride = 2;
+	in.rowBytes = static_cast<size_t>( size ) * 2;
+	in.rowsPerStrip = size;
+	in.stripOffsets.assign( 1, 0 );
+	return true;
+}
+
+/* Uncompressed GeoTIFF with strips. Reads the first image file directory, georeferencing from
+ * ModelPixelScale and ModelTiepoint, no data from the GDAL_NODATA tag. */
+static bool readGeoTiffLayout( const std::string &filename, rasterInput_t &in ) {
+	const char *const d{ in.file.data };
+	const size_t size{ in.file.size };
+	if( size < 8 || !( ( 'I' == d[0] && 'I' == d[1] ) || ( 'M' == d[0] && 'M' == d[1] ) ) ) {
+		std::cerr << "Converter: '" << filename << "' is not a tiff file\n";
+		return false;
+	}
+	const bool bigEndian{ 'M' == d[0] };
+	auto u16 = [&]( const uint64_t offset ) -> uint32_t {
+		const uint8_t *b{ reinterpret_cast<const uint8_t *>( d + offset ) };
+		return bigEndian ? ( b[0] << 8 ) | b[1] : ( b[1] << 8 ) | b[0];
+	};
+	auto u32 = [&]( const uint64_t offset ) -> uint32_t {
+		return bigEndian ? ( u16( offset ) << 16 ) | u16( offset + 2 ) : ( u16( offset + 2 ) << 16 ) | u16( offset );
+	};
+	auto f64 = [&]( const uint64_t offset ) -> double {
+		const uint64_t bits{ bigEndian ? ( uint64_t{ u32( offset ) } << 32 ) | u32( offset + 4 ) :
+			( uint64_t{ u32( offset + 4 ) } << 32 ) | u32( offset ) };
+		double v;
+		std::memcpy( &v, &bits, sizeof( v ) );
+		return v;
+	};
+	if( 42 != u16( 2 ) ) {
+		std::cerr << "Converter: '" << filename << "' is not a classic tiff (BigTIFF is not supported)\n";
+		return false;
+	}
+	const uint64_t ifd{ u32( 4 ) };
+	if( ifd + 2 > size || ifd + 2 + 12 * u16( ifd ) > size ) {
+		std::cerr << "Converter: corrupt tiff directory in '" << filename << "'\n";
+		return false;
+	}
+	uint32_t bitsPerSample{ 1 }, compression{ 1 }, samplesPerPixel{ 1 }, planar{ 1 }, sampleFormat{ 1 };
+	uint32_t rowsPerStrip{ 0 };
+	bool tiled{ false };
+	std::vector<double> pixelScale, tiePoint;
+	const uint32_t numEntries{ u16( ifd ) };
+	for( uint32_t e{0}; e < numEntries; ++e ) {
+		const uint64_t entry{ ifd + 2 + 12 * e };
+		const uint32_t tag{ u16( entry ) };
+		const uint32_t type{ u16( entry + 2 ) };
+		const uint32_t count{ u32( entry + 4 ) };
+		const uint32_t typeSize{ 3 == type ? 2u : 4 == type ? 4u : 12 == type ? 8u : 1u };
+		// Values that fit in 4 bytes are stored in the entry itself
+		const uint64_t values{ uint64_t{ count } * typeSize <= 4 ? entry + 8 : u32( entry + 8 ) };
+		if( values + uint64_t{ count } * typeSize > size ) {
+			std::cerr << "Converter: corrupt tiff tag " << tag << " in '" << filename << "'\n";
+			return false;
+		}
+		auto value = [&]( const uint32_t i ) -> uint32_t {
+			return 3 == type ? u16( values + 2 * i ) : u32( values + 4 * i );
+		};
+		switch( tag ) {
+			case 256: in.header.numberOfColumns = value( 0 ); break;
+			case 257: in.header.numberOfRows = value( 0 ); break;
+			case 258: bitsPerSample = value( 0 ); break;
+			case 259: compression = value( 0 ); break;
+			case 273:
+				in.stripOffsets.resize( count );
+				for( uint32_t i{0}; i < count; ++i )
+					in.stripOffsets[i] = value( i );
+				break;
+			case 277: samplesPerPixel = value( 0 ); break;
+			case 278: rowsPerStrip = value( 0 ); break;
+			case 284: planar = value( 0 ); break;
+			case 322: tiled = true; break;
+			case 339: sampleFormat = value( 0 ); break;
+			case 33550:
+				for( uint32_t i{0}; i < count && 12 == type; ++i )
+					pixelScale.push_back( f64( values + 8 * i ) );
+				break;
+			case 33922:
+				for( uint32_t i{0}; i < count && 12 == type; ++i )
+					tiePoint.push_back( f64( values + 8 * i ) );
+				break;
+			case 42113: {
+				const std::string s{ d + values, d + values + count };
+				in.header.hasNoData = std::from_chars( s.data(), s.data() + s.size(), in.header.noDataValue ).ec == std::errc{};
+				break;
+			}
+		}
+	}
+	if( 16 != bitsPerSample || 1 != compression || tiled || sampleFormat > 2 ) {
+		std::cerr << "Converter: '" << filename << "' must be an uncompressed, strip organized tiff " <<
+				"with 16 bit integer samples\n";
+		return false;
+	}
+	if( pixelScale.size() < 2 || tiePoint.size() < 6 ) {
+		std::cerr << "Converter: '" << filename << "' has no georeferencing (ModelPixelScale, ModelTiepoint)\n";
+		return false;
+	}
+	in.bigEndian = bigEndian;
+	in.isSigned = 2 == sampleFormat;
+	// Chunky samples are interleaved, planar ones begin with the strips of the first band
+	in.sampleStride = 1 == planar ? 2 * samplesPerPixel : 2;
+	in.rowBytes = static_cast<size_t>( in.header.numberOfColumns ) * in.sampleStride;
+	in.rowsPerStrip = 0 != rowsPerStrip ? std::min( rowsPerStrip, in.header.numberOfRows ) : in.header.numberOfRows;
+	// Tie point maps raster position i, j to x, y; the raster is north up
+	in.header.cellsize = pixelScale[0];
+	if( std::abs( pixelScale[0] - pixelScale[1] ) > 1e-9 * pixelScale[0] )
+		std::cerr << "Converter: warning, cells are not square, the x scale is used as cellsize\n";
+	in.header.llLong = tiePoint[3] - tiePoint[0] * pixelScale[0];
+	in.header.llLat = tiePoint[4] + tiePoint[1] * pixelScale[1] -
+			static_cast<double>( in.header.numberOfRows ) * pixelScale[1];
+	return true;
+}
+
+/* Open and map a raster, read its header and check it against the tile size.
+ * The format follows from the file extension. */
+static bool openRaster( const std::string &filename, const uint16_t tilesize, rasterInput_t &in ) {
+	in = rasterInput_t{};
+	in.header = rasterHeader_t{ 0, 0, 0.0, 0.0, 0.0, 0, false, tilesize };
+	if( !mapFile( filename, in.file ) ) {
+		std::cerr << "Converter: error opening raster file '" << filename << "'\n";
+		return false;
+	}
+	bool success{ false };
+	if( hasExtension( filename, ".asc" ) ) {
+		in.type = rasterInput_t::ASCII;
+		in.next = in.file.data;
+		success = readSrtmAsciiHeader( in.next, in.file.data + in.file.size, in.header );
+	} else {
+		in.type = rasterInput_t::BINARY;
+		const std::string base{ filename.substr( 0, filename.find_last_of( '.' ) ) };
+		if( hasExtension( filename, ".bil" ) )
+			success = readEsriHeader( base + ".hdr", "BIL", in );
+		else if( hasExtension( filename, ".bip" ) )
+			success = readEsriHeader( base + ".hdr", "BIP", in );
+		else if( hasExtension( filename, ".bsq" ) )
+			success = readEsriHeader( base + ".hdr", "BSQ", in );
+		else if( hasExtension( filename, ".hgt" ) )
+			success = readHgtLayout( filename, in );
+		else if( hasExtension( filename, ".tif" ) || hasExtension( filename, ".tiff" ) )
+			success = readGeoTiffLayout( filename, in );
+		else
+			std::cerr << "Converter: unknown raster format of '" << filename << "'\n";
+		success = success && checkBinaryLayout( in, filename );
+	}
+	if( success ) {
+		const rasterHeader_t &h{ in.header };
+		if( h.numberOfColumns < tilesize || h.numberOfRows < tilesize ) {
+			std::cerr << "Error, size of data could not be determined or tile size > size of data\n";
+			success = false;
+		} else if( h.llLong < -180.0 || h.llLat < -90.0 || h.llLong > 180.0 || h.llLat > 90.0 ) {
+			std::cerr << "Error in latitude or longitude; out of bounds\n";
+			success = false;
+		}
+	}
+	if( !success )
+		unmapFile( in.file );
+	return success;
+}
+
+/* Read the next numRows rows into rows with a stride of stride samples.
+ * Only the first numColumns columns are converted. */
+static bool readRows( orf_n::thread_pool &pool, rasterInput_t &in, uint16_t *rows, const size_t stride,
+		const uint32_t numColumns, const uint32_t numRows ) {
+	if( in.nextRow + numRows > in.header.numberOfRows )
+		return false;
+	if( rasterInput_t::ASCII == in.type )
+		return readAsciiRows( pool, in, rows, stride, numColumns, numRows );
+	return readBinaryRows( pool, in, rows, stride, numColumns, numRows );
+}
+
+static void closeRaster( rasterInput_t &in ) {
+	unmapFile( in.file );
+}
+
+}	// namespace
@@ -0,0 +1,80 @@
+/**
+ * Headless check of the river network generation, see TerrainGen.h.
+ * Grows a network upstream from river mouths spread along one side of a square domain, classifies it
+ * and prints the time, number of nodes and ridges, the largest flow and Horton-Strahler number, and
+ * the number of nodes per stream type. Returns failure if fewer stream types appear than expected.
+ *
+ * Params:
+ * domain size, number of mouths
+ * Options:
+ * -s <seed> random seed of the network
+ * -v <sigma> slope variation between reaches, see networkSettings_t
+ * -m <count> stream types that must appear, default 4
+ *
+ * Build with src/ as include path, TerrainGen.h is header only.
+ */
+
+#include "applications/TerrainErosion/TerrainGen.h"
+#include <chrono>
+#include <cstring>
+#include <iostream>
+#include <string>
+
+int main( int argc, char *argv[] ) {
+	networkSettings_t settings;
+	uint32_t expectedTypes{ 4 };
+	std::vector<std::string> params;
+	for( int i{1}; i < argc; ++i ) {
+		if( 0 == strcmp( argv[i], "-s" ) && i + 1 < argc )
+			settings.seed = static_cast<uint32_t>( std::stoul( argv[++i] ) );
+		else if( 0 == strcmp( argv[i], "-v" ) && i + 1 < argc )
+			settings.slopeVariation = std::stof( argv[++i] );
+		else if( 0 == strcmp( argv[i], "-m" ) && i + 1 < argc )
+			expectedTypes = static_cast<uint32_t>( std::stoul( argv[++i] ) );
+		else
+			params.push_back( argv[i] );
+	}
+	if( params.size() != 2 ) {
+		std::cerr << "Usage: river_benchmark [-s seed] [-v slope variation] [-m stream types] size mouths\n";
+		return EXIT_FAILURE;
+	}
+	const float size{ std::stof( params[0] ) };
+	const uint32_t numberOfMouths{ static_cast<uint32_t>( std::stoul( params[1] ) ) };
+	inputDomain = { { 0.0f, 0.0f, 0.0f }, { size, 0.0f, 0.0f }, { size, 0.0f, size }, { 0.0f, 0.0f, size } };
+	std::vector<riverNode_t> mouths( numberOfMouths );
+	for( uint32_t i{0}; i < numberOfMouths; ++i ) {
+		mouths[i].position = omath::vec3{ size * ( i + 1 ) / ( numberOfMouths + 1 ), 0.0f, 0.5f };
+		mouths[i].priority = high;
+	}
+
+	const auto start{ std::chrono::steady_clock::now() };
+	growNetwork( mouths, settings );
+	classifyRiver();
+	const double seconds{ std::chrono::duration<double>( std::chrono::steady_clock::now() - start ).count() };
+
+	static const char *const names[]{ "G", "F", "E", "DA", "D", "C", "B", "A", "A+" };
+	uint32_t counts[APLUS + 1]{};
+	float maxFlow{ 0.0f };
+	uint32_t maxOrder{ 0 };
+	for( const riverNode_t &n : network ) {
+		++counts[n.riverType];
+		maxFlow = std::max( maxFlow, n.flow );
+		maxOrder = std::max( maxOrder, n.hortonStrahler );
+	}
+	std::cout << "Domain " << size << ", " << numberOfMouths << " mouths, seed " << settings.seed << '\n';
+	std::cout << "Time: " << seconds << "s\n";
+	std::cout << "Nodes: " << network.size() << ", ridges: " << ridges.size() << '\n';
+	std::cout << "Largest flow: " << maxFlow << ", Horton-Strahler order: " << maxOrder << '\n';
+	std::cout << "Stream types:";
+	uint32_t types{ 0 };
+	for( int t{ APLUS }; t >= G; --t ) {
+		std::cout << ' ' << names[t] << ' ' << counts[t];
+		types += counts[t] > 0 ? 1 : 0;
+	}
+	std::cout << '\n';
+	if( types < expectedTypes ) {
+		std::cerr << "Only " << types << " stream types, expected at least " << expectedTypes << '\n';
+		return EXIT_FAILURE;
+	}
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,252 @@
+
+/**
+ * Encoders for the converter's output tiles.
+ * All take 16 bit heights row major with a row stride in samples, so tiles can be written
+ * straight from a larger buffer without copying them out first.
+ * writeTile() cuts, measures and writes one tile with its bounding box file, cutTiles() all tiles
+ * of a grid.
+ */
+
+#pragma once
+
+#include "applications/terrain_lod/tile_file.h"
+#include "raster_input.h"
+#include "base/thread_pool.h"
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <png.h>
+
+namespace converter {
+
+typedef enum {
+	// 16 bit grayscale png, fastest deflate level and sub filter
+	PNG,
+	// Bare little endian 16 bit heights, no header
+	RAW,
+	// The engine's binary tile format, see terrain_lod/tile_file.h
+	TILE
+} outputFormat_t;
+
+static const char *fileExtension( const outputFormat_t format ) {
+	switch( format ) {
+		case RAW	: return ".raw";
+		case TILE	: return ".tile";
+		default		: return ".png";
+	}
+}
+
+static bool writePng16( const std::string &filename, const uint16_t *data, const size_t stride,
+		const uint32_t width, const uint32_t height ) {
+	FILE *file{ std::fopen( filename.c_str(), "wb" ) };
+	if( nullptr == file )
+		return false;
+	png_structp png{ png_create_write_struct( PNG_LIBPNG_VER_STRING, nullptr, nullptr, nullptr ) };
+	png_infop info{ nullptr != png ? png_create_info_struct( png ) : nullptr };
+	if( nullptr == info ) {
+		png_destroy_write_struct( &png, nullptr );
+		std::fclose( file );
+		return false;
+	}
+	// libpng reports errors by longjmp
+	if( setjmp( png_jmpbuf( png ) ) ) {
+		png_destroy_write_struct( &png, &info );
+		std::fclose( file );
+		return false;
+	}
+	png_init_io( png, file );
+	png_set_IHDR( png, info, width, height, 16, PNG_COLOR_TYPE_GRAY, PNG_INTERLACE_NONE,
+			PNG_COMPRESSION_TYPE_DEFAULT, PNG_FILTER_TYPE_DEFAULT );
+	// Deflate is the dominant cost. Heights change slowly along a row, sub filtering alone
+	// compresses them almost as well as the adaptive filter search of the default.
+	png_set_compression_level( png, 1 );
+	png_set_filter( png, PNG_FILTER_TYPE_BASE, PNG_FILTER_SUB );
+	png_write_info( png, info );
+	// Png is big endian
+	png_set_swap( png );
+	for( uint32_t row{0}; row < height; ++row )
+		png_write_row( png, reinterpret_cast<png_const_bytep>( data + row * stride ) );
+	png_write_end( png, nullptr );
+	png_destroy_write_struct( &png, &info );
+	return 0 == std::fclose( file );
+}
+
+static bool writeRows( FILE *file, const uint16_t *data, const size_t stride, const uint32_t width,
+		const uint32_t height ) {
+	for( uint32_t row{0}; row < height; ++row )
+		if( width != std::fwrite( data + row * stride, sizeof( uint16_t ), width, file ) )
+			return false;
+	return true;
+}
+
+static bool writeRaw16( const std::string &filename, const uint16_t *data, const size_t stride,
+		const uint32_t width, const uint32_t height ) {
+	FILE *file{ std::fopen( filename.c_str(), "wb" ) };
+	if( nullptr == file )
+		return false;
+	const bool success{ writeRows( file, data, stride, width, height ) };
+	return 0 == std::fclose( file ) && success;
+}
+
+static bool writeTileFile( const std::string &filename, const uint16_t *data, const size_t stride,
+		const terrain::tileFileHeader_t &header ) {
+	FILE *file{ std::fopen( filename.c_str(), "wb" ) };
+	if( nullptr == file )
+		return false;
+	const bool success{ 1 == std::fwrite( &header, sizeof( header ), 1, file ) &&
+		writeRows( file, data, stride, header.width, header.height ) };
+	return 0 == std::fclose( file ) && success;
+}
+
+/* Write one tile from a band of rows starting at column startColumn and its bounding box files.
+ * Calculate minimum and maximum heights of the tile and the cartesian coordinates of the tile's
+ * bounding box, originating from the lower left geodetic coordinates and applying the cellsize.
+ * We're strictly assuming square tiles. The tile is encoded straight from the band.
+ * Overview tiles of level > 0 have posts 2^level full resolution posts apart, startRow and startColumn
+ * are in posts of their level. Their bounds come from bands of minimum and maximum heights with the
+ * same layout, so they enclose all full resolution heights below the tile. */
+static bool writeTile( const uint16_t *band, const size_t bandStride, const uint32_t startRow,
+		const uint32_t startColumn, const uint32_t tileNumber, const rasterHeader_t &rasterHeader,
+		const outputFormat_t format, const uint32_t level = 0, const uint16_t *minBand = nullptr,
+		const uint16_t *maxBand = nullptr ) {
+	const uint16_t tilesize{ rasterHeader.tilesize };
+	const uint16_t *const tileData{ band + startColumn };
+	const uint16_t *const minData{ ( nullptr != minBand ? minBand : band ) + startColumn };
+	const uint16_t *const maxData{ ( nullptr != maxBand ? maxBand : band ) + startColumn };
+	uint16_t minValue{ 65535 };
+	uint16_t maxValue{ 0 };
+	for( uint32_t row{0}; row < tilesize; ++row ) {
+		const uint16_t *const minValues{ minData + row * bandStride };
+		const uint16_t *const maxValues{ maxData + row * bandStride };
+		for( uint32_t column{0}; column < tilesize; ++column ) {
+			minValue = std::min( minValue, minValues[column] );
+			maxValue = std::max( maxValue, maxValues[column] );
+		}
+	}
+	// An overview tile without any data, see overviews.h
+	if( minValue > maxValue )
+		minValue = maxValue = 0;
+	const double minY{ static_cast<double>( minValue ) };
+	const double maxY{ static_cast<double>( maxValue ) };
+
+	/* Construct real world bounding box minimum and maximum from geodetic coordinates:
+	 * geodetic lower left x + startRow * geodetic cellsize,
+	 * minimum height,
+	 * geodetic lower left y + startColumn * geodetic cellsize,
+	 * geodetic lower left x + startRow * geodetic cellsize + (tilesize-1) * geodetic cellsize,
+	 * maximum height,
+	 * geodetic lower left y + startColumn * geodetic cellsize + (tilesize-1) * geodetic cellsize */
+	const uint32_t scale{ 1u << level };
+	const double cellsize{ rasterHeader.cellsize * scale };
+	const double minLong{
+		rasterHeader.llLong + static_cast<double>( startRow ) * cellsize
+	};
+	const double minLat{
+		rasterHeader.llLat + static_cast<double>( startColumn ) * cellsize
+	};
+
+	std::ostringstream fileToWrite;
+	fileToWrite << "tile_" << tilesize << '_';
+	if( 0 < level )
+		fileToWrite << 'L' << level << '_';
+	fileToWrite << tileNumber;
+	const std::string imageFilename{ fileToWrite.str() + fileExtension( format ) };
+	bool written{ false };
+	switch( format ) {
+		case RAW:
+			written = writeRaw16( imageFilename, tileData, bandStride, tilesize, tilesize );
+			break;
+		case TILE: {
+			terrain::tileFileHeader_t header;
+			std::memcpy( header.magic, terrain::TILE_FILE_MAGIC, sizeof( header.magic ) );
+			header.version = terrain::TILE_FILE_VERSION;
+			header.width = tilesize;
+			header.height = tilesize;
+			header.minValue = minValue;
+			header.maxValue = maxValue;
+			header.llLong = minLong;
+			header.llLat = minLat;
+			header.cellsize = cellsize;
+			written = writeTileFile( imageFilename, tileData, bandStride, header );
+			break;
+		}
+		default:
+			written = writePng16( imageFilename, tileData, bandStride, tilesize, tilesize );
+			break;
+	}
+	if( !written ) {
+		std::lock_guard<std::mutex> lock{ consoleMutex };
+		std::cerr << "Converter: error writing '" << imageFilename << "'\n";
+		return false;
+	}
+
+	std::ofstream outFile{ fileToWrite.str() + ".bb" };
+	/* Construct bounding box relative to input data (beginning 0/0/0).
+	 * This is used to calculate texture positions during rendering. Overviews in full resolution posts. */
+	const double minX{ static_cast<double>( startRow ) * scale };
+	const double minZ{ static_cast<double>( startColumn ) * scale };
+	const double maxX{ static_cast<double>( (tilesize - 1 + startRow) ) * scale };
+	const double maxZ{ static_cast<double>( (tilesize - 1 + startColumn) ) * scale };
+	// Write axis aligned bounding box relative to heightmap data
+	outFile << minX << ' ' << minY << ' ' << minZ << ' ' << maxX << ' ' << maxY << ' ' << maxZ << std::endl;
+	outFile << std::fixed <<
+			minLong << ' ' << minLat << ' ' << cellsize << std::endl;
+	outFile.close();
+	std::ostringstream bbout;
+	bbout << "\tWritten " << imageFilename << '\n';
+	bbout << "\tAABB relative to data tile: " <<
+			"Min: " << minX << '/' << minY << '/' << minZ << "; " <<
+			"Max: " << maxX << '/' << maxY << '/' << maxZ << '\n';
+	bbout << std::fixed << "\tGeodetic lower left and cellsize of tile: " <<
+			"Lon/Lat: " << minLong << '/' << minLat << "; Cellsize in arcsec: " <<
+			cellsize << std::endl;
+	std::lock_guard<std::mutex> lock{ consoleMutex };
+	std::cout << bbout.str();
+	return true;
+}
+
+/* Cut and write all tiles of a mapped grid of numberOfVTiles x numberOfHTiles tiles that share their
+ * edge posts. Optional planes of minimum and maximum heights give the bounds, see writeTile().
+ * Bands of one tile row, the pages of a band are released when its tile jobs are done, while those
+ * of the next band are encoded. */
+static bool cutTiles( orf_n::thread_pool &pool, const mappedFile_t &file, const uint16_t *heights,
+		const uint16_t *minHeights, const uint16_t *maxHeights, const size_t stride, const uint32_t numberOfHTiles,
+		const uint32_t numberOfVTiles, const rasterHeader_t &grid, const outputFormat_t format,
+		const uint32_t level = 0 ) {
+	const uint16_t tilesize{ grid.tilesize };
+	const size_t bandSize{ ( tilesize - 1u ) * stride };
+	auto release = [&]( const uint16_t *plane, const uint32_t bandNumber ) {
+		if( nullptr != plane )
+			releaseMappedRange( file, reinterpret_cast<const char *>( plane + bandNumber * bandSize ),
+					reinterpret_cast<const char *>( plane + ( bandNumber + 1 ) * bandSize ) );
+	};
+	std::vector<std::future<bool>> tileJobs[2];
+	bool success{ true };
+	for( uint32_t bandNumber{0}; bandNumber < numberOfVTiles && success; ++bandNumber ) {
+		success = orf_n::thread_pool::wait_for( tileJobs[bandNumber % 2] );
+		if( 1 < bandNumber ) {
+			release( heights, bandNumber - 2 );
+			release( minHeights, bandNumber - 2 );
+			release( maxHeights, bandNumber - 2 );
+		}
+		const uint32_t startRow{ bandNumber * ( tilesize - 1 ) };
+		const size_t offset{ startRow * stride };
+		for( uint32_t i{0}; i < numberOfHTiles && success; ++i ) {
+			const uint32_t tileNumber{ i * numberOfVTiles + bandNumber + 1 };
+			tileJobs[bandNumber % 2].push_back( pool.submit( [=, &grid]() {
+				return writeTile( heights + offset, stride, startRow, i * ( tilesize - 1 ), tileNumber, grid, format,
+						level, nullptr != minHeights ? minHeights + offset : nullptr,
+						nullptr != maxHeights ? maxHeights + offset : nullptr );
+			} ) );
+		}
+	}
+	// Also waits on errors, jobs still reference the grid
+	success = orf_n::thread_pool::wait_for( tileJobs[0] ) && success;
+	return orf_n::thread_pool::wait_for( tileJobs[1] ) && success;
+}
+
+}	// namespace
@@ -0,0 +1,252 @@
+
+/**
+ * Filling of no data voids in a grid of heights for the converter.
+ * Voids are posts with VOID_HEIGHT, see raster_input.h. They are filled by pull-push: known posts
+ * are averaged down a pyramid of half resolution levels (pull), then voids take the bilinear
+ * interpolation of the next coarser level, from the top down (push). After each push a few Gauss-Seidel
+ * sweeps of the Laplace equation over the voids smooth out the box filter's blockiness, like the
+ * smoothing steps of a multigrid solver. Linear in the number of posts, large voids get smooth fills
+ * from their whole rim.
+ *
+ * A grid is filled per tile. Each tile is filled in a window with a halo of neighbouring posts, so fills
+ * continue across tile edges. Neighbouring windows fill a void differently though, so a void post takes
+ * the weighted sum of the fills of all tiles around it, with weights that fall off linearly across the tile
+ * edges and add up to 1. Tiles of a tile row are filled in parallel from the same grid; a tile row is
+ * written back after the one below it has been filled, and later tile rows see it as known posts. Fills
+ * are seamless and independent of the number of threads.
+ */
+
+#pragma once
+
+#include "raster_input.h"
+#include "base/thread_pool.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <vector>
+
+namespace converter {
+
+// Posts around a tile that take part in its fill
+static const uint32_t VOID_FILL_HALO{ 256 };
+
+// Laplace smoothing sweeps over the voids per pyramid level
+static const uint32_t VOID_FILL_SWEEPS{ 4 };
+
+/* Fill the posts of values with weight < 1 by pull-push. Weights are 1 for known posts, 0 for voids.
+ * Returns false if there are no known posts at all. */
+static bool pullPushFill( std::vector<float> &values, std::vector<float> &weights, const uint32_t width,
+		const uint32_t height ) {
+	struct level_t {
+		std::vector<float> values;
+		std::vector<float> weights;
+		uint32_t width;
+		uint32_t height;
+	};
+	std::vector<level_t> levels;
+	levels.push_back( level_t{ std::move( values ), std::move( weights ), width, height } );
+	// Pull: weighted averages of 2x2 posts, weights saturate at 1
+	while( levels.back().width > 1 || levels.back().height > 1 ) {
+		const level_t &fine{ levels.back() };
+		level_t coarse{ {}, {}, ( fine.width + 1 ) / 2, ( fine.height + 1 ) / 2 };
+		coarse.values.resize( static_cast<size_t>( coarse.width ) * coarse.height );
+		coarse.weights.resize( coarse.values.size() );
+		for( uint32_t y{0}; y < coarse.height; ++y )
+			for( uint32_t x{0}; x < coarse.width; ++x ) {
+				float sumWeights{ 0.0f };
+				float sumValues{ 0.0f };
+				for( uint32_t fy{ 2 * y }; fy < std::min( 2 * y + 2, fine.height ); ++fy )
+					for( uint32_t fx{ 2 * x }; fx < std::min( 2 * x + 2, fine.width ); ++fx ) {
+						const size_t i{ static_cast<size_t>( fy ) * fine.width + fx };
+						sumWeights += fine.weights[i];
+						sumValues += fine.weights[i] * fine.values[i];
+					}
+				const size_t i{ static_cast<size_t>( y ) * coarse.width + x };
+				coarse.values[i] = sumWeights > 0.0f ? sumValues / sumWeights : 0.0f;
+				coarse.weights[i] = std::min( 1.0f, sumWeights );
+			}
+		levels.push_back( std::move( coarse ) );
+	}
+	const bool hasData{ levels.back().weights[0] > 0.0f };
+	// Push: blend in the bilinear interpolation of the coarser level by the missing weight
+	std::vector<size_t> voids;
+	for( size_t l{ levels.size() - 1 }; l > 0 && hasData; --l ) {
+		const level_t &coarse{ levels[l] };
+		level_t &fine{ levels[l - 1] };
+		voids.clear();
+		for( uint32_t y{0}; y < fine.height; ++y ) {
+			// Fine post centers in coarse coordinates
+			const float cy{ std::clamp( 0.5f * y - 0.25f, 0.0f, static_cast<float>( coarse.height - 1 ) ) };
+			const uint32_t y0{ static_cast<uint32_t>( cy ) };
+			const uint32_t y1{ std::min( y0 + 1, coarse.height - 1 ) };
+			const float ty{ cy - y0 };
+			for( uint32_t x{0}; x < fine.width; ++x ) {
+				const size_t i{ static_cast<size_t>( y ) * fine.width + x };
+				if( fine.weights[i] >= 1.0f )
+					continue;
+				if( fine.weights[i] <= 0.0f )
+					voids.push_back( i );
+				const float cx{ std::clamp( 0.5f * x - 0.25f, 0.0f, static_cast<float>( coarse.width - 1 ) ) };
+				const uint32_t x0{ static_cast<uint32_t>( cx ) };
+				const uint32_t x1{ std::min( x0 + 1, coarse.width - 1 ) };
+				const float tx{ cx - x0 };
+				const float *const c{ coarse.values.data() };
+				const float top{ c[y0 * coarse.width + x0] * ( 1.0f - tx ) + c[y0 * coarse.width + x1] * tx };
+				const float bottom{ c[y1 * coarse.width + x0] * ( 1.0f - tx ) + c[y1 * coarse.width + x1] * tx };
+				fine.values[i] = fine.weights[i] * fine.values[i] +
+						( 1.0f - fine.weights[i] ) * ( top * ( 1.0f - ty ) + bottom * ty );
+				fine.weights[i] = 1.0f;
+			}
+		}
+		// Relax the voids towards the average of their 4 neighbours, in place
+		for( uint32_t sweep{0}; sweep < VOID_FILL_SWEEPS; ++sweep )
+			for( const size_t i : voids ) {
+				const uint32_t x{ static_cast<uint32_t>( i % fine.width ) };
+				const uint32_t y{ static_cast<uint32_t>( i / fine.width ) };
+				float sum{ 0.0f };
+				uint32_t count{ 0 };
+				if( x > 0 ) { sum += fine.values[i - 1]; ++count; }
+				if( x + 1 < fine.width ) { sum += fine.values[i + 1]; ++count; }
+				if( y > 0 ) { sum += fine.values[i - fine.width]; ++count; }
+				if( y + 1 < fine.height ) { sum += fine.values[i + fine.width]; ++count; }
+				if( count > 0 )
+					fine.values[i] = sum / count;
+			}
+	}
+	values = std::move( levels[0].values );
+	weights = std::move( levels[0].weights );
+	return hasData;
+}
+
+/* Filled heights of a tile's blend region, its core grown by the blend width and clipped to the grid */
+struct voidFillTile_t {
+	uint32_t top{ 0 };
+	uint32_t left{ 0 };
+	uint32_t width{ 0 };
+	uint32_t height{ 0 };
+	// Empty if the region has no voids
+	std::vector<float> values;
+};
+
+/* Fill the tile with rows/columns [firstRow, lastRow) x [firstColumn, lastColumn) of grid in a window with
+ * a halo of VOID_FILL_HALO posts. The filled blend region, the core grown by blend posts, is returned in tile. */
+static void fillTileVoids( const uint16_t *grid, const size_t stride, const uint32_t numberOfRows,
+		const uint32_t numberOfColumns, const uint32_t firstRow, const uint32_t lastRow, const uint32_t firstColumn,
+		const uint32_t lastColumn, const uint32_t blend, voidFillTile_t &tile ) {
+	tile.top = firstRow > blend ? firstRow - blend : 0;
+	tile.left = firstColumn > blend ? firstColumn - blend : 0;
+	tile.width = std::min( lastColumn + blend, numberOfColumns ) - tile.left;
+	tile.height = std::min( lastRow + blend, numberOfRows ) - tile.top;
+	tile.values.clear();
+	bool hasVoids{ false };
+	for( uint32_t row{ tile.top }; row < tile.top + tile.height && !hasVoids; ++row ) {
+		const uint16_t *const values{ grid + row * stride + tile.left };
+		hasVoids = std::find( values, values + tile.width, VOID_HEIGHT ) != values + tile.width;
+	}
+	if( !hasVoids )
+		return;
+	const uint32_t top{ firstRow > VOID_FILL_HALO ? firstRow - VOID_FILL_HALO : 0 };
+	const uint32_t bottom{ std::min( lastRow + VOID_FILL_HALO, numberOfRows ) };
+	const uint32_t left{ firstColumn > VOID_FILL_HALO ? firstColumn - VOID_FILL_HALO : 0 };
+	const uint32_t right{ std::min( lastColumn + VOID_FILL_HALO, numberOfColumns ) };
+	const uint32_t width{ right - left };
+	const uint32_t height{ bottom - top };
+	std::vector<float> values( static_cast<size_t>( width ) * height );
+	std::vector<float> weights( values.size() );
+	for( uint32_t y{0}; y < height; ++y )
+		for( uint32_t x{0}; x < width; ++x ) {
+			const uint16_t h{ grid[( top + y ) * stride + left + x] };
+			const size_t i{ static_cast<size_t>( y ) * width + x };
+			weights[i] = VOID_HEIGHT == h ? 0.0f : 1.0f;
+			values[i] = VOID_HEIGHT == h ? 0.0f : static_cast<float>( h );
+		}
+	// A window without any data is left at 0, like unfilled no data
+	const bool filled{ pullPushFill( values, weights, width, height ) };
+	tile.values.resize( static_cast<size_t>( tile.width ) * tile.height );
+	for( uint32_t row{ tile.top }; row < tile.top + tile.height; ++row )
+		for( uint32_t column{ tile.left }; column < tile.left + tile.width; ++column )
+			tile.values[( row - tile.top ) * tile.width + column - tile.left] =
+					filled ? values[static_cast<size_t>( row - top ) * width + column - left] : 0.0f;
+}
+
+/* Weight of a tile's fill at post i of a row or column, for a core of [first, last) of size posts. It falls
+ * linearly from 1 to 0 over blend posts on either side of a core edge, so the weights of two neighbouring
+ * tiles add up to 1. Edges on the grid border don't fall off. */
+static float voidFillWeight( const uint32_t i, const uint32_t first, const uint32_t last, const uint32_t size,
+		const uint32_t blend ) {
+	float w{ 1.0f };
+	if( first > 0 )
+		w = std::min( w, 0.5f + ( static_cast<float>( i ) - first + 0.5f ) / ( 2.0f * blend ) );
+	if( last < size )
+		w = std::min( w, 0.5f + ( static_cast<float>( last ) - i - 0.5f ) / ( 2.0f * blend ) );
+	return std::max( 0.0f, w );
+}
+
+/* Fill all voids of a grid of numberOfRows x numberOfColumns heights, laid out in tiles of tilesize posts
+ * that share their edge posts. Every post belongs to the core of one tile. */
+static void fillVoids( orf_n::thread_pool &pool, uint16_t *grid, const size_t stride, const uint32_t numberOfRows,
+		const uint32_t numberOfColumns, const uint16_t tilesize ) {
+	const uint32_t step{ tilesize - 1u };
+	const uint32_t blend{ std::max( 1u, std::min( VOID_FILL_HALO / 2, step / 2 ) ) };
+	const uint32_t numberOfHTiles{ std::max( 1u, ( numberOfColumns - 1 + step - 1 ) / step ) };
+	const uint32_t numberOfVTiles{ std::max( 1u, ( numberOfRows - 1 + step - 1 ) / step ) };
+	const auto coreEnd = [step]( const uint32_t t, const uint32_t numberOfTiles, const uint32_t size ) {
+		return t + 1 == numberOfTiles ? size : ( t + 1 ) * step;
+	};
+	// Fills of the last three tile rows, a core takes its heights from the tiles around it
+	std::vector<voidFillTile_t> tiles[3];
+	for( std::vector<voidFillTile_t> &t : tiles )
+		t.resize( numberOfHTiles );
+	std::vector<std::future<bool>> jobs;
+	for( uint32_t v{0}; v <= numberOfVTiles; ++v ) {
+		if( v < numberOfVTiles ) {
+			const uint32_t firstRow{ v * step };
+			const uint32_t lastRow{ coreEnd( v, numberOfVTiles, numberOfRows ) };
+			for( uint32_t h{0}; h < numberOfHTiles; ++h )
+				jobs.push_back( pool.submit( [=, &tiles]() {
+					fillTileVoids( grid, stride, numberOfRows, numberOfColumns, firstRow, lastRow, h * step,
+							coreEnd( h, numberOfHTiles, numberOfColumns ), blend, tiles[v % 3][h] );
+					return true;
+				} ) );
+			orf_n::thread_pool::wait_for( jobs );
+		}
+		if( 0 == v )
+			continue;
+		// The tile row below has been filled, write back the voids of the one above it as the
+		// weighted sum of the overlapping fills
+		const uint32_t u{ v - 1 };
+		const uint32_t firstRow{ u * step };
+		const uint32_t lastRow{ coreEnd( u, numberOfVTiles, numberOfRows ) };
+		for( uint32_t h{0}; h < numberOfHTiles; ++h )
+			jobs.push_back( pool.submit( [=, &tiles]() {
+				const uint32_t firstColumn{ h * step };
+				const uint32_t lastColumn{ coreEnd( h, numberOfHTiles, numberOfColumns ) };
+				for( uint32_t row{ firstRow }; row < lastRow; ++row ) {
+					uint16_t *const heights{ grid + row * stride };
+					for( uint32_t column{ firstColumn }; column < lastColumn; ++column ) {
+						if( VOID_HEIGHT != heights[column] )
+							continue;
+						float sum{ 0.0f };
+						for( uint32_t j{ u > 0 ? u - 1 : 0 }; j <= std::min( u + 1, numberOfVTiles - 1 ); ++j )
+							for( uint32_t i{ h > 0 ? h - 1 : 0 }; i <= std::min( h + 1, numberOfHTiles - 1 ); ++i ) {
+								const voidFillTile_t &t{ tiles[j % 3][i] };
+								if( t.values.empty() || row < t.top || row >= t.top + t.height ||
+										column < t.left || column >= t.left + t.width )
+									continue;
+								sum += t.values[( row - t.top ) * t.width + column - t.left] *
+										voidFillWeight( row, j * step, coreEnd( j, numberOfVTiles, numberOfRows ),
+												numberOfRows, blend ) *
+										voidFillWeight( column, i * step, coreEnd( i, numberOfHTiles, numberOfColumns ),
+												numberOfColumns, blend );
+							}
+						heights[column] = static_cast<uint16_t>(
+								std::clamp( std::lround( sum ), 0l, static_cast<long>( VOID_HEIGHT - 1 ) ) );
+					}
+				}
+				return true;
+			} ) );
+		orf_n::thread_pool::wait_for( jobs );
+	}
+}
+
+}	// namespace